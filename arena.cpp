@@ -0,0 +1,80 @@
+#include "arena.hpp"
+
+#include <cstdlib>
+
+// default arena capacity, 4 MiB
+const std::size_t DEFAULT_ARENA_CAPACITY = 4 * 1024 * 1024;
+
+// alignment of every arena allocation
+const std::size_t ARENA_ALIGNMENT = alignof(std::max_align_t);
+
+static thread_local Arena * current_arena = nullptr;
+static thread_local std::size_t heap_allocations = 0;
+
+Arena::Arena(std::size_t capacity): m_capacity(capacity), m_used(0), m_allocations(0){}
+
+void * Arena::allocate(std::size_t bytes) noexcept{
+  if((bytes == 0) || (bytes > MAX_ALLOCATION)) return nullptr;
+
+  std::size_t size = (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+  if(m_used + size > m_capacity) return nullptr;
+
+  // the block is only reserved once something is allocated
+  if(!m_block){
+    m_block.reset(new (std::nothrow) char[m_capacity]);
+    if(!m_block){
+      m_capacity = 0;
+      return nullptr;
+    }
+  }
+
+  void * p = m_block.get() + m_used;
+  m_used += size;
+  ++m_allocations;
+  return p;
+}
+
+void Arena::reset() noexcept{
+  m_used = 0;
+  m_allocations = 0;
+}
+
+Arena * Arena::current() noexcept{
+  return current_arena;
+}
+
+std::size_t Arena::defaultCapacity(){
+  const char * value = std::getenv("PLOTSCRIPT_ARENA");
+  if(value != nullptr){
+    char * end = nullptr;
+    long kib = std::strtol(value, &end, 10);
+    if((end != value) && (kib >= 0)){
+      return static_cast<std::size_t>(kib) * 1024;
+    }
+  }
+  return DEFAULT_ARENA_CAPACITY;
+}
+
+std::size_t Arena::heapAllocations() noexcept{
+  return heap_allocations;
+}
+
+void Arena::countHeapAllocation() noexcept{
+  ++heap_allocations;
+}
+
+ArenaScope::ArenaScope(Arena & arena) noexcept: m_previous(current_arena){
+  current_arena = &arena;
+}
+
+ArenaScope::~ArenaScope(){
+  current_arena = m_previous;
+}
+
+HeapScope::HeapScope() noexcept: m_previous(current_arena){
+  current_arena = nullptr;
+}
+
+HeapScope::~HeapScope(){
+  current_arena = m_previous;
+}
@@ -0,0 +1,167 @@
+/*! \file arena.hpp
+Defines the Arena bump allocator used for temporaries during evaluation.
+ */
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+/*! \class Arena
+\brief A bump allocator for short lived allocations on one thread.
+
+Memory is handed out from a single block by advancing a pointer and is
+never freed individually, only all at once by reset. Allocations larger
+than MAX_ALLOCATION, or that do not fit in the remaining capacity, return
+nullptr and the caller falls back to the heap.
+
+An Arena is made current on a thread with an ArenaScope. Anything still
+referencing arena memory must be promoted to the heap before reset.
+*/
+class Arena {
+public:
+
+  /// largest single allocation served by the arena
+  static const std::size_t MAX_ALLOCATION = 4096;
+
+  /// Construct an arena of capacity bytes, a capacity of 0 disables it
+  explicit Arena(std::size_t capacity);
+
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+
+  /// allocate bytes aligned for any type, or nullptr when the arena cannot
+  void * allocate(std::size_t bytes) noexcept;
+
+  /// true if p points into this arena
+  bool owns(const void * p) const noexcept {
+    std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(m_block.get());
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(p);
+    return m_block && (address >= begin) && (address < begin + m_capacity);
+  }
+
+  /// release everything allocated since construction or the last reset
+  void reset() noexcept;
+
+  /// number of allocations served since the last reset
+  std::size_t allocations() const noexcept { return m_allocations; }
+
+  /// number of bytes in use since the last reset
+  std::size_t used() const noexcept { return m_used; }
+
+  /// capacity in bytes
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+  /// the arena current on the calling thread, or nullptr
+  static Arena * current() noexcept;
+
+  /*! Default capacity, from the PLOTSCRIPT_ARENA environment variable in
+    KiB if it is set, 0 disables the arena.
+   */
+  static std::size_t defaultCapacity();
+
+  /// number of heap allocations made through an ArenaAllocator on the calling thread
+  static std::size_t heapAllocations() noexcept;
+
+private:
+
+  friend class ArenaScope;
+  template<typename T> friend class ArenaAllocator;
+
+  std::unique_ptr<char[]> m_block;
+  std::size_t m_capacity;
+  std::size_t m_used;
+  std::size_t m_allocations;
+
+  static void countHeapAllocation() noexcept;
+};
+
+/*! \class ArenaScope
+\brief Makes an Arena current on the calling thread for its lifetime.
+*/
+class ArenaScope {
+public:
+
+  explicit ArenaScope(Arena & arena) noexcept;
+  ~ArenaScope();
+
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope & operator=(const ArenaScope &) = delete;
+
+private:
+  Arena * m_previous;
+};
+
+/*! \class HeapScope
+\brief Makes no Arena current on the calling thread for its lifetime, so
+allocations that must outlive the current arena go to the heap.
+*/
+class HeapScope {
+public:
+
+  HeapScope() noexcept;
+  ~HeapScope();
+
+  HeapScope(const HeapScope &) = delete;
+  HeapScope & operator=(const HeapScope &) = delete;
+
+private:
+  Arena * m_previous;
+};
+
+/*! \class ArenaAllocator
+\brief A standard allocator drawing from the Arena current when it was made.
+
+A default constructed allocator captures Arena::current(). It allocates
+from that arena only on the thread where the arena is current, otherwise,
+and when the arena is full, it uses the heap. Memory from the arena is
+released by Arena::reset, not by deallocate.
+*/
+template<typename T>
+class ArenaAllocator {
+public:
+
+  typedef T value_type;
+
+  ArenaAllocator() noexcept: m_arena(Arena::current()) {}
+
+  /// an allocator that always uses the heap when arena is nullptr
+  explicit ArenaAllocator(Arena * arena) noexcept: m_arena(arena) {}
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U> & other) noexcept: m_arena(other.arena()) {}
+
+  T * allocate(std::size_t n){
+    std::size_t bytes = n * sizeof(T);
+    if(m_arena && (m_arena == Arena::current())){
+      void * p = m_arena->allocate(bytes);
+      if(p) return static_cast<T *>(p);
+    }
+    Arena::countHeapAllocation();
+    return static_cast<T *>(::operator new(bytes));
+  }
+
+  void deallocate(T * p, std::size_t) noexcept {
+    if(m_arena && m_arena->owns(p)) return;
+    ::operator delete(p);
+  }
+
+  /// the arena this allocator draws from, or nullptr
+  Arena * arena() const noexcept { return m_arena; }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U> & other) const noexcept { return m_arena == other.arena(); }
+
+  template<typename U>
+  bool operator!=(const ArenaAllocator<U> & other) const noexcept { return m_arena != other.arena(); }
+
+  template<typename U>
+  struct rebind { typedef ArenaAllocator<U> other; };
+
+private:
+  Arena * m_arena;
+};
+
+#endif
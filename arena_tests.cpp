@@ -0,0 +1,87 @@
+#include "catch.hpp"
+
+#include "arena.hpp"
+#include "shared_list.hpp"
+
+#include <vector>
+
+TEST_CASE( "Test Arena bump allocation", "[arena]" ) {
+
+  Arena arena(1024);
+  REQUIRE(Arena::current() == nullptr);
+
+  void * a = arena.allocate(10);
+  void * b = arena.allocate(10);
+  REQUIRE(a != nullptr);
+  REQUIRE(b != nullptr);
+  REQUIRE(arena.owns(a));
+  REQUIRE(arena.owns(b));
+  REQUIRE(arena.allocations() == 2);
+  REQUIRE(reinterpret_cast<std::uintptr_t>(b) % alignof(std::max_align_t) == 0);
+
+  // too large, or past the capacity, falls back to the caller
+  REQUIRE(arena.allocate(Arena::MAX_ALLOCATION + 1) == nullptr);
+  REQUIRE(arena.allocate(2048) == nullptr);
+
+  int on_stack;
+  REQUIRE(!arena.owns(&on_stack));
+
+  arena.reset();
+  REQUIRE(arena.used() == 0);
+  REQUIRE(arena.allocate(10) == a);
+}
+
+TEST_CASE( "Test disabled Arena", "[arena]" ) {
+
+  Arena arena(0);
+  REQUIRE(arena.allocate(8) == nullptr);
+  REQUIRE(!arena.owns(nullptr));
+}
+
+TEST_CASE( "Test ArenaAllocator uses the current arena", "[arena]" ) {
+
+  Arena arena(64 * 1024);
+
+  ArenaAllocator<int> heap;
+  REQUIRE(heap.arena() == nullptr);
+
+  std::size_t before = Arena::heapAllocations();
+  {
+    ArenaScope scope(arena);
+    REQUIRE(Arena::current() == &arena);
+
+    std::vector<int, ArenaAllocator<int>> values;
+    for(int i = 0; i < 100; ++i){
+      values.push_back(i);
+    }
+    REQUIRE(values.get_allocator().arena() == &arena);
+    REQUIRE(arena.owns(values.data()));
+    REQUIRE(Arena::heapAllocations() == before);
+  }
+  REQUIRE(Arena::current() == nullptr);
+  REQUIRE(arena.allocations() > 0);
+}
+
+TEST_CASE( "Test SharedList promotion out of an arena", "[arena]" ) {
+
+  Arena arena(64 * 1024);
+  SharedList<SharedList<int>> outer;
+  {
+    ArenaScope scope(arena);
+    SharedList<int> inner;
+    inner.push_back(1);
+    inner.push_back(2);
+    outer.push_back(inner);
+    REQUIRE(outer.inArena());
+    REQUIRE(outer[0].inArena());
+
+    outer.promote([](SharedList<int> & e){ e.promote([](int &){}); });
+  }
+  arena.reset();
+
+  const SharedList<SharedList<int>> & result = outer;
+  REQUIRE(!result.inArena());
+  REQUIRE(!result[0].inArena());
+  REQUIRE(result[0][0] == 1);
+  REQUIRE(result[0][1] == 2);
+}
@@ -0,0 +1,230 @@
+#include "ast_cache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "replace_file.hpp"
+#include "serialize.hpp"
+
+#if defined(_WIN64) || defined(_WIN32)
+#include <direct.h>
+#define make_directory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_directory(path) mkdir(path, 0755)
+#endif
+
+// the first bytes of every entry
+const char MAGIC[8] = {'P', 'L', 'S', 'C', 'A', 'C', 'H', 'E'};
+
+// magic, two versions, key, count, payload size, checksum, source size
+// and source check
+const std::size_t HEADER_SIZE = 64;
+
+const std::uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const std::uint64_t FNV_PRIME = 1099511628211ULL;
+
+// FNV-1a hash of size bytes at data continuing from hash
+static std::uint64_t fnv(std::uint64_t hash, const char * data, std::size_t size) noexcept{
+  for(std::size_t i = 0; i < size; ++i){
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static void put_u32(std::uint32_t value, char * out){
+  for(int i = 0; i < 4; ++i){
+    out[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+static void put_u64(std::uint64_t value, char * out){
+  for(int i = 0; i < 8; ++i){
+    out[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+static std::uint32_t get_u32(const char * in){
+  std::uint32_t value = 0;
+  for(int i = 0; i < 4; ++i){
+    value |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+  }
+  return value;
+}
+
+static std::uint64_t get_u64(const char * in){
+  std::uint64_t value = 0;
+  for(int i = 0; i < 8; ++i){
+    value |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+  }
+  return value;
+}
+
+// a 64-bit hash of size bytes at data reading 8 bytes at a time, unrelated
+// to FNV-1a so a text colliding with another under one rarely does under both
+static std::uint64_t mix(const char * data, std::size_t size) noexcept{
+  auto fmix = [](std::uint64_t h){
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  };
+  std::uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+  std::size_t i = 0;
+  for(; i + 8 <= size; i += 8){
+    hash = fmix(hash ^ get_u64(data + i)) + 0x9e3779b97f4a7c15ULL;
+  }
+  std::uint64_t last = 0;
+  for(std::size_t j = 0; i + j < size; ++j){
+    last |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i + j])) << (8 * j);
+  }
+  return fmix(hash ^ last);
+}
+
+// create directory and any missing parents, existing ones are fine
+static void make_directories(const std::string & directory){
+  for(std::size_t i = 1; i <= directory.size(); ++i){
+    if((i == directory.size()) || (directory[i] == '/') || (directory[i] == '\\')){
+      make_directory(directory.substr(0, i).c_str());
+    }
+  }
+}
+
+AstCache::AstCache(const std::string & directory): m_directory(directory){}
+
+std::string AstCache::defaultDirectory(){
+  const char * xdg = std::getenv("XDG_CACHE_HOME");
+  if(xdg && *xdg){
+    return std::string(xdg) + "/plotscript";
+  }
+  const char * home = std::getenv("HOME");
+  if(home && *home){
+    return std::string(home) + "/.cache/plotscript";
+  }
+  const char * local = std::getenv("LOCALAPPDATA");
+  if(local && *local){
+    return std::string(local) + "\\plotscript";
+  }
+  return std::string();
+}
+
+std::uint64_t AstCache::key(const char * text, std::size_t size) noexcept{
+  char versions[16];
+  put_u32(SERIAL_VERSION, versions);
+  put_u32(VERSION, versions + 4);
+  put_u64(size, versions + 8);
+  return fnv(fnv(FNV_OFFSET, versions, sizeof(versions)), text, size);
+}
+
+AstCache::Source AstCache::source(const char * text, std::size_t size) noexcept{
+  Source source;
+  source.key = key(text, size);
+  source.size = size;
+  source.check = mix(text, size);
+  return source;
+}
+
+std::string AstCache::path(std::uint64_t key) const{
+  if(!enabled()) return std::string();
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.ast", static_cast<unsigned long long>(key));
+  return m_directory + "/" + name;
+}
+
+AstCacheReader::AstCacheReader(const AstCache & cache, const AstCache::Source & source):
+  m_file(cache.path(source.key)), m_next(nullptr), m_end(nullptr), m_remaining(0), m_valid(false), m_failed(false){
+
+  if(!cache.enabled() || !m_file.isOpen() || (m_file.size() < HEADER_SIZE)) return;
+
+  const char * header = m_file.data();
+  if(std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) return;
+  if((get_u32(header + 8) != SERIAL_VERSION) || (get_u32(header + 12) != AstCache::VERSION)) return;
+  if(get_u64(header + 16) != source.key) return;
+  if((get_u64(header + 48) != source.size) || (get_u64(header + 56) != source.check)) return;
+
+  std::uint64_t bytes = get_u64(header + 32);
+  if(bytes != m_file.size() - HEADER_SIZE) return;
+  if(fnv(FNV_OFFSET, header + HEADER_SIZE, bytes) != get_u64(header + 40)) return;
+
+  m_remaining = get_u64(header + 24);
+  m_next = header + HEADER_SIZE;
+  m_end = m_next + bytes;
+  m_valid = true;
+}
+
+bool AstCacheReader::next(Expression & exp){
+  if(!m_valid || m_failed) return false;
+
+  if(m_remaining == 0){
+    m_failed = (m_next != m_end);
+    return false;
+  }
+
+  if(!deserialize(m_next, m_end, exp)){
+    m_failed = true;
+    return false;
+  }
+  --m_remaining;
+  return true;
+}
+
+AstCacheWriter::AstCacheWriter(const AstCache & cache, const AstCache::Source & source):
+  m_path(cache.path(source.key)), m_source(source), m_count(0), m_bytes(0), m_checksum(FNV_OFFSET), m_committed(false){
+
+  // a disabled cache leaves the stream closed, so add and commit fail
+  if(!cache.enabled()) return;
+
+  m_temporary = temporaryPath(m_path);
+
+  make_directories(cache.directory());
+  m_out.open(m_temporary, std::ios::binary | std::ios::trunc);
+  char header[HEADER_SIZE] = {0};
+  m_out.write(header, sizeof(header));
+}
+
+AstCacheWriter::~AstCacheWriter(){
+  if(!m_committed){
+    m_out.close();
+    std::remove(m_temporary.c_str());
+  }
+}
+
+bool AstCacheWriter::add(const Expression & exp){
+  if(!m_out) return false;
+
+  m_buffer.clear();
+  serialize(exp, m_buffer);
+  m_out.write(m_buffer.data(), m_buffer.size());
+  m_checksum = fnv(m_checksum, m_buffer.data(), m_buffer.size());
+  m_bytes += m_buffer.size();
+  ++m_count;
+  return static_cast<bool>(m_out);
+}
+
+bool AstCacheWriter::commit(){
+  if(m_committed || !m_out) return false;
+
+  char header[HEADER_SIZE];
+  std::memcpy(header, MAGIC, sizeof(MAGIC));
+  put_u32(SERIAL_VERSION, header + 8);
+  put_u32(AstCache::VERSION, header + 12);
+  put_u64(m_source.key, header + 16);
+  put_u64(m_count, header + 24);
+  put_u64(m_bytes, header + 32);
+  put_u64(m_checksum, header + 40);
+  put_u64(m_source.size, header + 48);
+  put_u64(m_source.check, header + 56);
+  m_out.seekp(0);
+  m_out.write(header, sizeof(header));
+  m_out.close();
+  if(m_out.fail()) return false;
+
+  if(!replaceFile(m_temporary, m_path)) return false;
+  m_committed = true;
+  return true;
+}
@@ -0,0 +1,139 @@
+/*! \file ast_cache.hpp
+Defines the AstCache keeping parsed programs on disk between runs.
+ */
+#ifndef AST_CACHE_HPP
+#define AST_CACHE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "expression.hpp"
+#include "mapped_file.hpp"
+
+/*! \class AstCache
+\brief A directory of the parsed top-level expressions of programs, keyed
+by a hash of the program text and the versions of the encoding and parser.
+
+An entry is a file with a header followed by the serialized expressions.
+The header holds a magic string, the versions, the key, the number of
+expressions, the size and checksum of the encoding, and the length and a
+second hash of the program text, independent of the key, so two texts
+whose keys collide do not share an entry. The header and
+each encoding are a multiple of 8 bytes, so packed runs of numbers stay
+aligned in the mapped entry. Entries are written
+with an AstCacheWriter and read with an AstCacheReader, which checks the
+whole header and checksum before handing out an expression.
+*/
+class AstCache {
+public:
+
+  /// version of the entries, changed whenever parsing gives different ASTs
+  static const std::uint32_t VERSION = 2;
+
+  /// what an entry is checked against, derived from the program text
+  struct Source {
+    std::uint64_t key;   ///< names the entry, see key
+    std::uint64_t size;  ///< length of the text in bytes
+    std::uint64_t check; ///< a hash of the text independent of the key
+  };
+
+  /*! use the cache in directory, which is created when an entry is
+    written. An empty directory disables the cache, nothing is read or
+    written.
+   */
+  explicit AstCache(const std::string & directory);
+
+  /// false if the cache has no directory
+  bool enabled() const noexcept { return !m_directory.empty(); }
+
+  /// the directory of the cache
+  const std::string & directory() const noexcept { return m_directory; }
+
+  /*! The default directory, plotscript in $XDG_CACHE_HOME, in ~/.cache if
+    it is not set, or in %LOCALAPPDATA% on Windows. Empty if none is set.
+   */
+  static std::string defaultDirectory();
+
+  /// the key of the program text of size bytes at text
+  static std::uint64_t key(const char * text, std::size_t size) noexcept;
+
+  /// the key, length and check of the program text of size bytes at text
+  static Source source(const char * text, std::size_t size) noexcept;
+
+  /// the path of the entry of key, empty if the cache is not enabled
+  std::string path(std::uint64_t key) const;
+
+private:
+  std::string m_directory;
+};
+
+/*! \class AstCacheReader
+\brief Reads the expressions of a cache entry, with the interface of a Reader.
+*/
+class AstCacheReader {
+public:
+
+  /// map and check the entry of source in cache, see valid
+  AstCacheReader(const AstCache & cache, const AstCache::Source & source);
+
+  /// true if the entry exists, its header matches source and its checksum is correct
+  bool valid() const noexcept { return m_valid; }
+
+  /*! Decode the next expression of the entry.
+    \param exp set to the expression decoded
+    \return false after the last expression, or when the entry is not
+    valid or cannot be decoded, in which case failed() is true
+   */
+  bool next(Expression & exp);
+
+  /// true if reading stopped at an expression that could not be decoded
+  bool failed() const noexcept { return m_failed; }
+
+private:
+  MappedFile m_file;
+  const char * m_next;
+  const char * m_end;
+  std::uint64_t m_remaining;
+  bool m_valid;
+  bool m_failed;
+};
+
+/*! \class AstCacheWriter
+\brief Writes the expressions of a program to a new cache entry.
+
+The entry is written to a temporary file that is renamed into place by
+commit, so readers only ever see complete entries. An entry that is not
+committed is removed.
+*/
+class AstCacheWriter {
+public:
+
+  /// start writing the entry of source in cache, creating its directory
+  AstCacheWriter(const AstCache & cache, const AstCache::Source & source);
+
+  /// remove the entry if it was not committed
+  ~AstCacheWriter();
+
+  AstCacheWriter(const AstCacheWriter &) = delete;
+  AstCacheWriter & operator=(const AstCacheWriter &) = delete;
+
+  /// append the next expression, false if the entry cannot be written
+  bool add(const Expression & exp);
+
+  /// complete the entry and make it visible, false if it could not be written
+  bool commit();
+
+private:
+  std::string m_path;
+  std::string m_temporary;
+  std::ofstream m_out;
+  AstCache::Source m_source;
+  std::uint64_t m_count;
+  std::uint64_t m_bytes;
+  std::uint64_t m_checksum;
+  std::string m_buffer;
+  bool m_committed;
+};
+
+#endif
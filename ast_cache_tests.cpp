@@ -0,0 +1,137 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "ast_cache.hpp"
+#include "parse.hpp"
+
+// write the entry of source with the expressions of program
+static void store(const AstCache & cache, const AstCache::Source & source, const std::string & program, bool commit){
+  std::istringstream iss(program);
+  Reader reader(iss);
+  AstCacheWriter writer(cache, source);
+  Expression exp;
+  while(reader.next(exp)){
+    REQUIRE(writer.add(exp));
+  }
+  if(commit){
+    REQUIRE(writer.commit());
+  }
+}
+
+TEST_CASE( "Test cache keys", "[ast_cache]" ) {
+
+  std::string a = "(+ 1 2)";
+  std::string b = "(+ 1 3)";
+  REQUIRE(AstCache::key(a.data(), a.size()) == AstCache::key(a.data(), a.size()));
+  REQUIRE(AstCache::key(a.data(), a.size()) != AstCache::key(b.data(), b.size()));
+  REQUIRE(AstCache::key(a.data(), a.size()) != AstCache::key(a.data(), a.size() - 1));
+
+  AstCache::Source source = AstCache::source(a.data(), a.size());
+  REQUIRE(source.key == AstCache::key(a.data(), a.size()));
+  REQUIRE(source.size == a.size());
+  REQUIRE(source.check != AstCache::source(b.data(), b.size()).check);
+
+  AstCache cache("some/directory");
+  REQUIRE(cache.enabled());
+  REQUIRE(cache.path(0x1234) == "some/directory/0000000000001234.ast");
+}
+
+TEST_CASE( "Test a cache without a directory is disabled", "[ast_cache]" ) {
+
+  AstCache cache("");
+  REQUIRE_FALSE(cache.enabled());
+  REQUIRE(cache.path(0x1234).empty());
+
+  AstCache::Source source = AstCache::source("(+ 1 2)", 7);
+  AstCacheWriter writer(cache, source);
+  REQUIRE_FALSE(writer.add(Expression(1.0)));
+  REQUIRE_FALSE(writer.commit());
+  REQUIRE_FALSE(AstCacheReader(cache, source).valid());
+}
+
+TEST_CASE( "Test cache entries are written and read back", "[ast_cache]" ) {
+
+  AstCache cache("ast_cache_tests/nested");
+  std::string program = "(define a 1)\n(define b (list a 2 \"text\"))\n(+ a I)";
+  AstCache::Source source = AstCache::source(program.data(), program.size());
+  std::remove(cache.path(source.key).c_str());
+
+  REQUIRE_FALSE(AstCacheReader(cache, source).valid());
+
+  // an entry that is not committed is not visible
+  store(cache, source, program, false);
+  REQUIRE_FALSE(AstCacheReader(cache, source).valid());
+
+  store(cache, source, program, true);
+  AstCacheReader reader(cache, source);
+  REQUIRE(reader.valid());
+
+  std::istringstream iss(program);
+  Reader expected(iss);
+  Expression exp, cached;
+  while(expected.next(exp)){
+    REQUIRE(reader.next(cached));
+    REQUIRE(cached == exp);
+  }
+  REQUIRE_FALSE(reader.next(cached));
+  REQUIRE_FALSE(reader.failed());
+
+  // an entry is only found under its own key
+  AstCache::Source other = source;
+  ++other.key;
+  REQUIRE_FALSE(AstCacheReader(cache, other).valid());
+
+  // and a text whose key collides with it does not read it
+  other = source;
+  ++other.check;
+  REQUIRE_FALSE(AstCacheReader(cache, other).valid());
+  other = source;
+  ++other.size;
+  REQUIRE_FALSE(AstCacheReader(cache, other).valid());
+  std::remove(cache.path(source.key).c_str());
+}
+
+TEST_CASE( "Test damaged cache entries are not valid", "[ast_cache]" ) {
+
+  AstCache cache("ast_cache_tests");
+  std::string program = "(define a (list 1 2 3))";
+  AstCache::Source source = AstCache::source(program.data(), program.size());
+  std::uint64_t key = source.key;
+  store(cache, source, program, true);
+  REQUIRE(AstCacheReader(cache, source).valid());
+
+  std::string bytes;
+  {
+    std::ifstream ifs(cache.path(key), std::ios::binary);
+    std::stringstream contents;
+    contents << ifs.rdbuf();
+    bytes = contents.str();
+  }
+  auto write = [&](const std::string & contents){
+    std::ofstream ofs(cache.path(key), std::ios::binary | std::ios::trunc);
+    ofs << contents;
+  };
+
+  // a flipped payload byte fails the checksum
+  std::string flipped = bytes;
+  flipped[flipped.size() - 3] ^= 1;
+  write(flipped);
+  REQUIRE_FALSE(AstCacheReader(cache, source).valid());
+
+  // as does a truncated entry and another version
+  write(bytes.substr(0, bytes.size() - 1));
+  REQUIRE_FALSE(AstCacheReader(cache, source).valid());
+
+  std::string version = bytes;
+  version[8] += 1;
+  write(version);
+  REQUIRE_FALSE(AstCacheReader(cache, source).valid());
+
+  write(bytes);
+  REQUIRE(AstCacheReader(cache, source).valid());
+  std::remove(cache.path(key).c_str());
+}
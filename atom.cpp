@@ -3,11 +3,33 @@
 #include <sstream>
 #include <cctype>
 #include <cmath>
+#include <cstring>
 #include <limits>
+#include <functional>
+#include <atomic>
+
+#include "counters.hpp"
+
+struct Atom::ComplexBox {
+  explicit ComplexBox(std::complex<double> v): references(1), value(v) {}
+  std::atomic<unsigned> references;
+  const std::complex<double> value;
+};
+
+struct Atom::StringBox {
+  explicit StringBox(const std::string & v): references(1), value(v) {}
+  std::atomic<unsigned> references;
+  const std::string value;
+};
+
+// true for the text of a string literal, which starts with a double quote
+static bool is_string_literal(const std::string & value) noexcept{
+  return !value.empty() && (value[0] == '"');
+}
 
 Atom::Atom(): m_type(NoneKind) {}
 
-Atom::Atom(double value){
+Atom::Atom(double value): Atom(){
 
   setNumber(value);
 }
@@ -31,8 +53,16 @@ Atom::Atom(const Token & token): Atom(){
     // make sure does not start with number
     if(!std::isdigit(token.asString()[0])){
 			std::string temp = token.asString();
-			
-			setSymbol(temp);
+
+			// a full symbol table leaves the Atom None, failing the parse
+			SymbolId id;
+			if(is_string_literal(temp)){
+				setSymbol(temp);
+			}
+			else if(SymbolTable::intern(temp, id)){
+				symbolValue = id;
+				m_type = SymbolKind;
+			}
     }
   }
 }
@@ -42,45 +72,55 @@ Atom::Atom(const std::string & value): Atom() {
 	setSymbol(value);
 }
 
-Atom::Atom(const Atom & x): Atom(){
-  if(x.isNumber()){
-    setNumber(x.numberValue);
-  }
-  else if(x.isSymbol()){
-    setSymbol(x.stringValue);
-  }
-  else if(x.isComplex()){
-    setComplex(x.complexValue);
-  }
+Atom::Atom(const Atom & x): m_type(NoneKind){
+  share(x);
 }
 
 Atom & Atom::operator=(const Atom & x){
 
   if(this != &x){
-    if(x.m_type == NoneKind){
-      m_type = NoneKind;
-    }
-    else if(x.m_type == NumberKind){
-      setNumber(x.numberValue);
-    }
-    else if(x.m_type == SymbolKind){
-      setSymbol(x.stringValue);
-    }
-    else if(x.m_type == ComplexKind){
-      setComplex(x.complexValue);
-    }
+    clear();
+    share(x);
   }
   return *this;
 }
   
 Atom::~Atom(){
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
+  // boxed values are shared, the last copy deletes them
+  clear();
+}
+
+void Atom::share(const Atom & x) noexcept{
+  m_type = x.m_type;
+  if(m_type == NumberKind){
+    numberValue = x.numberValue;
+  }
+  else if(m_type == SymbolKind){
+    symbolValue = x.symbolValue;
+  }
+  else if(m_type == StringKind){
+    stringValue = x.stringValue;
+    stringValue->references.fetch_add(1, std::memory_order_relaxed);
+  }
+  else if(m_type == ComplexKind){
+    complexValue = x.complexValue;
+    complexValue->references.fetch_add(1, std::memory_order_relaxed);
   }
 }
 
+void Atom::clear() noexcept{
+  if((m_type == ComplexKind) &&
+     (complexValue->references.fetch_sub(1, std::memory_order_acq_rel) == 1)){
+    delete complexValue;
+  }
+  else if((m_type == StringKind) &&
+     (stringValue->references.fetch_sub(1, std::memory_order_acq_rel) == 1)){
+    delete stringValue;
+  }
+  m_type = NoneKind;
+}
+
 bool Atom::isNone() const noexcept{
   return m_type == NoneKind;
 }
@@ -94,32 +134,38 @@ bool Atom::isNumber() const noexcept{
 }
 
 bool Atom::isSymbol() const noexcept{
-  return m_type == SymbolKind;
+  return (m_type == SymbolKind) || (m_type == StringKind);
 }  
 
+bool Atom::isString() const noexcept{
+  return m_type == StringKind;
+}
+
 
 void Atom::setNumber(double value){
 
+  clear();
   m_type = NumberKind;
   numberValue = value;
 }
 
 void Atom::setComplex(std::complex<double> value){
+  clear();
+  complexValue = new ComplexBox(value);
   m_type = ComplexKind;
-  complexValue = value;
 }
 
 void Atom::setSymbol(const std::string & value){
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
+  clear();
+  if(is_string_literal(value)){
+    stringValue = new StringBox(value);
+    m_type = StringKind;
+  }
+  else{
+    symbolValue = SymbolTable::intern(value);
+    m_type = SymbolKind;
   }
-	
-  m_type = SymbolKind;
-
-  // copy construct in place
-  new (&stringValue) std::string(value);
 }
 
 
@@ -130,20 +176,33 @@ double Atom::asNumber() const noexcept{
 
 std::complex<double> Atom::asComplex() const noexcept{
   std::complex<double> temp = 0;
-  return (m_type == ComplexKind) ? complexValue : temp;
+  return (m_type == ComplexKind) ? complexValue->value : temp;
 }
 
 std::string Atom::asSymbol() const noexcept{
 
   std::string result;
 
-  if(m_type == SymbolKind){
-    result = stringValue;
+  if(isSymbol()){
+    Counters::count(Counters::SYMBOL_STRINGS);
+    result = symbolName();
   }
 
   return result;
 }
 
+const std::string & Atom::symbolName() const noexcept{
+  static const std::string none;
+  if(m_type == SymbolKind){
+    return SymbolTable::name(symbolValue);
+  }
+  return (m_type == StringKind) ? stringValue->value : none;
+}
+
+SymbolId Atom::asSymbolId() const noexcept{
+  return (m_type == SymbolKind) ? symbolValue : NO_SYMBOL;
+}
+
 
 bool Atom::operator==(const Atom & right) const noexcept{
   
@@ -169,17 +228,19 @@ bool Atom::operator==(const Atom & right) const noexcept{
     {
       if(right.m_type != SymbolKind) return false;
 
-      return stringValue == right.stringValue;
+      return symbolValue == right.symbolValue;
     }
     break;
 
+  case StringKind:
+    return (stringValue == right.stringValue) || (stringValue->value == right.stringValue->value);
 
 
   case ComplexKind:
     {
       if(right.m_type != ComplexKind) return false;
-      std::complex<double> dleft = complexValue;
-      std::complex<double> dright = right.complexValue;
+      std::complex<double> dleft = complexValue->value;
+      std::complex<double> dright = right.complexValue->value;
       double diff  = abs(dleft - dright);
       if(std::isnan(diff) ||
 	    (diff > std::numeric_limits<double>::epsilon())) 
@@ -194,6 +255,45 @@ bool Atom::operator==(const Atom & right) const noexcept{
   return true;
 }
 
+// true if both numbers have the same bits, so -0 differs from 0
+static bool same_bits(double left, double right) noexcept{
+  return std::memcmp(&left, &right, sizeof(double)) == 0;
+}
+
+bool Atom::identical(const Atom & right) const noexcept{
+  if(m_type != right.m_type) return false;
+
+  switch(m_type){
+  case NumberKind:
+    return same_bits(numberValue, right.numberValue);
+  case SymbolKind:
+    return symbolValue == right.symbolValue;
+  case StringKind:
+    return (stringValue == right.stringValue) || (stringValue->value == right.stringValue->value);
+  case ComplexKind:
+    return same_bits(complexValue->value.real(), right.complexValue->value.real()) &&
+      same_bits(complexValue->value.imag(), right.complexValue->value.imag());
+  default:
+    return true;
+  }
+}
+
+std::size_t Atom::hash() const noexcept{
+  std::hash<double> hash_number;
+  switch(m_type){
+  case NumberKind:
+    return hash_number(numberValue);
+  case SymbolKind:
+    return std::hash<SymbolId>()(symbolValue) * 31 + 1;
+  case StringKind:
+    return std::hash<std::string>()(stringValue->value) * 31 + 4;
+  case ComplexKind:
+    return (hash_number(complexValue->value.real()) * 31 + hash_number(complexValue->value.imag())) * 31 + 2;
+  default:
+    return 3;
+  }
+}
+
 bool operator!=(const Atom & left, const Atom & right) noexcept{
   
   return !(left == right);
@@ -5,6 +5,7 @@ Defines the Atom type and associated functions.
 #define ATOM_HPP
 
 #include "token.hpp"
+#include "symbol_table.hpp"
 
 /*! \class Atom
 \brief A variant type that may be a Number or Symbol or the default type None.
@@ -47,6 +48,9 @@ public:
   /// predicate to determine if an Atom is of type Symbol
   bool isSymbol() const noexcept;
 
+  /// predicate to determine if an Atom is a Symbol holding a string literal
+  bool isString() const noexcept;
+
   /// predicate to determine if an Atom is of type Complex
   bool isComplex() const noexcept;
 
@@ -59,23 +63,47 @@ public:
   /// value of Atom as a complex, returns (0,0) if not a Number
   std::complex<double> asComplex() const noexcept;
 
+  /// name of a Symbol without copying it, empty if not a Symbol
+  const std::string & symbolName() const noexcept;
+
+  /*! interned id of a Symbol, see SymbolTable. String literals are not
+    interned, their id is NO_SYMBOL, as is that of an Atom not a Symbol.
+   */
+  SymbolId asSymbolId() const noexcept;
+
   /// equality comparison based on type and value
   bool operator==(const Atom & right) const noexcept;
 
+  /// true if both Atoms have the same type and exactly the same value bits
+  bool identical(const Atom & right) const noexcept;
+
+  /*! hash of the exact value, identical Atoms have equal hashes. Atoms
+    equal by operator== may not, as numbers compare with a tolerance.
+   */
+  std::size_t hash() const noexcept;
+
 private:
 
   // internal enum of known types
-  enum Type {NoneKind, NumberKind, SymbolKind, ComplexKind};
+  enum Type : unsigned char {NoneKind, NumberKind, SymbolKind, StringKind, ComplexKind};
+
+  // a complex value stored out of line, shared between copies
+  struct ComplexBox;
+
+  // the text of a string literal stored out of line, shared between copies
+  struct StringBox;
 
   // track the type
   Type m_type;
 
-  // values for the known types. Note the use of a union requires care
-  // when setting non POD values (see setSymbol)
+  // values for the known types in 8 bytes, so an Atom is 16 bytes.
+  // Symbols are interned, string literals and complex values are
+  // reference counted.
   union {
     double numberValue;
-    std::string stringValue;
-    std::complex<double> complexValue;
+    SymbolId symbolValue;
+    StringBox * stringValue;
+    ComplexBox * complexValue;
   };
 
   // helper to set type and value of Number
@@ -86,6 +114,12 @@ private:
 
   // helper to set type and value of Complex
   void setComplex(std::complex<double> value);
+
+  // take a reference to the box of x, if any, and copy its value
+  void share(const Atom & x) noexcept;
+
+  // release the box, if any, leaving the Atom None
+  void clear() noexcept;
 };
 
 /// inequality comparison for Atom
@@ -323,4 +323,52 @@ TEST_CASE( "test comparison", "[atom]" ) {
   }
 
 
-}
\ No newline at end of file
+}
+TEST_CASE( "Test compact representation", "[atom]" ) {
+
+  REQUIRE(sizeof(Atom) == 16);
+
+  {
+    INFO("symbols are interned");
+    Atom a("interned");
+    Atom b(std::string("interned"));
+    REQUIRE(a.asSymbolId() == b.asSymbolId());
+    REQUIRE(SymbolTable::name(a.asSymbolId()) == "interned");
+  }
+
+  {
+    INFO("string literals are not interned");
+    Atom a(std::string("\"a literal never interned\""));
+    Atom b(Token("\"a literal never interned\""));
+    Atom c(a);
+    SymbolId id;
+    REQUIRE(a.isSymbol());
+    REQUIRE(a.isString());
+    REQUIRE(!Atom("interned").isString());
+    REQUIRE(!SymbolTable::lookup("\"a literal never interned\"", id));
+    REQUIRE(a.asSymbolId() == NO_SYMBOL);
+    REQUIRE(a == b);
+    REQUIRE(a.identical(b));
+    REQUIRE(a.hash() == b.hash());
+    REQUIRE(a != Atom("\"another literal\""));
+    a = Atom(1.0);
+    REQUIRE(c.asSymbol() == "\"a literal never interned\"");
+    REQUIRE(c.symbolName() == "\"a literal never interned\"");
+  }
+
+  {
+    INFO("complex values survive copies and reassignment");
+    Atom a(std::complex<double>(1,2));
+    Atom b(a);
+    Atom c;
+    c = b;
+    a = Atom(3.0);
+    b = Atom("b");
+    REQUIRE(c.isComplex());
+    REQUIRE(c.asComplex() == std::complex<double>(1,2));
+    c = c;
+    REQUIRE(c.asComplex() == std::complex<double>(1,2));
+    c = Atom(std::complex<double>(0,1));
+    REQUIRE(c.asComplex() == std::complex<double>(0,1));
+  }
+}
@@ -0,0 +1,681 @@
+/*! \file bench.cpp
+Benchmark driver for the interpreter.
+
+Most benchmarks are plotscript programs that are parsed once and then
+evaluated repeatedly in the same Interpreter, with the startup procedures
+loaded so the plots can run. The others time tokenize, parse, reading and
+evaluating a script of many expressions, writing and reading back an
+expression in the binary encoding and as text, printing large results,
+reading columns of CSV files, copying an Environment and
+sampling a lambda directly.
+
+Each benchmark is run once to warm up and then for its repetitions, split
+into rounds. The median and the minimum over the rounds of the wall-clock
+time per repetition are reported, with the number of list buffers per
+repetition that came from the heap rather than the evaluation arena
+(PLOTSCRIPT_ARENA=0 disables the arena) and, for benchmarks processing
+many items, the items per second at the median time.
+
+With --json the results are written as JSON, one benchmark per line, and
+can be saved as a baseline. --compare reads such a baseline and reports
+the change of each median, failing if one is more than --threshold
+percent slower (default 10). This is not part of the unit tests, run it
+from a Release build:
+
+  plotscript_bench [--json] [--compare baseline.json] [--threshold percent] [name-filter]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "environment.hpp"
+#include "interpreter.hpp"
+#include "numeric_function.hpp"
+#include "parse.hpp"
+#include "semantic_error.hpp"
+#include "serialize.hpp"
+#include "startup_config.hpp"
+#include "thread_pool.hpp"
+#include "token.hpp"
+
+// rounds each benchmark's repetitions are split into
+const unsigned ROUNDS = 5;
+
+struct Benchmark {
+  std::string name;
+  unsigned repetitions;
+  // items processed by one repetition, 0 if no throughput is reported
+  std::size_t items;
+  // prepare the benchmark and return the work of one repetition
+  std::function<std::function<void()>()> setup;
+};
+
+// build the program (op x a1 ... an-1) with n real or complex arguments,
+// the first is the variable x so the call is not constant folded
+std::string nary(const std::string & op, unsigned n, bool complex){
+  std::ostringstream program;
+  program << "(begin (define x 1) (" << op;
+  for(unsigned i = 0; i < n; ++i){
+    if(i == 0){
+      program << " x";
+    }
+    else{
+      program << " " << (1 + (i % 7));
+    }
+    if(complex && (i == n - 1)){
+      program << " I";
+    }
+  }
+  program << "))";
+  return program.str();
+}
+
+// build the program (f (f ... (f arg))) with n applications of f
+std::string nested(const std::string & f, unsigned n, const std::string & arg){
+  std::string program = arg;
+  for(unsigned i = 0; i < n; ++i){
+    program = "(" + f + " " + program + ")";
+  }
+  return program;
+}
+
+// an Interpreter with the startup procedures loaded
+std::shared_ptr<Interpreter> startup_interpreter(){
+  std::shared_ptr<Interpreter> interp(new Interpreter());
+  std::ifstream startup(STARTUP_FILE);
+  if(!startup || !interp->parseStream(startup)){
+    throw SemanticError("Error: benchmark could not load the startup file");
+  }
+  interp->evaluate();
+  return interp;
+}
+
+// a benchmark evaluating program with threads worker threads for the
+// shared pool, 0 keeps the default
+Benchmark program(const std::string & name, const std::string & program, unsigned repetitions,
+                  unsigned threads = 0, std::size_t items = 0){
+  return {name, repetitions, items, [=](){
+      ThreadPool::configure(threads, ThreadPool::threshold());
+
+      std::shared_ptr<Interpreter> interp = startup_interpreter();
+      std::istringstream iss(program);
+      if(!interp->parseStream(iss)){
+        throw SemanticError("Error: benchmark " + name + " could not parse");
+      }
+      return std::function<void()>([interp](){ interp->evaluate(); });
+    }};
+}
+
+// a program defining count variables and lambdas
+std::string definitions(unsigned count){
+  std::ostringstream program;
+  program << "(begin";
+  for(unsigned i = 0; i < count; ++i){
+    program << " (define v" << i << " " << i << ")"
+            << " (define f" << i << " (lambda (x) (+ x v" << i << ")))";
+  }
+  program << ")";
+  return program.str();
+}
+
+// a list of n points on a parabola, for discrete-plot
+std::string points(unsigned n){
+  std::ostringstream program;
+  program << "(list";
+  for(unsigned i = 0; i < n; ++i){
+    program << " (list " << i << " " << (i * i) % 97 << ")";
+  }
+  program << ")";
+  return program.str();
+}
+
+// a list of n points in the unit square, the generated data of a plot
+std::string unit_points(unsigned n){
+  std::ostringstream program;
+  program << "(list";
+  for(unsigned i = 0; i < n; ++i){
+    program << " (list 0." << i << " 0." << (i * 7919) % 10007 << ")";
+  }
+  program << ")";
+  return program.str();
+}
+
+// a benchmark of tokenize on text
+Benchmark tokenize_text(const std::string & name, const std::string & text, unsigned repetitions){
+  std::istringstream iss(text);
+  std::size_t tokens = tokenize(iss).size();
+  return {name, repetitions, tokens, [text](){
+      return std::function<void()>([text](){
+          std::istringstream iss(text);
+          tokenize(iss);
+        });
+    }};
+}
+
+// a benchmark of parse on the tokens of text
+Benchmark parse_text(const std::string & name, const std::string & text, unsigned repetitions){
+  std::istringstream iss(text);
+  std::shared_ptr<TokenSequenceType> tokens(new TokenSequenceType(tokenize(iss)));
+  return {name, repetitions, tokens->size(), [tokens, name](){
+      if(parse(*tokens) == Expression()){
+        throw SemanticError("Error: benchmark " + name + " could not parse");
+      }
+      return std::function<void()>([tokens](){ parse(*tokens); });
+    }};
+}
+
+// a benchmark of parsing text as a resubmitted cell, found in the parse
+// cache or parsed from the text every time
+Benchmark parse_cell(const std::string & name, const std::string & text, unsigned repetitions, bool cached){
+  return {name, repetitions, 0, [text, name, cached](){
+      std::shared_ptr<Interpreter> interp(new Interpreter());
+      if(!interp->parseString(text)){
+        throw SemanticError("Error: benchmark " + name + " could not parse");
+      }
+      return std::function<void()>([interp, text, cached](){
+          if(cached){
+            interp->parseString(text);
+          }
+          else{
+            std::istringstream iss(text);
+            interp->parseStream(iss);
+          }
+        });
+    }};
+}
+
+// a benchmark of writing the parse of text and reading it back, in the
+// binary encoding or as text. The printed text of an expression does not
+// always parse back to it, so the text is read back from the program.
+Benchmark round_trip(const std::string & name, const std::string & text, unsigned repetitions, bool binary){
+  std::istringstream iss(text);
+  Expression exp = parse(tokenize(iss));
+  return {name, repetitions, 0, [exp, text, name, binary](){
+      return std::function<void()>([exp, text, name, binary](){
+          Expression result;
+          if(binary){
+            std::string bytes;
+            serialize(exp, bytes);
+            const char * data = bytes.data();
+            deserialize(data, data + bytes.size(), result);
+          }
+          else{
+            std::ostringstream oss;
+            oss << exp;
+            std::istringstream iss(text);
+            result = parse(tokenize(iss));
+          }
+          if(!(result == exp)){
+            throw SemanticError("Error: benchmark " + name + " did not round trip");
+          }
+        });
+    }};
+}
+
+// a benchmark of printing the result of program, the way the REPL does
+Benchmark print_result(const std::string & name, const std::string & program, unsigned repetitions,
+                       std::size_t items){
+  return {name, repetitions, items, [program, name](){
+      std::shared_ptr<Interpreter> interp = startup_interpreter();
+      std::istringstream iss(program);
+      if(!interp->parseStream(iss)){
+        throw SemanticError("Error: benchmark " + name + " could not parse");
+      }
+      std::shared_ptr<Expression> result(new Expression(interp->evaluate()));
+      return std::function<void()>([result](){
+          std::ostringstream out;
+          out << *result << std::endl;
+        });
+    }};
+}
+
+// a CSV file of rows of an index and two values, removed when the last
+// copy of its pointer goes
+struct CsvFile {
+  std::string path;
+  std::size_t rows;
+  CsvFile(const std::string & p, std::size_t bytes): path(p), rows(0){
+    std::ofstream out(path, std::ios::binary);
+    out << "index,value,noise\n";
+    std::size_t written = 0;
+    while(written < bytes){
+      std::string line = std::to_string(rows) + "," + std::to_string(std::sin(rows * 0.001)) +
+        "," + std::to_string((rows * 7919) % 1000 * 0.125) + "\n";
+      out << line;
+      written += line.size();
+      ++rows;
+    }
+    if(!out){
+      throw SemanticError("Error: benchmark could not write " + path);
+    }
+  }
+  ~CsvFile(){
+    std::remove(path.c_str());
+  }
+};
+
+// a benchmark of evaluating (read-csv file columns) on a file of about bytes
+Benchmark read_csv(const std::string & name, std::size_t bytes, const std::string & columns, unsigned repetitions){
+  std::shared_ptr<CsvFile> file(new CsvFile(name + ".csv", bytes));
+  return {name, repetitions, file->rows, [file, columns, name](){
+      std::shared_ptr<Interpreter> interp(new Interpreter());
+      std::istringstream iss("(length (read-csv \"" + file->path + "\" " + columns + "))");
+      if(!interp->parseStream(iss)){
+        throw SemanticError("Error: benchmark " + name + " could not parse");
+      }
+      return std::function<void()>([file, interp](){ interp->evaluate(); });
+    }};
+}
+
+// a benchmark of copying an environment with the definitions of program
+Benchmark environment_copy(const std::string & name, const std::string & program, unsigned repetitions){
+  return {name, repetitions, 0, [program](){
+      std::shared_ptr<Environment> env(new Environment());
+      std::istringstream iss(program);
+      parse(tokenize(iss)).eval(*env);
+      return std::function<void()>([env](){
+          Environment copy(*env);
+          if(!copy.is_known(Atom("v0"))){
+            throw SemanticError("Error: benchmark environment copy lost a definition");
+          }
+        });
+    }};
+}
+
+// a script of count top-level expressions, the way generated data scripts look
+std::string script(unsigned count){
+  std::ostringstream text;
+  for(unsigned i = 0; i < count; ++i){
+    text << "(define v" << i << " (list " << i << " (* " << i << " 0.5) \"point " << i << "\"))\n";
+  }
+  text << "(length (list v0 v1 v2))\n";
+  return text.str();
+}
+
+// a benchmark evaluating each top-level expression of text as it is read,
+// reading on the evaluating thread or on a thread of its own
+template<typename ReaderType>
+Benchmark script_text(const std::string & name, const std::string & text, unsigned repetitions){
+  std::size_t forms = std::count(text.begin(), text.end(), '\n');
+  return {name, repetitions, forms, [text, name](){
+      return std::function<void()>([text, name](){
+          std::istringstream iss(text);
+          ReaderType reader(iss);
+          Interpreter interp;
+          while(interp.parseNext(reader)){
+            interp.evaluate();
+          }
+          if(reader.failed()){
+            throw SemanticError("Error: benchmark " + name + " could not parse");
+          }
+        });
+    }};
+}
+
+/*
+  Benchmarks sampling the lambda f defined by definitions at points
+  between lower and upper, the way continuous-plot samples it, point by
+  point with lambdaEval and in one batch with lambdaEvalBatch.
+*/
+void sampling(std::vector<Benchmark> & result, const std::string & name, const std::string & definitions,
+              double lower, double upper){
+  const unsigned points = 20000;
+
+  struct Sampler {
+    Environment env;
+    std::vector<std::vector<Expression>> args;
+  };
+  auto setup = [=](){
+    std::shared_ptr<Sampler> sampler(new Sampler());
+    std::istringstream iss(definitions);
+    parse(tokenize(iss)).eval(sampler->env);
+    if(!NumericFunction(Atom("f"), sampler->env).compiled()){
+      throw SemanticError("Error: benchmark " + name + " was not compiled");
+    }
+    sampler->args.resize(1);
+    for(unsigned i = 0; i < points; ++i){
+      sampler->args[0].push_back(Expression(lower + i * (upper - lower) / points));
+    }
+    return sampler;
+  };
+
+  result.push_back({name + "-lambdaEval", 3, points, [=](){
+        std::shared_ptr<Sampler> sampler = setup();
+        return std::function<void()>([sampler](){
+            Atom f("f");
+            Expression call(f);
+            for(auto & x : sampler->args[0]){
+              call.lambdaEval(f, sampler->env, std::vector<Expression>(1, x));
+            }
+          });
+      }});
+  result.push_back({name + "-batch", 20, points, [=](){
+        std::shared_ptr<Sampler> sampler = setup();
+        return std::function<void()>([sampler](){
+            Atom f("f");
+            Expression(f).lambdaEvalBatch(f, sampler->env, sampler->args);
+          });
+      }});
+}
+
+std::vector<Benchmark> benchmarks(){
+  std::vector<Benchmark> result;
+
+  // tokenize and parse of large inputs
+  std::string wide = "(list";
+  for(unsigned i = 0; i < 20000; ++i){
+    wide += " " + std::to_string(i);
+  }
+  wide += ")";
+  std::string program_text = definitions(2000);
+  result.push_back(tokenize_text("tokenize-definitions", program_text, 20));
+  result.push_back(tokenize_text("tokenize-wide", wide, 50));
+  result.push_back(parse_text("parse-definitions", program_text, 20));
+  result.push_back(parse_text("parse-deep", nested("-", 2000, "1"), 50));
+  result.push_back(parse_text("parse-wide", wide, 50));
+  result.push_back(parse_text("parse-unit-points-20k", unit_points(20000), 20));
+
+  // a plot cell submitted again, parsed from the text or found in the parse cache
+  std::string cell = "(begin (define f (lambda (x) (/ 1 (+ 1 (^ e (- (* 20 x))))))) "
+    "(continuous-plot f (list -1 1) (list (list \"title\" \"sigmoid\") (list \"abscissa-label\" \"x\"))))";
+  result.push_back(parse_cell("parse-cell-text", cell, 20000, false));
+  result.push_back(parse_cell("parse-cell-cached", cell, 20000, true));
+
+  // scripts of many top-level expressions, read serially and pipelined
+  std::string script_text_20k = script(20000);
+  result.push_back(script_text<Reader>("script-serial-20k", script_text_20k, 5));
+  result.push_back(script_text<PipelinedReader>("script-pipelined-20k", script_text_20k, 5));
+
+  // a program and a list of data written and read back, in binary and as text
+  std::string data = "(list";
+  for(unsigned i = 0; i < 100000; ++i){
+    data += " " + std::to_string(i + 0.25);
+  }
+  data += ")";
+  result.push_back(round_trip("round-trip-binary-definitions", program_text, 20, true));
+  result.push_back(round_trip("round-trip-text-definitions", program_text, 20, false));
+  result.push_back(round_trip("round-trip-binary-data-100k", data, 20, true));
+  result.push_back(round_trip("round-trip-text-data-100k", data, 20, false));
+
+  // printing of large results
+  result.push_back(print_result("print-range-1M", "(range 0 1000000 1)", 5, 1000000));
+  result.push_back(print_result("print-sqrt-1M", "(map sqrt (range 0 1000000 1))", 5, 1000000));
+  result.push_back(print_result("print-points-10k", points(10000), 20, 10000));
+
+  // data loaded from CSV files, one column packed and two as points
+  result.push_back(read_csv("read-csv-100MB-column", 100 << 20, "1", 3));
+  result.push_back(read_csv("read-csv-100MB-columns", 100 << 20, "\"value\" 2", 1));
+  result.push_back(read_csv("read-csv-10MB-points", 10 << 20, "0 1", 5));
+
+  result.push_back(program("arith-add-real", nary("+", 64, false), 20000, 0));
+  result.push_back(program("arith-add-complex", nary("+", 64, true), 20000, 0));
+  result.push_back(program("arith-mul-real", nary("*", 64, false), 20000, 0));
+  result.push_back(program("arith-mul-complex", nary("*", 64, true), 20000, 0));
+  result.push_back(program("arith-binary-real",
+        "(begin (define a 3) (define b 7) (/ (- a b) (- b a)))", 50000, 0));
+  result.push_back(program("arith-lambda-loop",
+        "(begin (define f (lambda (x) (/ (+ (* 2 x) 1) (- x 3)))) "
+        "(map f (range 0 500 1)))", 100, 0));
+  result.push_back(program("arith-constant-lambda",
+        "(begin (define f (lambda (x) (* x (/ (* 2 pi) 360) (sqrt (+ 1 (^ e 2)))))) "
+        "(map f (range 0 500 1)))", 100, 0));
+  result.push_back(program("range-length", "(length (range 0 1000000 1))", 1000, 0));
+  result.push_back(program("range-apply-sum", "(apply + (range 0 100000 1))", 20, 0));
+  result.push_back(program("pipeline-builtin-1M",
+        "(apply + (map - (map / (map sqrt (range 1 1000000 1)))))", 1, 0));
+  result.push_back(program("pipeline-map-1M",
+        "(length (map - (map / (map sqrt (range 1 1000000 1)))))", 1, 0));
+  result.push_back(program("pipeline-lambda-10k",
+        "(begin (define f (lambda (x) (* 2 x))) (define g (lambda (x) (+ x 1))) "
+        "(apply + (map f (map g (map - (range 0 10000 1))))))", 1, 0));
+  result.push_back(program("list-rest-chain",
+        "(begin (define l (map - (range 0 100000 1))) " +
+        nested("rest", 64, "l") + ")", 20, 0));
+  result.push_back(program("list-append-chain",
+        "(begin (define f (lambda (x) (append x 1))) " +
+        nested("f", 64, "(map - (range 0 10000 1))") + ")", 20, 0));
+
+  // lambda call overhead
+  result.push_back(program("lambda-call-nested",
+        "(begin (define f (lambda (x) x)) " + nested("f", 64, "1") + ")", 20000, 0, 64));
+
+  // plots at several sizes
+  const unsigned sizes[] = {10, 100, 1000};
+  for(auto n : sizes){
+    result.push_back(program("discrete-plot-" + std::to_string(n),
+          "(discrete-plot " + points(n) + ")", 20000 / n, 0, n));
+  }
+  const unsigned widths[] = {1, 10, 100};
+  for(auto w : widths){
+    result.push_back(program("continuous-plot-sin-" + std::to_string(w),
+          "(begin (define f (lambda (x) (sin x))) (continuous-plot f (list -" +
+          std::to_string(w) + " " + std::to_string(w) + ")))", 100));
+  }
+
+  // sampling of continuous plots, compiled to closures where possible
+  result.push_back(program("plot-sigmoid",
+        "(begin (define f (lambda (x) (/ 1 (+ 1 (^ e (- (* 20 x))))))) "
+        "(continuous-plot f (list -1 1)))", 200, 0));
+  result.push_back(program("plot-inlined-helper",
+        "(begin (define g (lambda (u) (* u (sin u)))) (define f (lambda (x) (+ (g x) (cos (* 3 x))))) "
+        "(continuous-plot f (list -10 10)))", 200, 0));
+
+  // map over a lambda compiled to a NumericFunction, in batches
+  result.push_back(program("map-compiled-20k",
+        "(begin (define f (lambda (x) (+ (* x x) (sin x) (cos x)))) "
+        "(length (map f (range 0 20000 1))))", 20, 0, 20001));
+
+  // scaling of parallel map over a pure lambda, the local define keeps it
+  // from being compiled
+  const unsigned threads[] = {1, 2, 4, 8};
+  for(auto t : threads){
+    result.push_back(program("parallel-map-t" + std::to_string(t),
+          "(begin (define f (lambda (x) (begin (define y (* x x)) (+ y (sin x) (cos x))))) "
+          "(length (map f (range 0 20000 1))))", 3, t, 20001));
+  }
+
+  // lambdas sampled point by point and in batches
+  sampling(result, "sample-sigmoid",
+        "(define f (lambda (x) (/ 1 (+ 1 (^ e (- (* 20 x)))))))", -1, 1);
+  sampling(result, "sample-inlined-helper",
+        "(begin (define g (lambda (u) (* u (sin u)))) "
+        "(define f (lambda (x) (+ (g x) (cos (* 3 x))))))", -10, 10);
+
+  // copies of the environment, made by every lambda call
+  result.push_back(environment_copy("environment-copy-default", "(define v0 0)", 20000));
+  result.push_back(environment_copy("environment-copy-400", definitions(200), 5000));
+
+  return result;
+}
+
+struct Result {
+  // time per repetition in microseconds
+  double median;
+  double minimum;
+  // heap allocations of list buffers per repetition
+  double allocations;
+  // items per second at the median time, 0 if the benchmark has no items
+  double throughput;
+};
+
+Result run(const Benchmark & bench){
+  std::function<void()> body = bench.setup();
+
+  // warm up once so the first repetition does not skew the times
+  body();
+
+  unsigned per_round = std::max(1u, bench.repetitions / ROUNDS);
+  std::vector<double> rounds;
+  std::size_t allocations = Arena::heapAllocations();
+  for(unsigned r = 0; r < ROUNDS; ++r){
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < per_round; ++i){
+      body();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::micro> elapsed = stop - start;
+    rounds.push_back(elapsed.count() / per_round);
+  }
+  allocations = Arena::heapAllocations() - allocations;
+
+  std::sort(rounds.begin(), rounds.end());
+  Result result;
+  result.median = rounds[ROUNDS / 2];
+  result.minimum = rounds[0];
+  result.allocations = static_cast<double>(allocations) / (ROUNDS * per_round);
+  result.throughput = bench.items ? bench.items / (result.median * 1e-6) : 0;
+  return result;
+}
+
+void write_json(std::ostream & out, const std::string & name, const Result & result, bool first){
+  out << (first ? "" : ",\n") << std::fixed << std::setprecision(3)
+      << "{\"name\":\"" << name << "\""
+      << ",\"median_us\":" << result.median
+      << ",\"min_us\":" << result.minimum
+      << ",\"allocs\":" << result.allocations
+      << ",\"items_per_second\":" << std::setprecision(0) << result.throughput << "}";
+}
+
+void write_text(std::ostream & out, const std::string & name, const Result & result){
+  out << std::left << std::setw(28) << name
+      << std::right << std::setw(14) << std::fixed << std::setprecision(3)
+      << result.median << " us/iter"
+      << std::setw(14) << result.minimum << " min"
+      << std::setw(12) << std::setprecision(1) << result.allocations << " allocs";
+  if(result.throughput > 0){
+    out << std::setw(14) << std::setprecision(0) << result.throughput << " items/s";
+  }
+  out << std::endl;
+}
+
+// the median times by name of a baseline written with --json
+std::map<std::string, double> read_baseline(const std::string & filename){
+  std::ifstream ifs(filename);
+  if(!ifs){
+    throw SemanticError("Error: could not open baseline " + filename);
+  }
+
+  std::map<std::string, double> baseline;
+  std::string line;
+  const std::string name_key = "\"name\":\"";
+  const std::string median_key = "\"median_us\":";
+  while(std::getline(ifs, line)){
+    std::size_t name = line.find(name_key);
+    std::size_t median = line.find(median_key);
+    if((name == std::string::npos) || (median == std::string::npos)) continue;
+    name += name_key.size();
+    baseline[line.substr(name, line.find('"', name) - name)] =
+      std::strtod(line.c_str() + median + median_key.size(), nullptr);
+  }
+  return baseline;
+}
+
+// write the change of each median from the baseline, false if one is
+// more than threshold percent slower
+bool compare(std::ostream & out, const std::map<std::string, double> & baseline,
+             const std::vector<std::pair<std::string, Result>> & results, double threshold){
+  bool ok = true;
+  out << std::left << std::setw(28) << "benchmark" << std::right << std::setw(14) << "baseline us"
+      << std::setw(14) << "current us" << std::setw(10) << "change" << std::endl;
+  for(auto & r : results){
+    auto found = baseline.find(r.first);
+    out << std::left << std::setw(28) << r.first << std::right << std::fixed << std::setprecision(3);
+    if(found == baseline.end()){
+      out << std::setw(14) << "-" << std::setw(14) << r.second.median << std::setw(10) << "new" << std::endl;
+      continue;
+    }
+    double change = 100 * (r.second.median - found->second) / found->second;
+    out << std::setw(14) << found->second << std::setw(14) << r.second.median
+        << std::setw(9) << std::setprecision(1) << std::showpos << change << std::noshowpos << "%";
+    if(change > threshold){
+      out << "  slower";
+      ok = false;
+    }
+    else if(change < -threshold){
+      out << "  faster";
+    }
+    out << std::endl;
+  }
+  return ok;
+}
+
+int main(int argc, char *argv[]){
+
+  std::string filter;
+  std::string baseline_file;
+  bool json = false;
+  double threshold = 10;
+  for(int i = 1; i < argc; ++i){
+    std::string arg = argv[i];
+    if(arg == "--json"){
+      json = true;
+    }
+    else if((arg == "--compare") && (i + 1 < argc)){
+      baseline_file = argv[++i];
+    }
+    else if((arg == "--threshold") && (i + 1 < argc)){
+      threshold = std::strtod(argv[++i], nullptr);
+    }
+    else if(filter.empty() && (arg.compare(0, 2, "--") != 0)){
+      filter = arg;
+    }
+    else{
+      std::cerr << "Error: usage plotscript_bench [--json] [--compare baseline.json] "
+                << "[--threshold percent] [name-filter]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  try{
+    std::map<std::string, double> baseline;
+    if(!baseline_file.empty()){
+      baseline = read_baseline(baseline_file);
+    }
+
+    std::vector<std::pair<std::string, Result>> results;
+    if(json){
+      std::cout << "{\"benchmarks\":[\n";
+    }
+    for(auto & bench : benchmarks()){
+      if(bench.name.find(filter) == std::string::npos) continue;
+
+      Result result = run(bench);
+      results.push_back(std::make_pair(bench.name, result));
+      if(json){
+        write_json(std::cout, bench.name, result, results.size() == 1);
+      }
+      else{
+        write_text(std::cout, bench.name, result);
+      }
+    }
+    if(json){
+      std::cout << "\n]}" << std::endl;
+    }
+
+    if(!baseline_file.empty()){
+      std::ostream & out = json ? std::cerr : std::cout;
+      out << std::endl;
+      if(!compare(out, baseline, results, threshold)){
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  catch(const SemanticError & ex){
+    std::cerr << ex.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+/*! \file bounded_queue.hpp
+Defines the BoundedQueue handing values from one thread to another.
+ */
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/*! \class BoundedQueue
+\brief A first-in first-out queue of at most capacity values, safe to use
+from several threads.
+
+push blocks while the queue is full and pop while it is empty, until the
+queue is closed. Values pushed before close can still be popped.
+*/
+template<typename T>
+class BoundedQueue {
+public:
+
+  /// Construct an empty queue holding at most capacity values, at least 1
+  explicit BoundedQueue(std::size_t capacity): m_capacity(capacity ? capacity : 1), m_closed(false) {}
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue & operator=(const BoundedQueue &) = delete;
+
+  /*! Append value, waiting while the queue is full.
+    \return false if the queue was closed and value was dropped
+   */
+  bool push(T value){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_full.wait(lock, [this](){ return m_closed || (m_values.size() < m_capacity); });
+    if(m_closed) return false;
+    m_values.push_back(std::move(value));
+    m_not_empty.notify_one();
+    return true;
+  }
+
+  /*! Remove the first value, waiting while the queue is empty.
+    \return false if the queue is closed and empty
+   */
+  bool pop(T & value){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_empty.wait(lock, [this](){ return m_closed || !m_values.empty(); });
+    if(m_values.empty()) return false;
+    value = std::move(m_values.front());
+    m_values.pop_front();
+    m_not_full.notify_one();
+    return true;
+  }
+
+  /// refuse further values and wake every waiting thread
+  void close(){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+  }
+
+  /// number of values queued
+  std::size_t size() const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_values.size();
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_not_full;
+  std::deque<T> m_values;
+  std::size_t m_capacity;
+  bool m_closed;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+
+TEST_CASE( "Test bounded queue order and close", "[bounded_queue]" ) {
+
+  BoundedQueue<int> queue(4);
+  REQUIRE(queue.push(1));
+  REQUIRE(queue.push(2));
+  REQUIRE(queue.size() == 2);
+
+  int value = 0;
+  REQUIRE(queue.pop(value));
+  REQUIRE(value == 1);
+
+  // values pushed before close are still popped
+  queue.close();
+  REQUIRE_FALSE(queue.push(3));
+  REQUIRE(queue.pop(value));
+  REQUIRE(value == 2);
+  REQUIRE_FALSE(queue.pop(value));
+}
+
+TEST_CASE( "Test bounded queue between threads", "[bounded_queue]" ) {
+
+  BoundedQueue<int> queue(2);
+  const int count = 10000;
+
+  // assertions are only made on the main thread
+  bool bounded = true;
+  std::thread producer([&queue, &bounded](){
+      for(int i = 0; i < count; ++i){
+        queue.push(i);
+        bounded = bounded && (queue.size() <= 2);
+      }
+      queue.close();
+    });
+
+  std::vector<int> values;
+  int value;
+  while(queue.pop(value)){
+    values.push_back(value);
+  }
+  producer.join();
+
+  REQUIRE(bounded);
+  REQUIRE(values.size() == count);
+  for(int i = 0; i < count; ++i){
+    REQUIRE(values[i] == i);
+  }
+}
+
+TEST_CASE( "Test close wakes a blocked producer", "[bounded_queue]" ) {
+
+  BoundedQueue<int> queue(1);
+  REQUIRE(queue.push(0));
+
+  bool pushed = true;
+  std::thread producer([&queue, &pushed](){ pushed = queue.push(1); });
+  queue.close();
+  producer.join();
+
+  REQUIRE_FALSE(pushed);
+}
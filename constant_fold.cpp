@@ -0,0 +1,157 @@
+#include "constant_fold.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// built-in procedures whose value depends only on their arguments
+const char * PURE_PROCEDURES[] = {
+  "+", "-", "*", "/", "^", "sqrt", "ln", "sin", "cos", "tan",
+  "real", "imag", "mag", "arg", "conj"
+};
+
+// built-in constants that may be folded
+const char * CONSTANTS[] = {"pi", "e", "I"};
+
+// special forms whose first argument is not evaluated as an expression
+const char * UNEVALUATED_FIRST[] = {
+  "define", "lambda", "apply", "map", "memoize", "set-property", "continuous-plot"
+};
+
+template<std::size_t N>
+bool contains(const char * (&names)[N], const std::string & name){
+  return std::find(std::begin(names), std::end(names), name) != std::end(names);
+}
+
+// a number or complex, which evaluates to itself
+bool is_literal(const Expression & exp){
+  return (exp.tailSize() == 0) && (exp.isHeadNumber() || exp.isHeadComplex()) && exp.prop().empty();
+}
+
+bool is_pure_procedure(const Atom & op, const Environment & env){
+  return op.isSymbol() && env.is_proc(op) && contains(PURE_PROCEDURES, op.asSymbol());
+}
+
+}
+
+Expression ConstantFolder::fold(const Expression & ast, const Environment & env){
+  find_bindings(ast);
+
+  bool folded = false;
+  return fold_node(ast, env, folded);
+}
+
+// remember the constants bound by a define or a lambda parameter in exp
+void ConstantFolder::find_bindings(const Expression & exp){
+  if(exp.tailSize() == 0) return;
+
+  if(exp.head().isSymbol()){
+    const std::string name = exp.head().asSymbol();
+    const Expression & first = *exp.tailConstBegin();
+    if((name == "define") && first.isHeadSymbol() && contains(CONSTANTS, first.head().asSymbol())){
+      rebound.insert(first.head().asSymbol());
+    }
+    else if(name == "lambda"){
+      if(first.isHeadSymbol() && contains(CONSTANTS, first.head().asSymbol())){
+        rebound.insert(first.head().asSymbol());
+      }
+      for(auto p = first.tailConstBegin(); p != first.tailConstEnd(); ++p){
+        if(p->isHeadSymbol() && contains(CONSTANTS, p->head().asSymbol())){
+          rebound.insert(p->head().asSymbol());
+        }
+      }
+    }
+  }
+
+  for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
+    find_bindings(*e);
+  }
+}
+
+unsigned ConstantFolder::foldable(const Environment & env) const{
+  unsigned result = 0;
+  for(std::size_t i = 0; i < std::extent<decltype(CONSTANTS)>::value; ++i){
+    if(is_foldable(CONSTANTS[i], env)){
+      result |= 1u << i;
+    }
+  }
+  return result;
+}
+
+// true if name is a built-in constant that is not bound and has its built-in value
+bool ConstantFolder::is_foldable(const std::string & name, const Environment & env) const{
+  if(!contains(CONSTANTS, name) || (rebound.find(name) != rebound.end())) return false;
+
+  static const Environment defaults;
+  Atom constant(name);
+  return env.get_exp(constant) == defaults.get_exp(constant);
+}
+
+// the value exp evaluates to if it is a literal or an unbound constant
+bool ConstantFolder::constant_value(const Expression & exp, const Environment & env, Expression & value) const{
+  if(is_literal(exp)){
+    value = Expression(exp.head());
+    return true;
+  }
+
+  if((exp.tailSize() != 0) || !exp.isHeadSymbol() || !is_foldable(exp.head().asSymbol(), env)) return false;
+
+  value = env.get_exp(exp.head());
+  return true;
+}
+
+// fold the children of exp that are evaluated, then exp itself. folded is
+// set when the result differs from exp, otherwise exp is returned
+Expression ConstantFolder::fold_node(const Expression & exp, const Environment & env, bool & folded) const{
+  if(exp.tailSize() == 0) return exp;
+
+  std::string name = exp.isHeadSymbol() ? exp.head().asSymbol() : std::string();
+
+  // get-property looks its second argument up by name
+  if(name == "get-property") return exp;
+
+  std::size_t first = contains(UNEVALUATED_FIRST, name) ? 1 : 0;
+
+  Expression result(exp.head());
+  bool changed = false;
+  std::size_t i = 0;
+  for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e, ++i){
+    if(i < first){
+      result.append(*e);
+    }
+    else{
+      result.append(fold_node(*e, env, changed));
+    }
+  }
+
+  if(is_pure_procedure(exp.head(), env)){
+    std::vector<Expression> args;
+    bool constant = true;
+    for(auto e = result.tailConstBegin(); constant && (e != result.tailConstEnd()); ++e){
+      Expression value;
+      constant = constant_value(*e, env, value);
+      args.push_back(value);
+    }
+
+    if(constant){
+      try{
+        Expression value = env.get_proc(exp.head())(args);
+        if(is_literal(value)){
+          folded = true;
+          return Expression(value.head());
+        }
+      }
+      catch(...){
+        // not folded, evaluation raises the error
+      }
+    }
+  }
+
+  if(!changed) return exp;
+
+  folded = true;
+  return result;
+}
@@ -0,0 +1,54 @@
+/*! \file constant_fold.hpp
+Defines the ConstantFolder pass run between parsing and evaluation.
+ */
+#ifndef CONSTANT_FOLD_HPP
+#define CONSTANT_FOLD_HPP
+
+#include <set>
+#include <string>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class ConstantFolder
+\brief Replaces calls of pure built-in procedures on constants by their values.
+
+A call such as (/ (* 2 pi) 360) is folded when its procedure is a pure
+arithmetic built-in and every argument is a number, a complex, one of the
+built-in constants pi, e and I, or a call that was itself folded. Calls
+are folded anywhere they would be evaluated, including lambda bodies. A
+call whose procedure throws is left as it is, so the error is still
+raised when the program is evaluated.
+
+A constant is only folded while it has its built-in value and no program
+seen by the folder binds its name with define or as a lambda parameter.
+Lambdas folded before such a program keep the built-in value.
+*/
+class ConstantFolder {
+public:
+
+  /*! Fold the constant calls of a parsed program.
+    \param ast the program returned by parse
+    \param env the environment the program will be evaluated in
+    \return the folded program, subtrees without folded calls are shared with ast
+   */
+  Expression fold(const Expression & ast, const Environment & env);
+
+  /*! The built-in constants that are folded in env, one bit each. Folding
+    a program again gives the same result as its last fold as long as
+    this is the same as it was right after that fold.
+   */
+  unsigned foldable(const Environment & env) const;
+
+private:
+
+  // built-in constants some program has bound
+  std::set<std::string> rebound;
+
+  bool is_foldable(const std::string & name, const Environment & env) const;
+  void find_bindings(const Expression & exp);
+  bool constant_value(const Expression & exp, const Environment & env, Expression & value) const;
+  Expression fold_node(const Expression & exp, const Environment & env, bool & folded) const;
+};
+
+#endif
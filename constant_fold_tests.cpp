@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <string>
+
+#include "constant_fold.hpp"
+#include "environment.hpp"
+#include "semantic_error.hpp"
+#include "test_helpers.hpp"
+
+static Expression fold_program(ConstantFolder & folder, const std::string & program){
+  Environment env;
+  return folder.fold(parse_text(program), env);
+}
+
+TEST_CASE( "Test folding of constant calls", "[constant_fold]" ) {
+
+  ConstantFolder folder;
+
+  REQUIRE(fold_program(folder, "(/ (* 2 pi) 360)") == Expression(2 * std::atan2(0, -1) / 360));
+  REQUIRE(fold_program(folder, "(+ 1 (* 2 3))") == Expression(7.));
+  REQUIRE(fold_program(folder, "(* 2 I)") == Expression(std::complex<double>(0, 2)));
+
+  // inside lambda bodies, but not the parameter list
+  REQUIRE(fold_program(folder, "(define f (lambda (x) (* x (+ 1 2))))") ==
+    parse_text("(define f (lambda (x) (* x 3)))"));
+
+  // arguments of special forms that are evaluated
+  REQUIRE(fold_program(folder, "(apply + (list (+ 1 2) (- 1)))") ==
+    parse_text("(apply + (list 3 -1))"));
+}
+
+TEST_CASE( "Test calls that are not folded", "[constant_fold]" ) {
+
+  ConstantFolder folder;
+
+  // unchanged programs are returned as they are
+  std::vector<std::string> programs = {
+    "(+ x 1)",
+    "(first (list 1 2))",
+    "(ln -1)",
+    "(sqrt 1 2)",
+    "(+ 1 \"a\")",
+    "(get-property \"a\" (+ 1 2))",
+  };
+  for(auto & program : programs){
+    Expression ast = parse_text(program);
+    Environment env;
+    Expression folded = folder.fold(ast, env);
+    REQUIRE(folded == ast);
+    REQUIRE(&*folded.tailConstBegin() == &*ast.tailConstBegin());
+  }
+}
+
+TEST_CASE( "Test rebound constants are not folded", "[constant_fold]" ) {
+
+  ConstantFolder folder;
+
+  std::string program = "(begin (define pi 3) (* 2 pi))";
+  REQUIRE(fold_program(folder, program) == parse_text(program));
+
+  program = "(lambda (e) (* 2 e))";
+  REQUIRE(fold_program(folder, program) == parse_text(program));
+
+  // once bound, a constant is not folded in later programs either
+  REQUIRE(fold_program(folder, "(* 2 e)") == parse_text("(* 2 e)"));
+  REQUIRE(fold_program(folder, "(* 2 pi)") == parse_text("(* 2 pi)"));
+  REQUIRE(fold_program(folder, "(* 2 I)") == Expression(std::complex<double>(0, 2)));
+}
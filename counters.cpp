@@ -0,0 +1,100 @@
+#include "counters.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+std::atomic<std::uint64_t> Counters::s_counts[Counters::COUNTER_COUNT];
+
+Counters::Counts Counters::Counts::operator-(const Counts & before) const noexcept{
+  Counts result;
+  for(int i = 0; i < COUNTER_COUNT; ++i){
+    result.value[i] = value[i] - before.value[i];
+  }
+  return result;
+}
+
+bool Counters::compiled() noexcept{
+#ifdef PLOTSCRIPT_COUNTERS
+  return true;
+#else
+  return false;
+#endif
+}
+
+Counters::Counts Counters::snapshot() noexcept{
+  Counts result;
+  for(int i = 0; i < COUNTER_COUNT; ++i){
+    result.value[i] = s_counts[i].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+const char * Counters::name(Counter c) noexcept{
+  switch(c){
+  case EXPRESSION_COPIES: return "expression copies";
+  case EXPRESSION_ASSIGNMENTS: return "expression assignments";
+  case SYMBOL_STRINGS: return "symbol strings";
+  case ENVIRONMENT_COPIES: return "environment copies";
+  case HEAP_ALLOCATIONS: return "heap allocations";
+  default: return "";
+  }
+}
+
+void Counters::report(const Counts & counts, std::ostream & out){
+  for(int i = 0; i < COUNTER_COUNT; ++i){
+    Counter c = static_cast<Counter>(i);
+    out << std::left << std::setw(24) << name(c) << std::right << counts[c] << "\n";
+  }
+  out << std::left;
+}
+
+#ifdef PLOTSCRIPT_COUNTERS
+
+// count every heap allocation of the process, freeing with std::free
+
+void * operator new(std::size_t bytes){
+  Counters::count(Counters::HEAP_ALLOCATIONS);
+  void * p = std::malloc(bytes ? bytes : 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+
+void * operator new[](std::size_t bytes){
+  return ::operator new(bytes);
+}
+
+void * operator new(std::size_t bytes, const std::nothrow_t &) noexcept{
+  Counters::count(Counters::HEAP_ALLOCATIONS);
+  return std::malloc(bytes ? bytes : 1);
+}
+
+void * operator new[](std::size_t bytes, const std::nothrow_t &) noexcept{
+  return ::operator new(bytes, std::nothrow);
+}
+
+void operator delete(void * p) noexcept{
+  std::free(p);
+}
+
+void operator delete[](void * p) noexcept{
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept{
+  std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept{
+  std::free(p);
+}
+
+void operator delete(void * p, const std::nothrow_t &) noexcept{
+  std::free(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t &) noexcept{
+  std::free(p);
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*! \file counters.hpp
+Defines the Counters of copies and heap allocations made by the interpreter.
+ */
+#ifndef COUNTERS_HPP
+#define COUNTERS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+/*! \class Counters
+\brief Process-wide counts of Expression copies, symbol strings, Environment
+copies and heap allocations.
+
+Counting is compiled in only when the build is configured with
+-DPLOTSCRIPT_COUNTERS=ON, which also replaces the global operator new to
+count heap allocations. Otherwise Counters::count compiles to nothing and
+every count stays 0.
+
+Counts are shared by all threads, so the difference of two snapshots taken
+around an evaluation includes the work of its parallel map workers, and of
+any other interpreter evaluating at the same time.
+*/
+class Counters {
+public:
+
+  /// what is counted
+  enum Counter {
+    EXPRESSION_COPIES,      ///< Expression copy constructions
+    EXPRESSION_ASSIGNMENTS, ///< Expression copy assignments
+    SYMBOL_STRINGS,         ///< strings copied out of an Atom by asSymbol
+    ENVIRONMENT_COPIES,     ///< Environment copy constructions and assignments
+    HEAP_ALLOCATIONS,       ///< calls of the global operator new
+    COUNTER_COUNT
+  };
+
+  /// a snapshot of every count
+  struct Counts {
+    std::uint64_t value[COUNTER_COUNT];
+
+    std::uint64_t operator[](Counter c) const noexcept { return value[c]; }
+
+    /// the counts made between snapshot before and this snapshot
+    Counts operator-(const Counts & before) const noexcept;
+  };
+
+  /// true if counting was compiled in
+  static bool compiled() noexcept;
+
+  /// count one event of counter c
+  static void count(Counter c) noexcept {
+#ifdef PLOTSCRIPT_COUNTERS
+    s_counts[c].fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)c;
+#endif
+  }
+
+  /// the current counts
+  static Counts snapshot() noexcept;
+
+  /// a short name of counter c
+  static const char * name(Counter c) noexcept;
+
+  /// write a table of counts, one counter per line
+  static void report(const Counts & counts, std::ostream & out);
+
+private:
+
+  static std::atomic<std::uint64_t> s_counts[COUNTER_COUNT];
+};
+
+/*! \class CountedCopy
+\brief A member that counts the copies of the object holding it as
+counter C. Moves are not counted.
+*/
+template<Counters::Counter C>
+class CountedCopy {
+public:
+  CountedCopy() = default;
+  CountedCopy(const CountedCopy &) noexcept { Counters::count(C); }
+  CountedCopy(CountedCopy &&) = default;
+  CountedCopy & operator=(const CountedCopy &) noexcept { Counters::count(C); return *this; }
+  CountedCopy & operator=(CountedCopy &&) = default;
+};
+
+#endif
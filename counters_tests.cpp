@@ -0,0 +1,77 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "counters.hpp"
+#include "interpreter.hpp"
+
+static Counters::Counts evaluate(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  interp.evaluate();
+  return interp.stats();
+}
+
+// a program defining big-list as a literal list of n numbers
+static std::string big_list(std::size_t n){
+  std::string program = "(define big-list (list";
+  for(std::size_t i = 0; i < n; ++i){
+    program += " " + std::to_string(i);
+  }
+  return program + "))";
+}
+
+TEST_CASE( "Test difference of counts", "[counters]" ) {
+
+  Counters::Counts before = Counters::snapshot();
+  Counters::count(Counters::ENVIRONMENT_COPIES);
+  Counters::Counts after = Counters::snapshot();
+
+  Counters::Counts difference = after - before;
+  REQUIRE(difference[Counters::ENVIRONMENT_COPIES] == (Counters::compiled() ? 1 : 0));
+
+  std::ostringstream report;
+  Counters::report(difference, report);
+  REQUIRE(report.str().find("environment copies") != std::string::npos);
+  REQUIRE(report.str().find("heap allocations") != std::string::npos);
+}
+
+TEST_CASE( "Test counts of an evaluation", "[counters]" ) {
+
+  Interpreter interp;
+  Counters::Counts counts = evaluate(interp, "(begin (define f (lambda (x) (+ x 1))) (f 1) \"text\")");
+
+  if(!Counters::compiled()){
+    for(int i = 0; i < Counters::COUNTER_COUNT; ++i){
+      REQUIRE(counts[static_cast<Counters::Counter>(i)] == 0);
+    }
+  }
+  else{
+    // a lambda call binds its parameters in a copy of the environment
+    REQUIRE(counts[Counters::ENVIRONMENT_COPIES] >= 1);
+    REQUIRE(counts[Counters::EXPRESSION_COPIES] > 0);
+    REQUIRE(counts[Counters::SYMBOL_STRINGS] > 0);
+    REQUIRE(counts[Counters::HEAP_ALLOCATIONS] > 0);
+  }
+}
+
+TEST_CASE( "Test first of a list copies a constant number of expressions", "[counters]" ) {
+
+  if(!Counters::compiled()){
+    WARN("skipped, configure with -DPLOTSCRIPT_COUNTERS=ON to count copies");
+    return;
+  }
+
+  Interpreter small;
+  evaluate(small, big_list(10));
+  Counters::Counts small_counts = evaluate(small, "(first big-list)");
+
+  Interpreter big;
+  evaluate(big, big_list(10000));
+  Counters::Counts big_counts = evaluate(big, "(first big-list)");
+
+  REQUIRE(big_counts[Counters::EXPRESSION_COPIES] == small_counts[Counters::EXPRESSION_COPIES]);
+  REQUIRE(big_counts[Counters::EXPRESSION_ASSIGNMENTS] == small_counts[Counters::EXPRESSION_ASSIGNMENTS]);
+  REQUIRE(big_counts[Counters::EXPRESSION_COPIES] < 100);
+}
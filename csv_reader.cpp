@@ -0,0 +1,303 @@
+#include "csv_reader.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <locale>
+#include <sstream>
+
+#include "semantic_error.hpp"
+#include "thread_pool.hpp"
+
+// powers of ten that are exact doubles
+const double POWERS[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// largest mantissa that is an exact double
+const std::uint64_t MAX_EXACT = std::uint64_t(1) << 53;
+
+// the digits kept of a mantissa, more are only used by the slow path
+const int MAX_DIGITS = 19;
+
+// drop the spaces, carriage returns and double quotes around a field
+static void trim(const char *& begin, const char *& end){
+  while((begin < end) && ((*begin == ' ') || (*begin == '\t') || (*begin == '\r'))) ++begin;
+  while((end > begin) && ((end[-1] == ' ') || (end[-1] == '\t') || (end[-1] == '\r'))) --end;
+  if((end - begin >= 2) && (*begin == '"') && (end[-1] == '"')){
+    ++begin;
+    --end;
+  }
+}
+
+// the end of the line starting at begin, before its newline if it has one
+static const char * line_end(const char * begin, const char * end){
+  const void * newline = std::memchr(begin, '\n', end - begin);
+  return newline ? static_cast<const char *>(newline) : end;
+}
+
+// the end of the field starting at begin on a line ending at end
+static const char * field_end(const char * begin, const char * end, char delimiter){
+  const void * found = std::memchr(begin, delimiter, end - begin);
+  return found ? static_cast<const char *>(found) : end;
+}
+
+bool CsvReader::parseNumber(const char * begin, const char * end, double & value){
+  const char * p = begin;
+  bool negative = false;
+  if((p < end) && ((*p == '-') || (*p == '+'))){
+    negative = (*p == '-');
+    ++p;
+  }
+
+  std::uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  bool truncated = false;
+  for(; (p < end) && (*p >= '0') && (*p <= '9'); ++p){
+    any = true;
+    if(digits < MAX_DIGITS){
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += (mantissa != 0);
+    }
+    else{
+      ++exponent;
+      truncated = truncated || (*p != '0');
+    }
+  }
+  if((p < end) && (*p == '.')){
+    ++p;
+    for(; (p < end) && (*p >= '0') && (*p <= '9'); ++p){
+      any = true;
+      if(digits < MAX_DIGITS){
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += (mantissa != 0);
+        --exponent;
+      }
+      else{
+        truncated = truncated || (*p != '0');
+      }
+    }
+  }
+  if(!any) return false;
+
+  if((p < end) && ((*p == 'e') || (*p == 'E'))){
+    ++p;
+    bool negative_exponent = false;
+    if((p < end) && ((*p == '-') || (*p == '+'))){
+      negative_exponent = (*p == '-');
+      ++p;
+    }
+    if((p == end) || (*p < '0') || (*p > '9')) return false;
+    int written = 0;
+    for(; (p < end) && (*p >= '0') && (*p <= '9'); ++p){
+      if(written < 100000) written = written * 10 + (*p - '0');
+    }
+    exponent += negative_exponent ? -written : written;
+  }
+  if(p != end) return false;
+
+  if(mantissa == 0){
+    value = negative ? -0.0 : 0.0;
+    return true;
+  }
+
+  // one exact product or quotient of exact doubles is correctly rounded
+  if(!truncated && (mantissa <= MAX_EXACT) && (exponent >= -22) && (exponent <= 22)){
+    double m = static_cast<double>(mantissa);
+    value = (exponent < 0) ? m / POWERS[-exponent] : m * POWERS[exponent];
+    if(negative) value = -value;
+    return true;
+  }
+
+  std::istringstream stream(std::string(begin, end));
+  stream.imbue(std::locale::classic());
+  stream >> value;
+  return !stream.fail() && stream.eof();
+}
+
+CsvReader::CsvReader(const std::string & path):
+  m_path(path), m_file(path), m_delimiter(','), m_columns(0), m_begin(nullptr), m_end(nullptr), m_first_line(1){
+
+  if(!m_file.isOpen()){
+    throw SemanticError("Error in call to read-csv: could not open " + path);
+  }
+
+  const char * p = m_file.data();
+  const char * end = p + m_file.size();
+  if((end - p >= 3) && (std::memcmp(p, "\xEF\xBB\xBF", 3) == 0)){
+    p += 3;
+  }
+  m_begin = p;
+  m_end = end;
+
+  // the first line that is not empty decides the delimiter and the header
+  std::size_t line = 1;
+  while(p < end){
+    const char * stop = line_end(p, end);
+    const char * b = p;
+    const char * e = stop;
+    trim(b, e);
+    if(b == e){
+      p = stop + (stop < end);
+      ++line;
+      continue;
+    }
+
+    m_delimiter = std::memchr(p, '\t', stop - p) ? '\t' : ',';
+    std::vector<std::string> names;
+    bool numbers = true;
+    for(const char * field = p; ; ){
+      const char * next = field_end(field, stop, m_delimiter);
+      const char * fb = field;
+      const char * fe = next;
+      trim(fb, fe);
+      double value;
+      numbers = numbers && parseNumber(fb, fe, value);
+      names.emplace_back(fb, fe);
+      if(next == stop) break;
+      field = next + 1;
+    }
+    m_columns = names.size();
+    if(!numbers){
+      m_header.swap(names);
+      m_begin = stop + (stop < end);
+      m_first_line = line + 1;
+    }
+    break;
+  }
+}
+
+std::size_t CsvReader::column(const std::string & name) const{
+  for(std::size_t i = 0; i < m_header.size(); ++i){
+    if(m_header[i] == name) return i;
+  }
+  throw SemanticError("Error in call to read-csv: no column named " + name + " in " + m_path);
+}
+
+namespace {
+
+// the numbers of the columns in one chunk of lines
+struct Chunk {
+  const char * begin;
+  const char * end;
+  std::vector<std::vector<double>> values;
+  // lines parsed, and the line of the first error from 1, 0 if there is none
+  std::size_t lines;
+  std::size_t error_line;
+  std::string error;
+};
+
+}
+
+static void parse_chunk(Chunk & chunk, const std::vector<std::size_t> & columns,
+                        const std::vector<char> & needed, char delimiter){
+  std::size_t last = needed.size() - 1;
+  std::vector<double> row(needed.size());
+  chunk.values.assign(columns.size(), std::vector<double>());
+  chunk.lines = 0;
+  chunk.error_line = 0;
+
+  for(const char * p = chunk.begin; p < chunk.end; ){
+    const char * stop = line_end(p, chunk.end);
+    ++chunk.lines;
+
+    const char * b = p;
+    const char * e = stop;
+    trim(b, e);
+    if(b != e){
+      std::size_t i = 0;
+      for(const char * field = p; i <= last; ++i){
+        const char * next = field_end(field, stop, delimiter);
+        if(needed[i]){
+          const char * fb = field;
+          const char * fe = next;
+          trim(fb, fe);
+          if(!CsvReader::parseNumber(fb, fe, row[i])){
+            chunk.error_line = chunk.lines;
+            chunk.error = "column " + std::to_string(i) + " is not a number";
+            return;
+          }
+        }
+        if(next == stop){
+          ++i;
+          break;
+        }
+        field = next + 1;
+      }
+      if(i <= last){
+        chunk.error_line = chunk.lines;
+        chunk.error = "has only " + std::to_string(i) + " columns";
+        return;
+      }
+      for(std::size_t k = 0; k < columns.size(); ++k){
+        chunk.values[k].push_back(row[columns[k]]);
+      }
+    }
+    p = stop + (stop < chunk.end);
+  }
+}
+
+std::vector<std::vector<double>> CsvReader::read(const std::vector<std::size_t> & columns) const{
+  std::vector<std::vector<double>> result(columns.size());
+  if(columns.empty()) return result;
+
+  std::size_t last = 0;
+  for(std::size_t c : columns){
+    if(c >= m_columns){
+      throw SemanticError("Error in call to read-csv: no column " + std::to_string(c) + " in " + m_path +
+                          ", its first line has " + std::to_string(m_columns));
+    }
+    last = std::max(last, c);
+  }
+  std::vector<char> needed(last + 1, 0);
+  for(std::size_t c : columns){
+    needed[c] = 1;
+  }
+
+  // chunks of about CHUNK_SIZE bytes, each ending after a newline
+  std::vector<Chunk> chunks;
+  for(const char * p = m_begin; p < m_end; ){
+    const char * stop = m_end;
+    if(static_cast<std::size_t>(m_end - p) > CHUNK_SIZE){
+      stop = line_end(p + CHUNK_SIZE, m_end);
+      stop += (stop < m_end);
+    }
+    Chunk chunk;
+    chunk.begin = p;
+    chunk.end = stop;
+    chunks.push_back(chunk);
+    p = stop;
+  }
+
+  auto body = [&](std::size_t begin, std::size_t end){
+    for(std::size_t i = begin; i < end; ++i){
+      parse_chunk(chunks[i], columns, needed, m_delimiter);
+    }
+  };
+  if(chunks.size() > 1){
+    ThreadPool::shared()->parallelFor(chunks.size(), 1, body);
+  }
+  else{
+    body(0, chunks.size());
+  }
+
+  std::size_t line = m_first_line;
+  std::size_t total = 0;
+  for(auto & chunk : chunks){
+    if(chunk.error_line != 0){
+      throw SemanticError("Error in call to read-csv: line " + std::to_string(line + chunk.error_line - 1) +
+                          " of " + m_path + " " + chunk.error);
+    }
+    line += chunk.lines;
+    total += chunk.values[0].size();
+  }
+
+  for(std::size_t k = 0; k < columns.size(); ++k){
+    result[k].reserve(total);
+    for(auto & chunk : chunks){
+      result[k].insert(result[k].end(), chunk.values[k].begin(), chunk.values[k].end());
+    }
+  }
+  return result;
+}
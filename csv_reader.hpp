@@ -0,0 +1,75 @@
+/*! \file csv_reader.hpp
+Defines the CsvReader reading numeric columns of CSV and TSV files.
+ */
+#ifndef CSV_READER_HPP
+#define CSV_READER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+/*! \class CsvReader
+\brief Reads columns of numbers from a mapped CSV or TSV file.
+
+Fields are separated by tabs if the first line has one and by commas
+otherwise. Spaces and double quotes around a field are ignored, as are
+empty lines. The first line is a header naming the columns if any of its
+fields is not a number. Columns are counted from 0.
+
+Large files are split at line ends into chunks that are parsed in
+parallel on the shared ThreadPool. Errors are reported as SemanticErrors
+naming the line, the first in the file if there are several.
+*/
+class CsvReader {
+public:
+
+  /// bytes of the file parsed by one task
+  static const std::size_t CHUNK_SIZE = 1 << 20;
+
+  /// map the file at path, throws a SemanticError if it cannot be opened
+  explicit CsvReader(const std::string & path);
+
+  /// the field separator, a tab or a comma
+  char delimiter() const noexcept { return m_delimiter; }
+
+  /// the names of the columns, empty if the file has no header
+  const std::vector<std::string> & header() const noexcept { return m_header; }
+
+  /// the number of fields of the first line that is not empty, 0 if there is none
+  std::size_t columns() const noexcept { return m_columns; }
+
+  /// the column named name in the header, throws a SemanticError if there is none
+  std::size_t column(const std::string & name) const;
+
+  /*! Parse the numbers of columns in every line after the header.
+    \return one vector of numbers per column, in the order given
+    \throws SemanticError if a column is not below columns(), if a line
+    is missing one of the columns or if one of its fields is not a number
+   */
+  std::vector<std::vector<double>> read(const std::vector<std::size_t> & columns) const;
+
+  /*! Parse a number written in decimal, with an optional sign, fraction
+    and exponent, that takes all of [begin, end). The value is the nearest
+    double, in any locale.
+    \return false if the text is not such a number
+   */
+  static bool parseNumber(const char * begin, const char * end, double & value);
+
+private:
+  std::string m_path;
+  MappedFile m_file;
+  char m_delimiter;
+  std::vector<std::string> m_header;
+  std::size_t m_columns;
+
+  // the lines after the header
+  const char * m_begin;
+  const char * m_end;
+
+  // the line number of the first line after the header, from 1
+  std::size_t m_first_line;
+};
+
+#endif
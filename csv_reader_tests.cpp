@@ -0,0 +1,145 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <locale>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "csv_reader.hpp"
+#include "semantic_error.hpp"
+
+// write text to the file at path, replacing it
+static void write_file(const std::string & path, const std::string & text){
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << text;
+  REQUIRE(out.good());
+}
+
+static bool parse(const std::string & text, double & value){
+  return CsvReader::parseNumber(text.data(), text.data() + text.size(), value);
+}
+
+TEST_CASE( "Test CsvReader parses numbers", "[csv_reader]" ) {
+
+  std::string valid[] = {"0", "-0", "1", "+2", "-3.25", ".5", "5.", "1e3", "1E-3", "-2.5e+10",
+    "0.1", "0.30000000000000004", "123456789012345678901234567890", "1e-320", "1.7976931348623157e308",
+    "0.000000000000000000000000001", "9007199254740993"};
+  for(auto & text : valid){
+    double value, expected;
+    std::istringstream stream(text);
+    stream.imbue(std::locale::classic());
+    stream >> expected;
+    REQUIRE(parse(text, value));
+    REQUIRE(value == expected);
+  }
+
+  // random doubles written with enough digits read back exactly
+  std::mt19937_64 random(3574);
+  std::uniform_real_distribution<double> uniform(-1e6, 1e6);
+  for(int i = 0; i < 10000; ++i){
+    double expected = uniform(random);
+    char text[64];
+    std::snprintf(text, sizeof(text), (i % 2) ? "%.17g" : "%.6f", expected);
+    std::istringstream stream(text);
+    stream.imbue(std::locale::classic());
+    stream >> expected;
+    double value;
+    REQUIRE(parse(text, value));
+    REQUIRE(value == expected);
+  }
+
+  std::string invalid[] = {"", "-", ".", "e5", "1e", "1e+", "1.2.3", "abc", "1,5", "0x10", "1 2", "nan"};
+  for(auto & text : invalid){
+    double value;
+    REQUIRE_FALSE(parse(text, value));
+  }
+}
+
+TEST_CASE( "Test CsvReader reads columns", "[csv_reader]" ) {
+
+  std::string path = "csv_reader_tests.csv";
+
+  SECTION( "a header, quotes, carriage returns and empty lines" ){
+    write_file(path, "\xEF\xBB\xBF\r\n\"time\", \"value\",note\r\n0,1.5,a\r\n\r\n1, \"2.5\" ,b\r\n2,-3e2,c");
+    CsvReader reader(path);
+    REQUIRE(reader.delimiter() == ',');
+    REQUIRE(reader.header() == std::vector<std::string>({"time", "value", "note"}));
+    REQUIRE(reader.column("value") == 1);
+    REQUIRE_THROWS_AS(reader.column("missing"), SemanticError);
+
+    std::vector<std::vector<double>> values = reader.read({1, 0});
+    REQUIRE(values.size() == 2);
+    REQUIRE(values[0] == std::vector<double>({1.5, 2.5, -300}));
+    REQUIRE(values[1] == std::vector<double>({0, 1, 2}));
+  }
+
+  SECTION( "tabs without a header" ){
+    write_file(path, "1\t2\n3\t4\n");
+    CsvReader reader(path);
+    REQUIRE(reader.delimiter() == '\t');
+    REQUIRE(reader.header().empty());
+    REQUIRE(reader.read({1, 1}) == std::vector<std::vector<double>>({{2, 4}, {2, 4}}));
+  }
+
+  SECTION( "errors name the line" ){
+    write_file(path, "x,y\n1,2\n3\n");
+    CsvReader reader(path);
+    REQUIRE(reader.read({0})[0] == std::vector<double>({1, 3}));
+    try{
+      reader.read({1});
+      FAIL("a missing column was read");
+    }
+    catch(const SemanticError & error){
+      REQUIRE(std::string(error.what()).find("line 3 ") != std::string::npos);
+    }
+
+    // columns past the first line are rejected before anything is read
+    REQUIRE(reader.columns() == 2);
+    REQUIRE_THROWS_AS(reader.read({2}), SemanticError);
+    REQUIRE_THROWS_AS(reader.read({0, 1000000000000000}), SemanticError);
+
+    write_file(path, "1,2\n\n3,x\n");
+    try{
+      CsvReader(path).read({1});
+      FAIL("a field that is not a number was read");
+    }
+    catch(const SemanticError & error){
+      REQUIRE(std::string(error.what()).find("line 3 ") != std::string::npos);
+    }
+  }
+
+  SECTION( "large files are read in chunks" ){
+    std::ostringstream text;
+    text << "index,square\n";
+    std::size_t lines = 3 * CsvReader::CHUNK_SIZE / 10;
+    for(std::size_t i = 0; i < lines; ++i){
+      text << i << "," << (i * i) % 1000 << "\n";
+    }
+    write_file(path, text.str());
+
+    std::vector<std::vector<double>> values = CsvReader(path).read({0, 1});
+    REQUIRE(values[0].size() == lines);
+    bool correct = true;
+    for(std::size_t i = 0; i < lines; ++i){
+      correct = correct && (values[0][i] == i) && (values[1][i] == (i * i) % 1000);
+    }
+    REQUIRE(correct);
+
+    // an error in a later chunk is reported at its line in the file
+    write_file(path, text.str() + "1,bad\n");
+    try{
+      CsvReader(path).read({1});
+      FAIL("a field that is not a number was read");
+    }
+    catch(const SemanticError & error){
+      std::string expected = "line " + std::to_string(lines + 2) + " ";
+      REQUIRE(std::string(error.what()).find(expected) != std::string::npos);
+    }
+  }
+
+  std::remove(path.c_str());
+  REQUIRE_THROWS_AS(CsvReader(path).header(), SemanticError);
+}
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <limits>
 #include "environment.hpp"
+#include "csv_reader.hpp"
 #include "semantic_error.hpp"
 
 /*********************************************************************** 
@@ -63,14 +64,13 @@ Expression list(const std::vector<Expression> & args){
 Expression first(const std::vector<Expression> &args) {
 	if (nargs_equal(args, 1)) {
 		if (args[0].head().asSymbol() == "list") {
-			if (args[0].tailConstBegin() == args[0].tailConstEnd())
+			if (args[0].tailSize() == 0)
 			{
 				throw SemanticError("Error: argument to first is an empty list");
 			}
 			else
 			{
-				auto e = args[0].tailConstBegin();
-				return Expression(*e);
+				return args[0].tailFirst();
 			}
 			
 		}
@@ -86,18 +86,13 @@ Expression first(const std::vector<Expression> &args) {
 Expression rest(const std::vector<Expression> &args) {
 	if (nargs_equal(args, 1)) {
 		if (args[0].head().asSymbol() == "list") {
-			if (args[0].tailConstBegin() == args[0].tailConstEnd())
+			if (args[0].tailSize() == 0)
 			{
 				throw SemanticError("Error: argument to first is an empty list");
 			}
 			else
 			{
-				Atom Head("list");
-				Expression result{ Head };
-				for (auto e = ++(args[0].tailConstBegin()); e != args[0].tailConstEnd(); ++e) {
-					result.append(*e);
-				}
-				return result;
+				return args[0].tailRest();
 			}
 
 		}
@@ -113,11 +108,9 @@ Expression rest(const std::vector<Expression> &args) {
 Expression join(const std::vector<Expression> &args) {
 	if (nargs_equal(args, 2)) {
 		if ((args[0].head().asSymbol() == "list")&&(args[1].head().asSymbol() == "list")) {
-			Atom Head("list");
-			Expression result{ Head };
-			for (auto e = (args[0].tailConstBegin()); e != args[0].tailConstEnd(); ++e) {
-				result.append(*e);
-			}
+			// share the first list, only the second is copied
+			Expression result(args[0]);
+			result.prop().clear();
 			for (auto e = (args[1].tailConstBegin()); e != args[1].tailConstEnd(); ++e) {
 				result.append(*e);
 			}
@@ -132,6 +125,38 @@ Expression join(const std::vector<Expression> &args) {
 	}
 }
 
+// largest magnitude at which every integer is exactly representable
+const double EXACT_INTEGER_LIMIT = 9007199254740992.0;
+
+// number of values visited by for(x = begin; x <= end; x += step)
+std::size_t range_count(double begin, double end, double step) {
+	std::size_t count = 0;
+
+	// integer begin and step keep every accumulated value exact, so the
+	// count follows from the bounds instead of walking the sequence
+	if ((begin == std::floor(begin)) && (step == std::floor(step)) &&
+		(std::fabs(begin) < EXACT_INTEGER_LIMIT / 4) && (std::fabs(end) < EXACT_INTEGER_LIMIT / 4) &&
+		(step < EXACT_INTEGER_LIMIT / 4)) {
+		if (end < begin) {
+			return 0;
+		}
+		count = static_cast<std::size_t>(std::floor((end - begin) / step)) + 1;
+		// correct any rounding in the division above
+		while ((count > 0) && (begin + (count - 1) * step > end)) {
+			--count;
+		}
+		while (begin + count * step <= end) {
+			++count;
+		}
+		return count;
+	}
+
+	for (double x = begin; x <= end; x += step) {
+		++count;
+	}
+	return count;
+}
+
 Expression range(const std::vector<Expression> &args) {
 	if (nargs_equal(args, 3)) {
 		if ( (args[0].head().isNumber()) && (args[1].head().isNumber()) && (args[2].head().isNumber()) ) {
@@ -143,13 +168,10 @@ Expression range(const std::vector<Expression> &args) {
 				throw SemanticError("Error: negative or zero increment in range");
 			}
 			else{
-				Atom Head("list");
-				Expression result{ Head };
-				for (auto e = args[0].head().asNumber(); e <= args[1].head().asNumber(); e += args[2].head().asNumber())
-				{
-					result.append(Expression(e));
-				}
-				return result;
+				double begin = args[0].head().asNumber();
+				double end = args[1].head().asNumber();
+				double step = args[2].head().asNumber();
+				return Expression::makeSequence(begin, step, range_count(begin, end, step));
 			}
 			
 		}
@@ -166,11 +188,7 @@ Expression length(const std::vector<Expression> &args) {
 	
 	if (nargs_equal(args, 1)) {
 		if (args[0].head().asSymbol() == "list") {
-			int leng = 0;
-			for (auto e = (args[0].tailConstBegin()); e != args[0].tailConstEnd(); ++e) {
-				leng++;
-			}
-			return Expression(leng);
+			return Expression(static_cast<double>(args[0].tailSize()));
 		}
 		else {
 			throw SemanticError("Error: argument to length is not a list");
@@ -185,11 +203,9 @@ Expression append(const std::vector<Expression> &args) {
 
 	if (nargs_equal(args, 2)) {
 		if (args[0].head().asSymbol() == "list") {
-			Atom Head("list");
-			Expression result{ Head };
-			for (auto e = (args[0].tailConstBegin()); e != args[0].tailConstEnd(); ++e) {
-				result.append(*e);
-			}
+			// shares the list, appending in place when nothing follows it
+			Expression result(args[0]);
+			result.prop().clear();
 			result.append(args[1]);
 			return result;
 		}
@@ -202,156 +218,148 @@ Expression append(const std::vector<Expression> &args) {
 	}
 }
 
-Expression add(const std::vector<Expression> & args){
-  bool areArgumentsComplex = false;
-  // check all aruments are numbers, while adding
-  std::complex<double>result(0,0);
-  for( auto & a :args){
+/*
+  Operator functors for the arithmetic procedures. apply is a template over
+  the operand types so the same operator serves the unboxed double path and
+  the complex path (mixing std::complex<double> and double operands).
+*/
+struct AddOp {
+  template<typename L, typename R>
+  static auto apply(L l, R r) -> decltype(l + r) { return l + r; }
+};
+
+struct SubOp {
+  template<typename L, typename R>
+  static auto apply(L l, R r) -> decltype(l - r) { return l - r; }
+};
+
+struct MulOp {
+  template<typename L, typename R>
+  static auto apply(L l, R r) -> decltype(l * r) { return l * r; }
+};
+
+struct DivOp {
+  template<typename L, typename R>
+  static auto apply(L l, R r) -> decltype(l / r) { return l / r; }
+};
+
+// true if every argument is a Number, false if any is Complex,
+// throws error if an argument is neither
+bool all_real(const std::vector<Expression> & args, const std::string & error){
+  bool real = true;
+  for(auto & a : args){
     if(a.isHeadComplex()){
-      areArgumentsComplex = true;
-      result += a.head().asComplex();
-    }
-    else if(a.isHeadNumber()){
-      result += a.head().asNumber();      
+      real = false;
     }
-    else{
-      throw SemanticError("Error in call to add, argument not a number");
+    else if(!a.isHeadNumber()){
+      throw SemanticError(error);
     }
   }
-  
-  if(result.imag() == 0 && areArgumentsComplex == false){
-    return Expression(result.real());
+  return real;
+}
+
+// one step of a left fold, on the real path every argument is a Number
+template<typename Op>
+double fold_step(double result, const Expression & a){
+  return Op::apply(result, a.head().asNumber());
+}
+
+// one step of a left fold, on the complex path arguments may be either
+template<typename Op>
+std::complex<double> fold_step(std::complex<double> result, const Expression & a){
+  if(a.isHeadComplex()){
+    return Op::apply(result, a.head().asComplex());
   }
-  else{
-    return Expression(result);
+  return Op::apply(result, a.head().asNumber());
+}
+
+// left fold Op over the arguments in [begin, end) starting from result
+template<typename Op, typename T, typename Iterator>
+T fold_left(T result, Iterator begin, Iterator end){
+  for(auto a = begin; a != end; ++a){
+    result = fold_step<Op>(result, *a);
   }
-  
-};
+  return result;
+}
 
-Expression mul(const std::vector<Expression> & args){
-  bool areArgumentsComplex = false;
-  // check all aruments are numbers, while multiplying
-  
-  std::complex<double>result(0,0);
-  if(args[0].isHeadComplex())
-  {
-    areArgumentsComplex = true;
-    result = args[0].head().asComplex();
+// apply a binary Op, staying in double unless an operand is Complex
+template<typename Op>
+Expression binary_op(const Expression & left, const Expression & right, const std::string & error){
+  if(left.isHeadNumber() && right.isHeadNumber()){
+    return Expression(Op::apply(left.head().asNumber(), right.head().asNumber()));
   }
-  else if(args[0].isHeadNumber())
-  {
-    result = std::complex<double>(args[0].head().asNumber(),0);
+  else if(left.isHeadComplex() && right.isHeadComplex()){
+    return Expression(Op::apply(left.head().asComplex(), right.head().asComplex()));
   }
-  else 
-  {
-    throw SemanticError("Error in call to mul, argument not a number");
+  else if(left.isHeadComplex() && right.isHeadNumber()){
+    return Expression(Op::apply(left.head().asComplex(), right.head().asNumber()));
   }
-  bool first = true;
-  for( auto & a :args){
-    if (first)
-    { first = false; continue; }
+  else if(left.isHeadNumber() && right.isHeadComplex()){
+    return Expression(Op::apply(left.head().asNumber(), right.head().asComplex()));
+  }
+  throw SemanticError(error);
+}
 
-    if(a.isHeadComplex()){
-      areArgumentsComplex = true;
-      result *= a.head().asComplex();
-    }
-    else if(a.isHeadNumber()){
-      result *= a.head().asNumber();      
-    }
-    else{
-      throw SemanticError("Error in call to mul, argument not a number");
-    }
+Expression add(const std::vector<Expression> & args){
+  // all real arguments stay unboxed in double, otherwise accumulate complex
+  if(all_real(args, "Error in call to add, argument not a number")){
+    return Expression(fold_left<AddOp>(0.0, args.begin(), args.end()));
   }
+  return Expression(fold_left<AddOp>(std::complex<double>(0,0), args.begin(), args.end()));
+};
 
- if(areArgumentsComplex == false){
-    return Expression(result.real());
+Expression mul(const std::vector<Expression> & args){
+  const std::string error = "Error in call to mul, argument not a number";
+  if(args.empty()){
+    throw SemanticError(error);
   }
-  else{
-    return Expression(result);
+
+  if(all_real(args, error)){
+    return Expression(fold_left<MulOp>(args[0].head().asNumber(), args.begin() + 1, args.end()));
   }
+
+  std::complex<double> result = args[0].isHeadComplex() ?
+    args[0].head().asComplex() : std::complex<double>(args[0].head().asNumber(),0);
+  return Expression(fold_left<MulOp>(result, args.begin() + 1, args.end()));
 };
 
 Expression subneg(const std::vector<Expression> & args){
 
-  std::complex<double>result(0,0);
-  bool areArgumentsComplex = false;
-  // preconditions
   if(nargs_equal(args,1)){
     if(args[0].isHeadNumber()){
-      result = -args[0].head().asNumber();
+      return Expression(-args[0].head().asNumber());
     }
     else if(args[0].isHeadComplex()){
-      result = -args[0].head().asComplex();
+      // negating a complex with no imaginary part gives back a Number
+      std::complex<double> result = -args[0].head().asComplex();
+      if(result.imag() == 0){
+        return Expression(result.real());
+      }
+      return Expression(result);
     }
     else{
       throw SemanticError("Error in call to negate: invalid argument.");
     }
   }
   else if(nargs_equal(args,2)){
-    if( (args[0].isHeadNumber()) && (args[1].isHeadNumber()) ){
-      result = args[0].head().asNumber() - args[1].head().asNumber();
-    }
-    else if( (args[0].isHeadComplex()) && (args[1].isHeadComplex()) ){
-      areArgumentsComplex = true;
-      result = args[0].head().asComplex() - args[1].head().asComplex();
-    }
-    else if( (args[0].isHeadComplex()) && (args[1].isHeadNumber()) ){
-      areArgumentsComplex = true;
-      result = args[0].head().asComplex() - args[1].head().asNumber();
-    }
-    else if( (args[0].isHeadNumber()) && (args[1].isHeadComplex()) ){
-      areArgumentsComplex = true;
-      result = args[0].head().asNumber() - args[1].head().asComplex();
-    }
-    else{      
-      throw SemanticError("Error in call to subtraction: invalid argument.");
-    }
+    return binary_op<SubOp>(args[0], args[1], "Error in call to subtraction: invalid argument.");
   }
   else{
     throw SemanticError("Error in call to subtraction or negation: invalid number of arguments.");
   }
-
-  if(result.imag() == 0 && areArgumentsComplex == false){
-    return Expression(result.real());
-  }
-  else{
-    return Expression(result);
-  }
-
 };
 
 Expression div(const std::vector<Expression> & args){
 
-  std::complex<double>result(0,0);
-  bool areArgumentsComplex = false;
-
   if(nargs_equal(args,2)){
-    if( (args[0].isHeadNumber()) && (args[1].isHeadNumber()) ){
-      result = args[0].head().asNumber() / args[1].head().asNumber();
-    }
-    else if( (args[0].isHeadComplex()) && (args[1].isHeadComplex()) ){
-      areArgumentsComplex = true;
-      result = args[0].head().asComplex() / args[1].head().asComplex();
-    }
-    else if( (args[0].isHeadComplex()) && (args[1].isHeadNumber()) ){
-      areArgumentsComplex = true;
-      result = args[0].head().asComplex() / args[1].head().asNumber();
-    }
-    else if( (args[0].isHeadNumber()) && (args[1].isHeadComplex()) ){
-      areArgumentsComplex = true;
-      result = args[0].head().asNumber() / args[1].head().asComplex();
-    }
-    else{      
-      throw SemanticError("Error in call to division: invalid argument.");
-    }
+    return binary_op<DivOp>(args[0], args[1], "Error in call to division: invalid argument.");
   }
   else if (nargs_equal(args, 1)) {
 	  if (args[0].isHeadNumber()) {
-		  result = 1.0 / args[0].head().asNumber();
+		  return Expression(1.0 / args[0].head().asNumber());
 	  }
 	  else if (args[0].isHeadComplex()) {
-		  areArgumentsComplex = true;
-		  result = std::complex<double>(1.0) / args[0].head().asComplex();
+		  return Expression(std::complex<double>(1.0) / args[0].head().asComplex());
 	  }
 	  else {
 		  throw SemanticError("Error in call to division: invalid argument.");
@@ -360,14 +368,6 @@ Expression div(const std::vector<Expression> & args){
   else{
     throw SemanticError("Error in call to division: invalid number of arguments.");
   }
-  
-  if(areArgumentsComplex == false){
-    return Expression(result.real());
-  }
-  else{
-    return Expression(result);
-  }
-
 };
 //Results for all calculationa are assumed to be complex 
 //and if only real numbers are to be displayed then the 
@@ -420,7 +420,8 @@ Expression sqrt(const std::vector<Expression> & args){
       //Check if its a positive number
       if(args[0].head().asNumber() >= 0)
       {
-        result = std::pow(args[0].head().asNumber(),0.5);
+        // real root, no rounding of the complex result needed
+        return Expression(std::pow(args[0].head().asNumber(),0.5));
       }
       else if(args[0].head().asNumber() < 0)
       {
@@ -648,6 +649,73 @@ Expression continuousplot(const std::vector<Expression> & args) {
 	return result;
 }
 
+// true if exp is a string literal, a symbol in double quotes
+bool is_string(const Expression & exp){
+	if (!exp.isHeadSymbol() || (exp.tailSize() != 0)) {
+		return false;
+	}
+	const std::string name = exp.head().asSymbol();
+	return (name.size() >= 2) && (name.front() == '"') && (name.back() == '"');
+}
+
+// the text of a string literal, without its quotes
+std::string string_text(const Expression & exp){
+	const std::string name = exp.head().asSymbol();
+	return name.substr(1, name.size() - 2);
+}
+
+/*
+  (read-csv "file" column...) reads the numbers of the columns of a CSV or
+  TSV file, each given by its index from 0 or by its name in the header.
+  One column gives a list of its numbers, packed until it is iterated.
+  More give a list of points, one (list x y ...) per line, the way
+  discrete-plot takes its data.
+*/
+Expression readcsv(const std::vector<Expression> & args) {
+	if (args.size() < 2) {
+		throw SemanticError("Error in call to read-csv: invalid number of arguments");
+	}
+	if (!is_string(args[0])) {
+		throw SemanticError("Error in call to read-csv: first argument is not a string");
+	}
+
+	CsvReader reader(string_text(args[0]));
+	std::vector<std::size_t> columns;
+	for (std::size_t i = 1; i < args.size(); ++i) {
+		const Expression & a = args[i];
+		double index = a.head().asNumber();
+		if (a.isHeadNumber() && (a.tailSize() == 0) && (index >= 0) && (index == std::floor(index))) {
+			// compared as a double, so a huge index is never cast
+			if (!(index < static_cast<double>(reader.columns()))) {
+				throw SemanticError("Error in call to read-csv: column index out of range");
+			}
+			columns.push_back(static_cast<std::size_t>(index));
+		}
+		else if (is_string(a)) {
+			columns.push_back(reader.column(string_text(a)));
+		}
+		else {
+			throw SemanticError("Error in call to read-csv: column is not an index or a name");
+		}
+	}
+
+	std::vector<std::vector<double>> values = reader.read(columns);
+	if (values.size() == 1) {
+		return Expression::makeNumbers(std::move(values[0]));
+	}
+
+	Atom list_head("list");
+	Expression result(list_head);
+	for (std::size_t row = 0; row < values[0].size(); ++row) {
+		Expression point(list_head);
+		for (auto & column : values) {
+			point.append(Atom(column[row]));
+		}
+		result.append(point);
+	}
+	return result;
+}
+
 const double PI = std::atan2(0, -1);
 const double EXP = std::exp(1);
 const double e = std::exp(1);
@@ -692,6 +760,8 @@ void Environment::add_exp(const Atom & sym, const Expression & exp){
     throw SemanticError("Attempt to add non-symbol to environment");
   }
 
+  added.push_back(sym.asSymbol());
+
   // error if overwriting symbol map
   if (envmap.find(sym.asSymbol()) != envmap.end()){
 	  envmap.at(sym.asSymbol()) = EnvResult(ExpressionType, exp);
@@ -701,6 +771,20 @@ void Environment::add_exp(const Atom & sym, const Expression & exp){
   }
 }
 
+void Environment::promote(){
+  for(auto & name : added){
+    auto result = envmap.find(name);
+    if((result != envmap.end()) && (result->second.type == ExpressionType)){
+      result->second.exp.promote();
+    }
+  }
+  added.clear();
+}
+
+MemoCache & Environment::memo() const{
+  return *memo_cache;
+}
+
 bool Environment::is_proc(const Atom & sym) const{
   if(!sym.isSymbol()) return false;
   
@@ -750,6 +834,8 @@ bool Environment::isLambda(const Atom&sym) const {
 void Environment::reset(){
 
   envmap.clear();
+  added.clear();
+  memo_cache = std::make_shared<MemoCache>(MemoCache::defaultCapacity());
   
   // Built-In value of pi
   envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
@@ -826,6 +912,9 @@ void Environment::reset(){
   //Procedure: range
   envmap.emplace("range", EnvResult(ProcedureType, range));
 
+	//Procedure: read-csv
+	envmap.emplace("read-csv", EnvResult(ProcedureType, readcsv));
+
 	//Procedure: discrete-plot
 	envmap.emplace("discrete-plot", EnvResult(ProcedureType, discreteplot));
 
@@ -12,11 +12,15 @@ needed.
 
 // system includes
 #include <map>
+#include <memory>
+#include <vector>
 #include <atomic>
 #include <mutex>
 // module includes
 #include "atom.hpp"
+#include "counters.hpp"
 #include "expression.hpp"
+#include "memo_cache.hpp"
 #include "thread_safe.hpp"
 /*! \typedef Procedure
 \brief A Procedure is a C++ function pointer taking a vector of 
@@ -101,6 +105,17 @@ public:
   /*! Reset the environment to its default state. */
   void reset();
 
+  /*! The cache of memoized lambda results. Copies of an environment
+    share it, so results computed in a lambda call are kept.
+   */
+  MemoCache & memo() const;
+
+  /*! Promote the expressions added since the last call out of any Arena,
+    see Expression::promote. Called before the Arena they were built in
+    is reset.
+   */
+  void promote();
+
 	/*void setSignal(env_mqueue* in) {
 		signal_interrupt = in;
 	}
@@ -123,6 +138,16 @@ private:
 
   // the environment map
   std::map<std::string, EnvResult> envmap;
+
+  // symbols added with add_exp since the last promote
+  std::vector<std::string> added;
+
+  // results of memoized lambdas, shared by copies
+  std::shared_ptr<MemoCache> memo_cache;
+
+#ifdef PLOTSCRIPT_COUNTERS
+  CountedCopy<Counters::ENVIRONMENT_COPIES> copies;
+#endif
 	////env_mqueue *signal_interrupt = nullptr;
 };
 
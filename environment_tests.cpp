@@ -92,3 +92,37 @@ TEST_CASE( "Test semeantic errors", "[environment]" ) {
     REQUIRE_THROWS_AS(exp.eval(env), SemanticError);
   }
 }
+
+TEST_CASE( "Test arithmetic real and complex paths", "[environment]" ) {
+  Environment env;
+
+  Procedure padd = env.get_proc(Atom("+"));
+  Procedure pmul = env.get_proc(Atom("*"));
+  Procedure psub = env.get_proc(Atom("-"));
+  Procedure pdiv = env.get_proc(Atom("/"));
+
+  std::vector<Expression> real = {Expression(0.1), Expression(0.2), Expression(3.0)};
+  REQUIRE(padd(real).isHeadNumber());
+  REQUIRE(padd(real).head().asNumber() == ((0.0 + 0.1) + 0.2) + 3.0);
+  REQUIRE(pmul(real).isHeadNumber());
+  REQUIRE(pmul(real).head().asNumber() == (0.1 * 0.2) * 3.0);
+
+  std::vector<Expression> mixed = {Expression(2.0), Expression(std::complex<double>(0, 1))};
+  REQUIRE(padd(mixed) == Expression(std::complex<double>(2, 1)));
+  REQUIRE(pmul(mixed) == Expression(std::complex<double>(0, 2)));
+  REQUIRE(psub(mixed) == Expression(std::complex<double>(2, -1)));
+  REQUIRE(pdiv(mixed) == Expression(std::complex<double>(0, -2)));
+
+  std::vector<Expression> pair = {Expression(1.0), Expression(3.0)};
+  REQUIRE(psub(pair).head().asNumber() == 1.0 - 3.0);
+  REQUIRE(pdiv(pair).head().asNumber() == 1.0 / 3.0);
+
+  std::vector<Expression> none;
+  REQUIRE_THROWS_AS(pmul(none), SemanticError);
+
+  std::vector<Expression> bad = {Expression(1.0), Expression(Atom("a"))};
+  REQUIRE_THROWS_AS(padd(bad), SemanticError);
+  REQUIRE_THROWS_AS(pmul(bad), SemanticError);
+  REQUIRE_THROWS_AS(psub(bad), SemanticError);
+  REQUIRE_THROWS_AS(pdiv(bad), SemanticError);
+}
@@ -1,8 +1,15 @@
 #include "expression.hpp"
 
 #include <sstream>
+#include "counters.hpp"
 #include "environment.hpp"
+#include "numeric_function.hpp"
+#include "printer.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
 #include "semantic_error.hpp"
+#include "thread_pool.hpp"
+#include <mutex>
 #include <iomanip>
 #include <algorithm>
 #include <math.h>
@@ -15,46 +22,182 @@ const int B = 3;
 const float NUM_OF_ITERATIONS = 50;
 const int MAX_ITER = 10;
 
+// interned symbols of the special forms, compared by id during eval
+const Atom LIST_SYMBOL("list");
+const Atom BEGIN_SYMBOL("begin");
+const Atom DEFINE_SYMBOL("define");
+const Atom LAMBDA_SYMBOL("lambda");
+const Atom APPLY_SYMBOL("apply");
+const Atom MAP_SYMBOL("map");
+const Atom SET_PROPERTY_SYMBOL("set-property");
+const Atom GET_PROPERTY_SYMBOL("get-property");
+const Atom DISCRETE_PLOT_SYMBOL("discrete-plot");
+const Atom CONTINUOUS_PLOT_SYMBOL("continuous-plot");
+const Atom MEMOIZE_SYMBOL("memoize");
+const Atom MEMO_STATS_SYMBOL("memo-stats");
+
+// id of a lambda marked by memoize, or 0 if it is not memoized
+static std::size_t memo_id(const Expression & lambda)
+{
+	const Expression & id = lambda.prop().get(MEMOIZE_KEY);
+	return id.isHeadNumber() ? static_cast<std::size_t>(id.head().asNumber()) : 0;
+}
+
 
-Expression::Expression(){}
+Expression::Expression(): m_hash(0){}
 
-Expression::Expression(const Atom & a){
+Expression::Expression(const Atom & a): m_hash(0){
 
   m_head = a;
 }
 
-// recursive copy
-Expression::Expression(const Expression & a){
+// a lazy tail of Numbers, an arithmetic sequence or a packed array of
+// values. The Expressions are generated once on first const access
+struct Expression::Sequence {
+	Sequence(double b, double s, std::size_t c) :
+		begin(b), step(s), count(c), offset(0), cache(ArenaAllocator<Expression>(nullptr)) {}
+
+	Sequence(const std::shared_ptr<const std::vector<double>> & n, std::size_t o, std::size_t c) :
+		begin(0), step(0), count(c), numbers(n), offset(o), cache(ArenaAllocator<Expression>(nullptr)) {}
+
+	double begin;
+	double step;
+	std::size_t count;
+
+	// the packed values from offset on, null for an arithmetic sequence
+	std::shared_ptr<const std::vector<double>> numbers;
+	std::size_t offset;
+
+	// call f on each value in order, a sequence is accumulated the same
+	// way as the eager range loop so values are identical
+	template<typename F>
+	void forEach(F f) const {
+		if (numbers) {
+			const double * values = numbers->data() + offset;
+			for (std::size_t i = 0; i < count; ++i) {
+				f(values[i]);
+			}
+			return;
+		}
+		double x = begin;
+		for (std::size_t i = 0; i < count; ++i) {
+			f(x);
+			x += step;
+		}
+	}
 
-  m_head = a.m_head;
-  for(auto e : a.m_tail){
-    m_tail.push_back(e);
-  }
-	for (auto e : a.property) {
-		property.emplace(e);
+	double first() const {
+		return numbers ? (*numbers)[offset] : begin;
+	}
+
+	// the values after the first, null if there are none
+	std::shared_ptr<Sequence> rest() const {
+		if (count < 2) {
+			return nullptr;
+		}
+		if (numbers) {
+			return std::make_shared<Sequence>(numbers, offset + 1, count - 1);
+		}
+		// the next accumulated value starts the rest of the sequence
+		return std::make_shared<Sequence>(begin + step, step, count - 1);
+	}
+
+	template<typename List>
+	void generate(List & result) const {
+		result.reserve(count);
+		forEach([&result](double x) { result.push_back(Expression(Atom(x))); });
 	}
+
+	// the values, generated at most once even when shared between threads.
+	// The sequence may outlive an evaluation, so they are always on the heap.
+	const SharedList<Expression>::vector_type & values() {
+		std::call_once(once, [this] { generate(cache); });
+		return cache;
+	}
+
+private:
+	std::once_flag once;
+	SharedList<Expression>::vector_type cache;
+};
+
+Expression Expression::makeSequence(double begin, double step, std::size_t count){
+	Expression result(LIST_SYMBOL);
+	if (count > 0) {
+		result.m_sequence = std::make_shared<Sequence>(begin, step, count);
+	}
+	return result;
+}
+
+Expression Expression::makeNumbers(std::vector<double> values){
+	Expression result(LIST_SYMBOL);
+	if (!values.empty()) {
+		std::size_t count = values.size();
+		std::shared_ptr<const std::vector<double>> numbers =
+			std::make_shared<const std::vector<double>>(std::move(values));
+		result.m_sequence = std::make_shared<Sequence>(numbers, 0, count);
+	}
+	return result;
+}
+
+// the tail and a lazy sequence are shared rather than copied
+Expression::Expression(const Expression & a):
+  m_head(a.m_head), m_tail(a.m_tail), m_sequence(a.m_sequence), property(a.property), m_hash(0){
+  Counters::count(Counters::EXPRESSION_COPIES);
 }
 
 Expression & Expression::operator=(const Expression & a){
 
+  Counters::count(Counters::EXPRESSION_ASSIGNMENTS);
+
   // prevent self-assignment
   if(this != &a){
+    invalidate();
     m_head = a.m_head;
-    m_tail.clear();
-    for(auto e : a.m_tail){
-      m_tail.push_back(e);
-    } 
-		property.clear();
-		for (auto e : a.property) {
-			property.emplace(e);
-		}
+    m_tail = a.m_tail;
+    m_sequence = a.m_sequence;
+    property = a.property;
   }
   
   return *this;
 }
 
+void Expression::materialize() {
+	if (!m_sequence) {
+		return;
+	}
+	m_tail.clear();
+	m_sequence->generate(m_tail);
+	m_sequence.reset();
+}
+
+
+void Expression::promote() {
+	m_tail.promote([](Expression & e) { e.promote(); });
+	property.forEachValue([](Expression & e) { e.promote(); });
+}
+
+Expression Expression::heapCopy() const {
+	HeapScope heap;
+	Expression result(m_head);
+
+	// a lazy sequence is immutable and never in an arena
+	result.m_sequence = m_sequence;
+	if (!m_tail.empty()) {
+		std::vector<Expression> items;
+		items.reserve(m_tail.size());
+		for (auto & e : m_tail) {
+			items.push_back(e.heapCopy());
+		}
+		result.m_tail = SharedList<Expression>(std::move(items));
+	}
+	for (auto & p : property) {
+		result.property[p.first] = p.second.heapCopy();
+	}
+	return result;
+}
 
 Atom & Expression::head(){
+  invalidate();
   return m_head;
 }
 
@@ -62,11 +205,12 @@ const Atom & Expression::head() const{
   return m_head;
 }
 
-std::map<std::string, Expression>& Expression::prop() {
+PropertyList<Expression>& Expression::prop() {
+	invalidate();
 	return property;
 }
 
-const std::map<std::string, Expression>& Expression::prop() const {
+const PropertyList<Expression>& Expression::prop() const {
 	return property;
 }
 
@@ -83,15 +227,52 @@ bool Expression::isHeadComplex() const noexcept{
 }
 
 void Expression::append(const Atom & a){
+  invalidate();
+  materialize();
   m_tail.emplace_back(a);
 }
 
 void Expression::append(const Expression & E) {
+	invalidate();
+	materialize();
 	m_tail.emplace_back(E);
 }
 
+std::size_t Expression::tailSize() const noexcept {
+	return m_sequence ? m_sequence->count : m_tail.size();
+}
+
+Expression Expression::tailFirst() const {
+	if (m_sequence) {
+		return Expression(Atom(m_sequence->first()));
+	}
+	return m_tail.front();
+}
+
+Expression Expression::tailRest() const {
+	Expression result(m_head);
+	if (m_sequence) {
+		result.m_sequence = m_sequence->rest();
+		return result;
+	}
+	result.m_tail = m_tail.rest();
+	return result;
+}
+
+void Expression::forEachTail(const std::function<void(const Expression &)> & f) const {
+	if (m_sequence) {
+		std::shared_ptr<Sequence> seq = m_sequence;
+		seq->forEach([&f](double x) { f(Expression(Atom(x))); });
+		return;
+	}
+	for (auto & e : m_tail) {
+		f(e);
+	}
+}
 
 Expression * Expression::tail(){
+  invalidate();
+  materialize();
   Expression * ptr = nullptr;
   
   if(m_tail.size() > 0){
@@ -106,20 +287,30 @@ void Expression::reset() {
 }
 
 Expression::ConstIteratorType Expression::tailConstBegin() const noexcept{
+  if(m_sequence){
+    return m_sequence->values().cbegin();
+  }
   return m_tail.cbegin();
 }
 
 Expression::ConstIteratorType Expression::tailConstEnd() const noexcept{
+  if(m_sequence){
+    return m_sequence->values().cend();
+  }
   return m_tail.cend();
 }
 
-std::vector<Expression>::iterator Expression::tailBegin() noexcept
+Expression::IteratorType Expression::tailBegin() noexcept
 {
+	invalidate();
+	materialize();
 	return m_tail.begin();
 }
 
-std::vector<Expression>::iterator Expression::tailEnd() noexcept
+Expression::IteratorType Expression::tailEnd() noexcept
 {
+	invalidate();
+	materialize();
 	return  m_tail.end();
 }
 
@@ -140,10 +331,11 @@ Expression apply(const Atom & op, const std::vector<Expression> & args, const En
   Procedure proc = env.get_proc(op);
   
   // call proc with args
+  ProfiledCall call(Profiler::BUILTIN, op);
   return proc(args);
 }
 
-Expression Expression::handle_lookup(const Atom & head, const Environment & env){
+Expression Expression::handle_lookup(const Atom & head, const Environment & env) const{
     if(head.isSymbol()){ // if symbol is in env return value
       if(env.is_exp(head)){
 				Expression temp = env.get_exp(head);
@@ -167,7 +359,8 @@ Expression Expression::handle_lookup(const Atom & head, const Environment & env)
     }
 }	
 
-Expression Expression::handle_define(Environment & env) {
+Expression Expression::handle_define(Environment & env) const {
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
 
 	// tail must have size 3 or error
 	if (m_tail.size() != 2) {
@@ -198,7 +391,8 @@ Expression Expression::handle_define(Environment & env) {
 	return result;
 }
 
-Expression Expression::handle_begin(Environment & env){
+Expression Expression::handle_begin(Environment & env) const{
+  ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
   
   if(m_tail.size() == 0){
     throw SemanticError("Error during evaluation: zero arguments to begin");
@@ -206,14 +400,16 @@ Expression Expression::handle_begin(Environment & env){
 
   // evaluate each arg from tail, return the last
   Expression result;
-  for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
+  for(auto it = m_tail.cbegin(); it != m_tail.cend(); ++it){
     result = it->eval(env);
   }
   
   return result;
 }
 
-Expression Expression::handle_lambda(Environment & env) {
+Expression Expression::handle_lambda(Environment & env) const {
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
 	if (m_tail.size() != 2) {
 		throw SemanticError("Error during lambda: invalid number of arguments to define");
 	}
@@ -237,8 +433,23 @@ Expression Expression::handle_lambda(Environment & env) {
 	return result;
 }
 
-Expression Expression::lambdaEval(const Atom&sym, Environment & env, std::vector<Expression>m_tail) {
-	Expression exp = env.get_exp(sym);
+// the checks define makes of the symbol it binds, for a lambda parameter
+static void check_parameter(const Expression & var, const Environment & env) {
+	if (!var.isHeadSymbol()) {
+		throw SemanticError("Error during evaluation: first argument to define not symbol");
+	}
+	std::string s = var.head().asSymbol();
+	if ((s == "define") || (s == "begin")) {
+		throw SemanticError("Error during evaluation: attempt to redefine a special-form");
+	}
+	if (env.is_proc(var.head())) {
+		throw SemanticError("Error during evaluation: attempt to redefine a built-in procedure");
+	}
+}
+
+Expression Expression::lambdaEval(const Atom&sym, Environment & env, std::vector<Expression>m_tail) const {
+	ProfiledCall call(Profiler::LAMBDA, sym);
+	const Expression exp = env.get_exp(sym);
 	unsigned int counter = 0;
 	for (auto vars = exp.m_tail[0].tailConstBegin(); vars != exp.m_tail[0].tailConstEnd(); ++vars) {
 		//std::cout << (*vars);
@@ -249,110 +460,520 @@ Expression Expression::lambdaEval(const Atom&sym, Environment & env, std::vector
 	{
 		throw SemanticError("Error: invalid arguments to the lambda function");
 	}
-	Environment env2(env);
 
-	//making the defines for the vars
+	// bind each parameter to the value of its argument, evaluated once in
+	// the lambda's environment with the parameters before it bound, as a
+	// define of the parameter would
+	Environment env2(env);
 	counter = 0;
 	for (auto vars = exp.m_tail[0].tailConstBegin(); vars != exp.m_tail[0].tailConstEnd(); ++vars)
 	{
-		Expression temp(Atom("define"));
-		temp.append(Expression(*vars));
-		temp.append(Expression(m_tail[counter]));
+		check_parameter(*vars, env2);
+		m_tail[counter] = m_tail[counter].eval(env2);
+		env2.add_exp(vars->head(), m_tail[counter]);
 		++counter;
-		temp.eval(env2);
 	}
+
+	// a memoized lambda is looked up by the values of its arguments
+	std::size_t memo = memo_id(exp);
+	Expression cached;
+	if ((memo != 0) && env.memo().find(memo, m_tail, cached)) {
+		return cached;
+	}
+
 	Expression t = exp.m_tail[1].eval(env2);
+	if (memo != 0) {
+		env.memo().insert(memo, m_tail, t);
+	}
 	return t;
 }
 
-Expression Expression::handle_map(Environment &env)
+std::vector<Expression> Expression::lambdaEvalBatch(const Atom & sym, Environment & env,
+	const std::vector<std::vector<Expression>> & args) const
 {
+	NumericFunction compiled(sym, env);
+	return batch_eval(sym, env, compiled, args);
+}
 
-	if (m_tail[0].tail() != nullptr)
-	{
-		throw SemanticError("Error: first argument to map not a procedure");
+/*
+  Evaluate the tuples whose arguments are all plain numbers with the
+  compiled lambda in one batch, then every other tuple and every tuple the
+  batch hands back with lambdaEval, in order. The compiled lambda never
+  raises an error, so the first error raised is the one calling lambdaEval
+  on each tuple in turn would raise.
+*/
+std::vector<Expression> Expression::batch_eval(const Atom & sym, Environment & env, const NumericFunction & compiled,
+	const std::vector<std::vector<Expression>> & args) const
+{
+	std::size_t size = args.empty() ? 0 : args[0].size();
+	std::vector<Expression> results(size);
+
+	std::vector<char> ok(size, 0);
+	if (compiled.compiled() && (compiled.arity() == args.size())) {
+		std::vector<std::size_t> rows;
+		std::vector<std::vector<double>> columns(args.size());
+		for (std::size_t i = 0; i < size; ++i) {
+			bool real = true;
+			for (auto & column : args) {
+				const Expression & a = column[i];
+				real = real && (a.tailSize() == 0) && a.isHeadNumber() && a.prop().empty();
+			}
+			if (real) {
+				rows.push_back(i);
+				for (std::size_t p = 0; p < args.size(); ++p) {
+					columns[p].push_back(args[p][i].head().asNumber());
+				}
+			}
+		}
+
+		std::vector<double> ys;
+		std::vector<char> done;
+		{
+			ProfiledCall call(Profiler::LAMBDA, sym);
+			compiled.evaluate(columns, ys, done);
+		}
+		for (std::size_t r = 0; r < rows.size(); ++r) {
+			if (done[r]) {
+				results[rows[r]] = Expression(ys[r]);
+				ok[rows[r]] = 1;
+			}
+		}
 	}
 
-	else if ((env.is_proc(m_tail[0].head())) || (env.isLambda(m_tail[0].head().asSymbol()))) {
-		//ADDED STATEMENT
-		if ( env.is_proc(m_tail[1].head().asSymbol()) ){
-			m_tail[1] = m_tail[1].eval(env);
+	for (std::size_t i = 0; i < size; ++i) {
+		if (!ok[i]) {
+			std::vector<Expression> tuple;
+			for (auto & column : args) {
+				tuple.push_back(column[i]);
+			}
+			results[i] = lambdaEval(sym, env, tuple);
 		}
-		
+	}
+	return results;
+}
+
+/*
+  (memoize f) marks the lambda f as pure, so its results are cached by
+  the values of its arguments. When f names a lambda the name is rebound
+  to the memoized lambda, so later calls by name are memoized. Otherwise
+  f is evaluated and the memoized lambda returned.
+*/
+Expression Expression::handle_memoize(Environment & env) const
+{
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
+	if (m_tail.size() != 1) {
+		throw SemanticError("Error: invalid number of arguments to memoize");
+	}
+
+	const Expression & arg = m_tail[0];
+	bool named = (arg.tailSize() == 0) && env.isLambda(arg.head());
+	Expression lambda = named ? env.get_exp(arg.head()) : arg.eval(env);
+	if (lambda.head() != LAMBDA_SYMBOL) {
+		throw SemanticError("Error: argument to memoize not a lambda");
+	}
+
+	if (memo_id(lambda) == 0) {
+		lambda.property[MEMOIZE_KEY] = Expression(static_cast<double>(env.memo().newId()));
+		if (named) {
+			env.add_exp(arg.head(), lambda);
+		}
+	}
+	return lambda;
+}
+
+// (memo-stats) is the list of hits, misses, cached results and evictions
+Expression Expression::handle_memo_stats(Environment & env) const
+{
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
+	if (!m_tail.empty()) {
+		throw SemanticError("Error: invalid number of arguments to memo-stats");
+	}
+
+	MemoCache::Stats stats = env.memo().stats();
+	Expression result(LIST_SYMBOL);
+	result.append(Expression(static_cast<double>(stats.hits)));
+	result.append(Expression(static_cast<double>(stats.misses)));
+	result.append(Expression(static_cast<double>(stats.entries)));
+	result.append(Expression(static_cast<double>(stats.evictions)));
+	return result;
+}
 
-		if (m_tail[1].head().asSymbol() == "list" ){
+// apply the procedure or lambda named op to a single argument
+Expression Expression::call_unary(const Atom & op, const Expression & arg, Environment & env) const
+{
+	std::vector<Expression> args(1, arg);
+	if (env.is_proc(op)) {
+		return apply(op, args, env);
+	}
+	return lambdaEval(op, env, args);
+}
+
+/*
+  Walk a chain of nested maps (map f (map g ... L)) starting at this map
+  node, checking each procedure in the same order the unfused evaluation
+  would. The procedures are pushed onto stages outermost first and the
+  innermost list argument L is returned.
+*/
+const Expression & Expression::map_chain(Environment & env, std::vector<Atom> & stages) const
+{
+	const Expression * node = this;
+	while (true) {
+		if (node->m_tail.size() != 2)
+		{
+			throw SemanticError("Error: invalid number of arguments to map");
+		}
+
+		if (node->m_tail[0].tailSize() != 0)
+		{
+			throw SemanticError("Error: first argument to map not a procedure");
+		}
+
+		const Atom & op = node->m_tail[0].head();
+		if (!env.is_proc(op) && !env.isLambda(op.asSymbol())) {
+			throw SemanticError("Error: first argument to map not a procedure");
+		}
+		stages.push_back(op);
+
+		const Expression & arg = node->m_tail[1];
+		if ((arg.head() != MAP_SYMBOL) || arg.m_tail.empty()) {
+			return arg;
+		}
+		node = &arg;
+	}
+}
+
+// evaluate the list argument of a map chain, which must be a list
+Expression Expression::map_source(const Expression & source, Environment & env) const
+{
+	Expression list = source.eval(env);
+	if (list.head() != LIST_SYMBOL) {
+		throw SemanticError("Error: second argument not a list");
+	}
+	return list;
+}
 
-			Expression result(Atom("list"));
+/*
+  Evaluate a map chain one stage at a time, innermost first, materializing
+  every intermediate list. This is the reference evaluation order and is
+  only used to reproduce the exact error after the fused pass fails.
+*/
+Expression Expression::map_chain_unfused(const std::vector<Atom> & stages, const Expression & list, Environment & env) const
+{
+	Expression current = list;
+	for (auto op = stages.rbegin(); op != stages.rend(); ++op) {
+		Expression next(LIST_SYMBOL);
+		current.forEachTail([&](const Expression & a) {
+			next.append(call_unary(*op, a, env));
+		});
+		current = next;
+	}
+	return current;
+}
 
-			Expression ret = m_tail[1].eval(env);
-			for (auto a = ret.tailConstBegin(); a != ret.tailConstEnd(); ++a) {
-				Expression toSend(Atom("apply"));
-				Expression t(Atom("list"));
-				t.append(*a);
-				toSend.append(m_tail[0].head());
-				toSend.append(t);
-				result.append(toSend.eval(env));
+/*
+  Stream each element of list through the stages, innermost first, and
+  hand the final value to sink. No intermediate lists are built. If
+  anything throws, the chain is re-run unfused so the error reported is
+  the one the stage-by-stage evaluation would have hit first.
+*/
+void Expression::run_map_chain(const std::vector<Atom> & stages, const Expression & list, Environment & env,
+	const std::function<void(const Expression &)> & sink) const
+{
+	try {
+		list.forEachTail([&](const Expression & a) {
+			Expression value = a;
+			for (auto op = stages.rbegin(); op != stages.rend(); ++op) {
+				value = call_unary(*op, value, env);
 			}
-			return result;
-			
+			sink(value);
+		});
+	}
+	catch (const SemanticError &) {
+		if (stages.size() > 1) {
+			map_chain_unfused(stages, list, env);
 		}
+		throw;
+	}
+}
 
-		else {
-			throw SemanticError("Error: second argument not a list");
+// special forms a pure lambda body may use, plotting forms are excluded
+bool is_pure_form(const std::string & name)
+{
+	return (name == "begin") || (name == "define") || (name == "lambda") ||
+		(name == "apply") || (name == "map") || (name == "list") ||
+		(name == "set-property") || (name == "get-property");
+}
+
+// built-in procedures that are never run on a pool worker, the plots
+// produce output and read-csv reads a file that may change between calls
+bool is_impure_procedure(const std::string & name)
+{
+	return (name == "discrete-plot") || (name == "continuous-plot") || (name == "read-csv");
+}
+
+/*
+  Purity analysis for parallel map. An expression is pure when every call
+  in it is a built-in procedure other than the plots and read-csv, a pure
+  special form, or a lambda whose body is itself pure, and when every
+  define in it binds a fresh local name rather than one already known to
+  the outer environment. locals holds the parameters and local defines in
+  scope, visiting the lambdas being checked so recursive definitions
+  terminate.
+*/
+bool Expression::is_pure(const Expression & exp, const Environment & env,
+	std::vector<std::string> & locals, std::vector<std::string> & visiting)
+{
+	if (exp.tailSize() == 0 || !exp.isHeadSymbol()) {
+		return true;
+	}
+
+	const std::string name = exp.head().asSymbol();
+	auto is_local = [&](const std::string & sym) {
+		return std::find(locals.begin(), locals.end(), sym) != locals.end();
+	};
+
+	if (name == "define") {
+		const std::string sym = exp.m_tail[0].head().asSymbol();
+		if (env.is_known(Atom(sym)) && !is_local(sym)) {
+			return false;
 		}
+		locals.push_back(sym);
 	}
-	else {
-		throw SemanticError("Error: first argument to apply not a procedure");
+	else if (name == "lambda") {
+		// the body of a nested lambda is checked if it is called
+		return true;
+	}
+	else if ((name == "apply") || (name == "map")) {
+		if (!is_pure_callee(exp.m_tail[0].head(), env, locals, visiting)) {
+			return false;
+		}
+		return (exp.m_tail.size() < 2) || is_pure(exp.m_tail[1], env, locals, visiting);
+	}
+	else if (!is_pure_form(name) && !is_pure_callee(exp.head(), env, locals, visiting)) {
+		return false;
 	}
-	return Expression();
+
+	for (auto & e : exp.m_tail) {
+		if (!is_pure(e, env, locals, visiting)) {
+			return false;
+		}
+	}
+	return true;
 }
 
-Expression Expression::handle_apply(Environment &env) 
+// true if op names a pure built-in procedure or a lambda with a pure body
+bool Expression::is_pure_callee(const Atom & op, const Environment & env,
+	std::vector<std::string> & locals, std::vector<std::string> & visiting)
 {
-	if (m_tail[0].tail() != nullptr)
-	{
-		throw SemanticError("Error: first argument to apply not a procedure");
+	if (env.is_proc(op)) {
+		return !is_impure_procedure(op.asSymbol());
 	}
-	
-	if ( (env.is_proc(m_tail[0].head())) || (env.isLambda(m_tail[0].head().asSymbol())) ) {
-		if (m_tail[1].head().asSymbol() == "list") {
-			Expression result(Atom("list"));
 
-			//handling non-lambda procedures
-			if (env.is_proc(m_tail[0].head())) {
-				std::vector<Expression> t;
-				Expression ret = m_tail[1].eval(env);
+	const std::string name = op.asSymbol();
+	if (!env.isLambda(op) || (std::find(locals.begin(), locals.end(), name) != locals.end())) {
+		return false;
+	}
+	if (std::find(visiting.begin(), visiting.end(), name) != visiting.end()) {
+		return true;
+	}
 
-				for (auto a = ret.tailConstBegin(); a != ret.tailConstEnd(); ++a) {
-					t.push_back(*a);
-				}
-				return apply(m_tail[0].head(), t, env);
-			}
+	Expression lambda = env.get_exp(op);
+	std::vector<std::string> params;
+	lambda.m_tail[0].forEachTail([&](const Expression & p) {
+		params.push_back(p.head().asSymbol());
+	});
 
-			//handling lambda
-			if (env.isLambda(m_tail[0].head().asSymbol())) {
-				std::vector<Expression> t;
-				Expression ret = m_tail[1].eval(env);
+	visiting.push_back(name);
+	bool pure = is_pure(lambda.m_tail[1], env, params, visiting);
+	visiting.pop_back();
+	return pure;
+}
 
-				for (auto a = ret.tailConstBegin(); a != ret.tailConstEnd(); ++a) {
-					t.push_back(*a);
-				}
+// elements of a list mapped through compiled lambdas per batch
+const std::size_t MAP_BATCH_SIZE = 4096;
 
-				return lambdaEval(m_tail[0].head().asSymbol(), env, t);
+/*
+  Map the list through the stages in batches when every stage is a lambda
+  that compiles to a NumericFunction, false if one does not. Each stage
+  runs over a whole batch before the next, and as in run_map_chain the
+  chain is re-run unfused if anything throws.
+*/
+bool Expression::map_compiled(const std::vector<Atom> & stages, const Expression & list, Environment & env, Expression & result) const
+{
+	std::vector<NumericFunction> compiled;
+	for (auto op = stages.rbegin(); op != stages.rend(); ++op) {
+		compiled.emplace_back(*op, env);
+		if (!compiled.back().compiled() || (compiled.back().arity() != 1)) {
+			return false;
+		}
+	}
+
+	std::vector<std::vector<Expression>> batch(1);
+	auto flush = [&]() {
+		for (std::size_t s = 0; s < compiled.size(); ++s) {
+			batch[0] = batch_eval(stages[stages.size() - 1 - s], env, compiled[s], batch);
+		}
+		for (auto & value : batch[0]) {
+			result.m_tail.push_back(value);
+		}
+		batch[0].clear();
+	};
+
+	try {
+		list.forEachTail([&](const Expression & a) {
+			batch[0].push_back(a);
+			if (batch[0].size() == MAP_BATCH_SIZE) {
+				flush();
 			}
+		});
+		flush();
+	}
+	catch (const SemanticError &) {
+		map_chain_unfused(stages, list, env);
+		throw;
+	}
+	return true;
+}
+
+Expression Expression::handle_map(Environment &env) const
+{
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
+	std::vector<Atom> stages;
+	const Expression & source = map_chain(env, stages);
+	Expression list = map_source(source, env);
+
+	Expression result(LIST_SYMBOL);
+	result.m_tail.reserve(list.tailSize());
+
+	if (map_compiled(stages, list, env, result)) {
+		return result;
+	}
+
+	// held for the whole map, so a reconfigured pool outlives this call
+	std::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+	bool parallel = (pool->size() > 1) && !ThreadPool::inWorker() &&
+		(list.tailSize() >= ThreadPool::threshold());
+	for (auto & op : stages) {
+		std::vector<std::string> locals, visiting;
+		parallel = parallel && is_pure_callee(op, env, locals, visiting);
+	}
+
+	if (parallel) {
+		list.materialize();
+		const Expression & input = list;
+		std::vector<Expression> values(input.m_tail.size());
+		std::size_t grain = std::max<std::size_t>(64, values.size() / (4 * pool->size()));
+		try {
+			pool->parallelFor(values.size(), grain, [&](std::size_t begin, std::size_t end) {
+				// each chunk evaluates in its own copy of the environment
+				Environment local(env);
+				for (std::size_t i = begin; i < end; ++i) {
+					// const access, so the shared list is never detached by a worker
+					Expression value = input.m_tail[i];
+					for (auto op = stages.rbegin(); op != stages.rend(); ++op) {
+						value = call_unary(*op, value, local);
+					}
+					values[i] = value;
+				}
+			});
 		}
-		else {
-			throw SemanticError("Error: second argument not a list");
+		catch (const SemanticError &) {
+			// chunks fail out of order, the unfused pass reports the first error
+			map_chain_unfused(stages, list, env);
+			throw;
 		}
+		result.m_tail = SharedList<Expression>(std::move(values));
+		return result;
 	}
-	else {
+
+	run_map_chain(stages, list, env, [&](const Expression & value) {
+		result.m_tail.push_back(value);
+	});
+	return result;
+}
+
+// size of the argument chunks when apply folds through + or *
+const std::size_t APPLY_CHUNK_SIZE = 4096;
+
+Expression Expression::handle_apply(Environment &env) const 
+{
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
+	if (m_tail.size() != 2)
+	{
+		throw SemanticError("Error: invalid number of arguments to apply");
+	}
+
+	if (m_tail[0].tailSize() != 0)
+	{
+		throw SemanticError("Error: first argument to apply not a procedure");
+	}
+
+	const Atom & op = m_tail[0].head();
+	if (!env.is_proc(op) && !env.isLambda(op.asSymbol())) {
 		throw SemanticError("Error: first argument to apply not a procedure");
 	}
-	return Expression();
+
+	// a map chain as the argument is fused into the apply, otherwise the
+	// argument list is streamed through an empty chain
+	std::vector<Atom> stages;
+	Expression list;
+	const Expression & arg = m_tail[1];
+	if ((arg.head() == MAP_SYMBOL) && !arg.m_tail.empty()) {
+		list = map_source(arg.map_chain(env, stages), env);
+	}
+	else {
+		list = arg.eval(env);
+		if (list.head() != LIST_SYMBOL) {
+			throw SemanticError("Error: second argument not a list");
+		}
+	}
+
+	std::vector<Expression> t;
+
+	// + and * fold left, so the arguments can be fed through in chunks
+	// carrying the partial result, without holding the whole list
+	if (env.is_proc(op) && ((op.asSymbol() == "+") || (op.asSymbol() == "*"))) {
+		Procedure proc = env.get_proc(op);
+		t.reserve(std::min(list.tailSize(), APPLY_CHUNK_SIZE) + 1);
+		// a chunk can fail before a later map stage would have, so once
+		// one fails the rest are only collected and the error is raised by
+		// the last call, after run_map_chain has reported any stage error
+		bool folding = true;
+		run_map_chain(stages, list, env, [&](const Expression & value) {
+			if (folding && (t.size() == APPLY_CHUNK_SIZE)) {
+				try {
+					Expression partial = proc(t);
+					t.clear();
+					t.push_back(partial);
+				}
+				catch (const SemanticError &) {
+					folding = false;
+				}
+			}
+			t.push_back(value);
+		});
+		return proc(t);
+	}
+
+	t.reserve(list.tailSize());
+	run_map_chain(stages, list, env, [&](const Expression & value) {
+		t.push_back(value);
+	});
+
+	if (env.is_proc(op)) {
+		return apply(op, t, env);
+	}
+	return lambdaEval(op.asSymbol(), env, t);
 }
 
-Expression Expression::handle_set_property(Environment &env)
+Expression Expression::handle_set_property(Environment &env) const
 {
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
 	if (m_tail.size() != 3) {
 		throw SemanticError("Error: invalid number of arguments to set-property");
 	}
@@ -376,7 +997,8 @@ Expression Expression::handle_set_property(Environment &env)
 	return t;
 }
 
-Expression Expression::handle_get_property(Environment &env) {
+Expression Expression::handle_get_property(Environment &env) const {
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
 	
 	if (m_tail.size() != 2) {
 		throw SemanticError("Error: invalid number of arguments to get-property");
@@ -396,35 +1018,36 @@ Expression Expression::handle_get_property(Environment &env) {
 	// eval tail[1]
 	Expression t = env.get_exp(m_tail[1].head());
 
-	auto it = t.property.find(m_tail[0].head().asSymbol());
-	if (it == t.property.end()) {
+	const Expression * value = t.property.find(m_tail[0].head().asSymbol());
+	if (value == nullptr) {
 		Expression result(Atom("NONE"));
 		return result;
 	}
 	else {
-		Expression result = t.property[m_tail[0].head().asSymbol()];
+		Expression result = *value;
 		return result;
 	}
 	
 }
 
-Expression Expression::construct_line(Expression&p1, Expression&p2, Environment &env) {
+Expression Expression::construct_line(Expression&p1, Expression&p2, Environment &env) const {
 	Expression result(Atom("make-line"));
 	result.append(p1);
 	result.append(p2);
 	Expression temp = result.eval(env);
-	temp.property["\"thickness\""] = Expression(0);
+	temp.property[THICKNESS_KEY] = Expression(0);
 	return temp;
 }
 
-Expression Expression::construct_point(double x, double y, Environment &env) {
+Expression Expression::construct_point(double x, double y, Environment &env) const {
 	Expression result(Atom("make-point"));
 	result.append(x);
 	result.append(y);
 	return result.eval(env);
 }
 
-std::map<std::string,double> Expression::scaling_factor_and_bounds(const Expression&data) {
+std::map<std::string,double> Expression::scaling_factor_and_bounds(const Expression&data) const {
+	TraceScope trace("scaling_factor_and_bounds");
 	std::map<std::string, double> result;
 	double x_max = -100000000;
 	double y_max = -100000000;
@@ -445,7 +1068,7 @@ std::map<std::string,double> Expression::scaling_factor_and_bounds(const Express
 	return result;
 }
 
-Expression Expression::add_axes(Environment &env, std::map<std::string, double> &values) {
+Expression Expression::add_axes(Environment &env, std::map<std::string, double> &values) const {
 	Expression result(Atom("list"));
 	if ((values["x_min"] <= 0) && (values["x_max"] >= 0)) {
 		Expression lower_p = construct_point(0, values["y_smin"], env);
@@ -462,7 +1085,7 @@ Expression Expression::add_axes(Environment &env, std::map<std::string, double>
 	return result;
 }
 
-Expression Expression::add_boundaries(Environment &env, std::map<std::string, double> &values) {
+Expression Expression::add_boundaries(Environment &env, std::map<std::string, double> &values) const {
 	Expression result(Atom("list"));
 
 	Expression TL = construct_point(values["x_smin"], values["y_smax"], env);
@@ -483,35 +1106,36 @@ Expression Expression::add_boundaries(Environment &env, std::map<std::string, do
 	return result;
 }
 
-Expression Expression::add_options(Environment &env, std::map<std::string, double> &values) {
+Expression Expression::add_options(Environment &env, std::map<std::string, double> &values) const {
 
 	Expression result(Atom(this->m_tail[1].head().asSymbol()));
 
-	result.property["\"object-name\""] = Expression(Atom("\"text\""));
-	result.property["\"text-scale\""] = Expression(values["text-scale"]);
+	result.property[OBJECT_NAME_KEY] = Expression(Atom("\"text\""));
+	result.property[TEXT_SCALE_KEY] = Expression(values["text-scale"]);
 
 	if (this->m_tail[0].head().asSymbol() == "\"title\"") {
-		result.property["\"text-rotation\""] = Expression(0);
+		result.property[TEXT_ROTATION_KEY] = Expression(0);
 		Expression pos = construct_point((values["x_smax"] + values["x_smin"]) / 2, values["y_smax"] - A, env);
-		result.property["\"position\""] = pos;
+		result.property[POSITION_KEY] = pos;
 	}
 
 	else if (this->m_tail[0].head().asSymbol() == "\"ordinate-label\"") {
-		result.property["\"text-rotation\""] = Expression(-(std::atan2(0, -1) / 2));
+		result.property[TEXT_ROTATION_KEY] = Expression(-(std::atan2(0, -1) / 2));
 		Expression pos = construct_point(values["x_smin"] - A, (values["y_smax"] + values["y_smin"]) / 2, env);
-		result.property["\"position\""] = pos;
+		result.property[POSITION_KEY] = pos;
 	}
 
 	else if (this->m_tail[0].head().asSymbol() == "\"abscissa-label\"") {
-		result.property["\"text-rotation\""] = Expression(0);
+		result.property[TEXT_ROTATION_KEY] = Expression(0);
 		Expression pos = construct_point((values["x_smax"] + values["x_smin"]) / 2, values["y_smin"] + A, env);
-		result.property["\"position\""] = pos;
+		result.property[POSITION_KEY] = pos;
 	}
 	return result;
 }
 
-Expression Expression::add_labels(Environment &env, std::map<std::string, double> &values)
+Expression Expression::add_labels(Environment &env, std::map<std::string, double> &values) const
 {
+	TraceScope trace("add_labels");
 	Expression result(Atom("list"));
 	Expression position;
 	std::ostringstream output;
@@ -519,63 +1143,83 @@ Expression Expression::add_labels(Environment &env, std::map<std::string, double
 	output << values["x_max"];
 	Expression AU(Atom("\"" + output.str() + "\""));
 	output.str("");
-	AU.property["\"object-name\""] = Expression(Atom("\"text\""));
-	AU.property["\"text-rotation\""] = Expression(0);
-	AU.property["\"text-scale\""] = Expression(values["text-scale"]);
+	AU.property[OBJECT_NAME_KEY] = Expression(Atom("\"text\""));
+	AU.property[TEXT_ROTATION_KEY] = Expression(0);
+	AU.property[TEXT_SCALE_KEY] = Expression(values["text-scale"]);
 	position = construct_point(values["x_smax"] , values["y_smin"] + C, env);
-	AU.property["\"position\""] = position;
+	AU.property[POSITION_KEY] = position;
 	result.append(AU);
 
 	output << values["y_max"];
 	Expression OU(Atom("\"" + output.str() + "\""));
 	output.str("");
-	OU.property["\"object-name\""] = Expression(Atom("\"text\""));
-	OU.property["\"text-rotation\""] = Expression(0);
-	OU.property["\"text-scale\""] = Expression(values["text-scale"]);
+	OU.property[OBJECT_NAME_KEY] = Expression(Atom("\"text\""));
+	OU.property[TEXT_ROTATION_KEY] = Expression(0);
+	OU.property[TEXT_SCALE_KEY] = Expression(values["text-scale"]);
 	position = construct_point(values["x_smin"] - D, values["y_smax"], env);
-	OU.property["\"position\""] = position;
+	OU.property[POSITION_KEY] = position;
 	result.append(OU);
 
 	output << values["x_min"];
 	Expression AL(Atom("\"" + output.str() + "\""));
 	output.str("");
-	AL.property["\"object-name\""] = Expression(Atom("\"text\""));
-	AL.property["\"text-rotation\""] = Expression(0);
-	AL.property["\"text-scale\""] = Expression(values["text-scale"]);
+	AL.property[OBJECT_NAME_KEY] = Expression(Atom("\"text\""));
+	AL.property[TEXT_ROTATION_KEY] = Expression(0);
+	AL.property[TEXT_SCALE_KEY] = Expression(values["text-scale"]);
 	position = construct_point(values["x_smin"], values["y_smin"] + C, env);
-	AL.property["\"position\""] = position;
+	AL.property[POSITION_KEY] = position;
 	result.append(AL);
 
 	output << values["y_min"];
 	Expression OL(Atom("\"" + output.str() + "\""));
 	output.str("");
-	OL.property["\"object-name\""] = Expression(Atom("\"text\""));
-	OL.property["\"text-rotation\""] = Expression(0);
-	OL.property["\"text-scale\""] = Expression(values["text-scale"]);
+	OL.property[OBJECT_NAME_KEY] = Expression(Atom("\"text\""));
+	OL.property[TEXT_ROTATION_KEY] = Expression(0);
+	OL.property[TEXT_SCALE_KEY] = Expression(values["text-scale"]);
 	position = construct_point(values["x_smin"] - D, values["y_smin"], env);
-	OL.property["\"position\""] = position;
+	OL.property[POSITION_KEY] = position;
 	result.append(OL);
 
 	return result;
 }
 
-void Expression::sample_points(Environment & env, Expression& newdata, const Atom & sym)
+// values of the plotted function at xs, in one batch
+std::vector<double> Expression::plot_values(const Atom & sym, const std::vector<double> & xs, Environment & env, const NumericFunction & compiled) const
+{
+	std::vector<std::vector<Expression>> args(1);
+	args[0].reserve(xs.size());
+	for (double x : xs) {
+		args[0].push_back(Expression(x));
+	}
+
+	std::vector<double> ys;
+	ys.reserve(xs.size());
+	for (auto & y : batch_eval(sym, env, compiled, args)) {
+		ys.push_back(y.head().asNumber());
+	}
+	return ys;
+}
+
+void Expression::sample_points(Environment & env, Expression& newdata, const Atom & sym, const NumericFunction & compiled) const
 {
+	TraceScope trace("sample_points");
 	double sampling = (this->m_tail[1].head().asNumber() - this->m_tail[0].head().asNumber()) / NUM_OF_ITERATIONS;
 	double x = m_tail[0].head().asNumber();
-	double y = 0;
+	std::vector<double> xs;
 	for (double i = 0; i <= NUM_OF_ITERATIONS; i++) {
-		std::vector<Expression> temp;
-		Expression t(x);
-		temp.push_back(t);
-		y = lambdaEval(sym, env, temp).head().asNumber();
-		Expression a = construct_point(x, y, env);
-		newdata.append(a);
+		xs.push_back(x);
 		x += sampling;
 	}
+
+	std::vector<double> ys = plot_values(sym, xs, env, compiled);
+	for (std::size_t i = 0; i < xs.size(); ++i) {
+		Expression a = construct_point(xs[i], ys[i], env);
+		newdata.append(a);
+	}
 }
 
-Expression Expression::draw_discrete(Environment &env, std::map<std::string, double> &value) {
+Expression Expression::draw_discrete(Environment &env, std::map<std::string, double> &value) const {
+	TraceScope trace("draw_discrete");
 	Expression result(Atom("list"));
  //Rescale all data to N*N
 
@@ -586,7 +1230,7 @@ Expression Expression::draw_discrete(Environment &env, std::map<std::string, dou
 		
 
 		Expression point = construct_point(rescaled_x, rescaled_y, env);
-		point.property["\"size\""] = Expression(0.5);
+		point.property[SIZE_KEY] = Expression(0.5);
 		result.append(point);
 		Expression point2;
 		if (value["y_min"] > 0) {
@@ -602,24 +1246,31 @@ Expression Expression::draw_discrete(Environment &env, std::map<std::string, dou
 	return result;
 }
 
-bool Expression::implement_iteration(Environment &env, Expression& new_points, Expression& current_points, const Atom & func) {
+bool Expression::implement_iteration(Environment &env, Expression& new_points, Expression& current_points, const Atom & func, const NumericFunction & compiled) const {
 	bool ret_value = false;
-	new_points.append(current_points.m_tail[0]);
+
+	// the midpoints of every corner sharper than 175 degrees, sampled in one batch
+	std::vector<unsigned int> corners;
+	std::vector<double> xs;
 	for (unsigned int iter=0;iter <= current_points.m_tail.size() - 2; iter+=2) {
-		
 		double angle = angle_between(current_points.m_tail[iter], current_points.m_tail[iter + 1], current_points.m_tail[iter + 2]);
 		if (angle < 175.0) {
-			Expression x1 = Expression((current_points.m_tail[iter].m_tail[0].head().asNumber() + current_points.m_tail[iter + 1].m_tail[0].head().asNumber()) / 2);
-			Expression x2 = Expression((current_points.m_tail[iter+1].m_tail[0].head().asNumber() + current_points.m_tail[iter + 2].m_tail[0].head().asNumber()) / 2);
-			std::vector<Expression> temp;
-			temp.push_back(x1);
-			Expression y1 = lambdaEval(func, env, temp);
-			temp.clear();
-			temp.push_back(x2);
-			Expression y2 = lambdaEval(func, env, temp);
-			new_points.append(construct_point(x1.head().asNumber(), y1.head().asNumber(), env));
+			corners.push_back(iter);
+			xs.push_back((current_points.m_tail[iter].m_tail[0].head().asNumber() + current_points.m_tail[iter + 1].m_tail[0].head().asNumber()) / 2);
+			xs.push_back((current_points.m_tail[iter+1].m_tail[0].head().asNumber() + current_points.m_tail[iter + 2].m_tail[0].head().asNumber()) / 2);
+		}
+	}
+	std::vector<double> ys = plot_values(func, xs, env, compiled);
+
+	new_points.append(current_points.m_tail[0]);
+	std::size_t corner = 0;
+	for (unsigned int iter=0;iter <= current_points.m_tail.size() - 2; iter+=2) {
+		
+		if ((corner < corners.size()) && (corners[corner] == iter)) {
+			new_points.append(construct_point(xs[2 * corner], ys[2 * corner], env));
 			new_points.append(current_points.m_tail[iter + 1]);
-			new_points.append(construct_point(x2.head().asNumber(), y2.head().asNumber(), env));
+			new_points.append(construct_point(xs[2 * corner + 1], ys[2 * corner + 1], env));
+			++corner;
 			ret_value = true;
 		}
 		else {
@@ -630,7 +1281,8 @@ bool Expression::implement_iteration(Environment &env, Expression& new_points, E
 	return ret_value;
 }
 
-Expression Expression::draw_continuous(Environment &env, std::map<std::string, double> &value, const Atom & func) {
+Expression Expression::draw_continuous(Environment &env, std::map<std::string, double> &value, const Atom & func, const NumericFunction & compiled) const {
+	TraceScope trace("draw_continuous");
 	Expression data_points(Atom("list"));
 	Expression new_data_points(Atom("list"));
 
@@ -645,7 +1297,7 @@ Expression Expression::draw_continuous(Environment &env, std::map<std::string, d
 	for (unsigned int i = 0; i < MAX_ITER; ++i) {
 		
 		//calling the function 10 times
-		angles_less_than_175 = implement_iteration(env,new_data_points,data_points,func);
+		angles_less_than_175 = implement_iteration(env,new_data_points,data_points,func,compiled);
 
 		if (!angles_less_than_175) {
 			break;
@@ -681,8 +1333,10 @@ Expression Expression::draw_continuous(Environment &env, std::map<std::string, d
 	return data_lines;
 }
 
-Expression Expression::handle_discrete_plot(Environment &env)
+Expression Expression::handle_discrete_plot(Environment &env) const
 {
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
 	Procedure proc = env.get_proc(m_head);
 	std::vector<Expression> results;
 	Expression data;
@@ -691,12 +1345,15 @@ Expression Expression::handle_discrete_plot(Environment &env)
 	if (m_tail.size() == 2) {
 		data = m_tail[0].eval(env);
 		options = m_tail[1].eval(env);
+		data.materialize();
+		options.materialize();
 		if ((options.head().asSymbol() != "list") || (data.head().asSymbol() != "list")) {
 			throw SemanticError("Error in call to discrete plot: Arguments must be of type list");
 		}
 	}
 	else if (m_tail.size() == 1) {
 		data = m_tail[0].eval(env);
+		data.materialize();
 		if (data.head().asSymbol() != "list") {
 			throw SemanticError("Error in call to discrete plot: Arguments must be of type list");
 		}
@@ -757,7 +1414,7 @@ Expression Expression::handle_discrete_plot(Environment &env)
 	return proc(results);
 }
 
-double Expression::angle_between(Expression p1, Expression p2, Expression p3) {
+double Expression::angle_between(Expression p1, Expression p2, Expression p3) const {
 	double x1 = p1.m_tail[0].head().asNumber();
 	double y1 = p1.m_tail[1].head().asNumber();
 	double x2 = p2.m_tail[0].head().asNumber();
@@ -778,7 +1435,9 @@ double Expression::angle_between(Expression p1, Expression p2, Expression p3) {
 }
 
 
-Expression Expression::handle_continuous_plot(Environment &env) {
+Expression Expression::handle_continuous_plot(Environment &env) const {
+	ProfiledCall call(Profiler::SPECIAL_FORM, m_head);
+
 	Procedure proc = env.get_proc(m_head);
 	std::vector<Expression> results;
 
@@ -790,6 +1449,8 @@ Expression Expression::handle_continuous_plot(Environment &env) {
 		func = m_tail[0];
 		bounds = m_tail[1].eval(env);
 		options = m_tail[2].eval(env);
+		bounds.materialize();
+		options.materialize();
 		if ((options.head().asSymbol() != "list") || (bounds.head().asSymbol() != "list")) {
 			throw SemanticError("Error in call to continuous plot: Arguments must be of type list");
 		}
@@ -798,6 +1459,7 @@ Expression Expression::handle_continuous_plot(Environment &env) {
 	else if (m_tail.size() == 2) {
 		func = m_tail[0];
 		bounds = m_tail[1].eval(env);
+		bounds.materialize();
 		
 		if (bounds.head().asSymbol() != "list") {
 			throw SemanticError("Error in call to continuous plot: Arguments must be of type list");
@@ -819,9 +1481,12 @@ Expression Expression::handle_continuous_plot(Environment &env) {
 			textScale = a.m_tail[1].head().asNumber();
 		}
 	}
+	// the lambda is compiled once for all the samples when it is numeric
+	NumericFunction compiled(func.head(), env);
+
 	Expression data(Atom("list"));
 	//Sampling equally spaced points and save it in Expression data
-	bounds.sample_points(env, data, func.head());
+	bounds.sample_points(env, data, func.head(), compiled);
 	
 
 	//Get max, min and scale
@@ -832,7 +1497,7 @@ Expression Expression::handle_continuous_plot(Environment &env) {
 	values["y_smax"] = values["y_scale"] * values["y_max"] * -1;
 	values["y_smin"] = values["y_scale"] * values["y_min"] * -1;
 
-	Expression t = data.draw_continuous(env, values, func.head());
+	Expression t = data.draw_continuous(env, values, func.head(), compiled);
 	for (auto & a : t.m_tail) {
 		results.push_back(a);
 	}
@@ -874,58 +1539,71 @@ Expression Expression::handle_continuous_plot(Environment &env) {
 // this is a simple recursive version. the iterative version is more
 // difficult with the ast data structure used (no parent pointer).
 // this limits the practical depth of our AST
-Expression Expression::eval(Environment & env){
+Expression Expression::eval(Environment & env) const{
+
+  // a lazy sequence holds only Numbers, which evaluate to themselves
+  if(m_sequence){
+    return *this;
+  }
  
-  if(m_tail.empty() && (m_head.asSymbol()!="list")){
+  if(m_tail.empty() && (m_head != LIST_SYMBOL) && (m_head != MEMO_STATS_SYMBOL)){
     return handle_lookup(m_head, env);
   }
 
   // handle begin special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "begin"){
+  else if(m_head == BEGIN_SYMBOL){
     return handle_begin(env);
   }
   // handle define special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "define"){
+  else if(m_head == DEFINE_SYMBOL){
     return handle_define(env);
   }
 
   // handle lambda special-forms
-  else if (((m_head.isSymbol()) && (m_head.asSymbol() == "lambda"))) {
+  else if (m_head == LAMBDA_SYMBOL) {
 	  return handle_lambda(env);
   }
 
-  else if (m_head.isSymbol() && m_head.asSymbol() == "apply") {
+  else if (m_head == APPLY_SYMBOL) {
 	  return handle_apply(env);
   }
 
-  else if (m_head.isSymbol() && m_head.asSymbol() == "map") {
+  else if (m_head == MAP_SYMBOL) {
 	  return handle_map(env);
   }
 	
-	else if (m_head.isSymbol() && m_head.asSymbol() == "set-property") {
+	else if (m_head == SET_PROPERTY_SYMBOL) {
 		return handle_set_property(env);
 	}
 
-	else if (m_head.isSymbol() && m_head.asSymbol() == "get-property") {
+	else if (m_head == GET_PROPERTY_SYMBOL) {
 		return handle_get_property(env);
 	}
 
-	else if (m_head.isSymbol() && m_head.asSymbol() == "discrete-plot") {
+	else if (m_head == DISCRETE_PLOT_SYMBOL) {
 		return handle_discrete_plot(env);
 	}
 
-	else if (m_head.isSymbol() && m_head.asSymbol() == "continuous-plot") {
+	else if (m_head == CONTINUOUS_PLOT_SYMBOL) {
 		return handle_continuous_plot(env);
 	}
 
+	else if (m_head == MEMOIZE_SYMBOL) {
+		return handle_memoize(env);
+	}
+
+	else if (m_head == MEMO_STATS_SYMBOL) {
+		return handle_memo_stats(env);
+	}
+
   else if (env.isLambda(m_head)) {
 
-	  return lambdaEval(m_head,env,m_tail);
+	  return lambdaEval(m_head,env,std::vector<Expression>(m_tail.cbegin(), m_tail.cend()));
   }
   
   else{ 
     std::vector<Expression> results;
-    for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
+    for(auto it = m_tail.cbegin(); it != m_tail.cend(); ++it){
       results.push_back(it->eval(env));
     }
     return apply(m_head, results, env);
@@ -935,104 +1613,86 @@ Expression Expression::eval(Environment & env){
 
 
 std::ostream & operator<<(std::ostream & out, const Expression & exp){
-  //Check if complex, and if it is then don't print the brackets becasue 
-  //std::cout or complex contain ()
-  if(exp.head().isComplex())
-  {
-    out << exp.head();
-    for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
-    out << *e;
-    }
-  }
-
-
+  Printer printer(out);
+  printer.print(exp);
+  return out;
+}
 
-  else if (exp.head().asSymbol() == "list"){
-	  out << "(";
-	  /*out << exp.head();*/
+bool Expression::operator==(const Expression & exp) const noexcept{
 
-	  for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
-		out << *e;
-		if (e != exp.tailConstEnd() - 1)
-		{
-			out << " ";
-		}
-	  }
+  bool result = (m_head == exp.m_head);
 
-	  out << ")";
+  // shared tails, as left by hash-consing, are equal without a walk
+  if(result && !m_sequence && !exp.m_sequence && m_tail.sameAs(exp.m_tail)){
+    return property == exp.property;
   }
-  
 
-  else if (exp.head().asSymbol() == "lambda") {
-	  out << "(";
-	  
-	  for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
-			  out << "";
-			  out << *e;
-
-		  if (e != exp.tailConstEnd() - 1)
-		  {
-			  out << " ";
-		  }
-	  }
-	  out << ")";
+  result = result && (tailSize() == exp.tailSize()) && (property.size() == exp.property.size());
+
+  if(result){
+    for(auto lefte = tailConstBegin(), righte = exp.tailConstBegin();
+	(lefte != tailConstEnd()) && (righte != exp.tailConstEnd());
+	++lefte, ++righte){
+      result = result && (*lefte == *righte);
+    }
   }
 
-	else if (exp.head().asSymbol() == "NONE") {
-		out << exp.head();
-	}
+	result = result && (property == exp.property);
 
-  else if (exp.head().isSymbol()) {
-	  out << "(";
-	  out << exp.head();
+  return result;
+}
 
-	  for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
-		  out <<" "<<*e;
-	  }
+bool Expression::identical(const Expression & exp) const noexcept{
 
-	  out << ")";
+  // different cached hashes settle the common unequal case
+  std::size_t left_hash = m_hash.load(std::memory_order_relaxed);
+  std::size_t right_hash = exp.m_hash.load(std::memory_order_relaxed);
+  if((left_hash != 0) && (right_hash != 0) && (left_hash != right_hash)){
+    return false;
   }
 
-  else{
-	  out << "(";
-	  out << exp.head();
-
-	  for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
-		  out << *e;
-		  if (e != exp.tailConstEnd() - 1)
-		  {
-			  out << " ";
-		  }
-	  }
+  if(!m_head.identical(exp.m_head) || (tailSize() != exp.tailSize()) ||
+     (property.size() != exp.property.size())){
+    return false;
+  }
 
-	  out << ")";
+  // shared tails, as left by hash-consing, are identical without a walk
+  if(m_sequence || exp.m_sequence || !m_tail.sameAs(exp.m_tail)){
+    for(auto lefte = tailConstBegin(), righte = exp.tailConstBegin(); lefte != tailConstEnd(); ++lefte, ++righte){
+      if(!lefte->identical(*righte)) return false;
+    }
   }
 
-  return out;
+  for(auto & p : property){
+    const Expression * value = exp.property.find(p.first);
+    if(!value || !value->identical(p.second)) return false;
+  }
+  return true;
 }
 
-bool Expression::operator==(const Expression & exp) const noexcept{
-
-  bool result = (m_head == exp.m_head);
-
-  result = result && (m_tail.size() == exp.m_tail.size()) && (property.size() == exp.property.size());
+std::size_t Expression::hash() const noexcept{
+  std::size_t result = m_hash.load(std::memory_order_relaxed);
+  if(result != 0){
+    return result;
+  }
 
-  if(result){
-    for(auto lefte = m_tail.begin(), righte = exp.m_tail.begin();
-	(lefte != m_tail.end()) && (righte != exp.m_tail.end());
-	++lefte, ++righte){
-      result = result && (*lefte == *righte);
-    }
+  result = m_head.hash();
+  for(auto e = tailConstBegin(); e != tailConstEnd(); ++e){
+    result = result * 1000003 + e->hash();
   }
+  result = result * 31 + tailSize();
 
-	if (result) {
-		for (auto lefte = property.begin(), righte = exp.property.begin();
-			(lefte != property.end()) && (righte != exp.property.end());
-			++lefte, ++righte) {
-			result = result && (*lefte == *righte);
-		}
-	}
+  // properties compare in any order, so combine their hashes commutatively
+  std::size_t properties = 0;
+  for(auto & p : property){
+    properties += (std::hash<SymbolId>()(p.first) * 31) ^ p.second.hash();
+  }
+  result ^= properties * 0x9e3779b97f4a7c15ull;
 
+  if(result == 0){
+    result = 1;
+  }
+  m_hash.store(result, std::memory_order_relaxed);
   return result;
 }
 
@@ -7,13 +7,19 @@ Defines the Expression type and assiciated functions.
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <functional>
+#include <atomic>
 #include "token.hpp"
 #include "atom.hpp"
+#include "shared_list.hpp"
+#include "property_list.hpp"
 
 
 //static auto ptr = &INTERRUPT_IS_SET;
 // forward declare Environment
 class Environment;
+class NumericFunction;
 
 /*! \class Expression
 \brief An expression is a tree of Atoms.
@@ -24,7 +30,7 @@ list of expressions called the tail.
 class Expression {
 public:
 
-  typedef std::vector<Expression>::const_iterator ConstIteratorType;
+  typedef SharedList<Expression>::const_iterator ConstIteratorType;
 	//typedef std::vector<Expression>::iterator IteratorType;
 
   /// Default construct and Expression, whose type in NoneType
@@ -35,20 +41,31 @@ public:
   */
   Expression(const Atom & a);
 
-  /// deep-copy construct an expression (recursive)
+  /*! Construct a list whose tail is the arithmetic sequence
+    begin, begin+step, begin+step+step, ... of count Numbers. The tail is
+    generated lazily and only materialized when it is iterated.
+  */
+  static Expression makeSequence(double begin, double step, std::size_t count);
+
+  /*! Construct a list whose tail is the Numbers of values, kept packed
+    and only materialized as Expressions when the tail is iterated.
+  */
+  static Expression makeNumbers(std::vector<double> values);
+
+  /// copy construct an expression, the tail is shared until modified
   Expression(const Expression & a);
 
-  /// deep-copy assign an expression  (recursive)
+  /// copy assign an expression, the tail is shared until modified
   Expression & operator=(const Expression & a);
 
   /// return a reference to the head Atom
   Atom & head();
 
-	/// return a reference to the property map
-	std::map<std::string, Expression>& prop();
+	/// return a reference to the property list
+	PropertyList<Expression>& prop();
 	 
-	///returns a const refernce to prop map
-	const std::map<std::string, Expression>& prop() const;
+	///returns a const refernce to property list
+	const PropertyList<Expression>& prop() const;
 
   /// return a const-reference to the head Atom
   const Atom & head() const;
@@ -66,10 +83,23 @@ public:
   ConstIteratorType tailConstEnd() const noexcept;
 
 	///return a iterator to the beginning of tail
-	std::vector<Expression>::iterator tailBegin() noexcept;
+	SharedList<Expression>::iterator tailBegin() noexcept;
 
 	/// return a const-iterator to the tail end
-	std::vector<Expression>::iterator tailEnd() noexcept;
+	SharedList<Expression>::iterator tailEnd() noexcept;
+
+  /// number of expressions in the tail, does not materialize a lazy tail
+  std::size_t tailSize() const noexcept;
+
+  /// copy of the first expression in the tail, which must not be empty
+  Expression tailFirst() const;
+
+  /// list of all but the first expression in the tail, which must not be empty.
+  /// The result shares the tail of this expression, so this is O(1).
+  Expression tailRest() const;
+
+  /// call f on each expression of the tail in order, without materializing a lazy tail
+  void forEachTail(const std::function<void(const Expression &)> & f) const;
 
   /// convienience member to determine if head atom is a number
   bool isHeadNumber() const noexcept;
@@ -80,14 +110,42 @@ public:
   /// conviniennce member to determine if head atom is a complex
   bool isHeadComplex() const noexcept;
 
-  /// Evaluate expression using a post-order traversal (recursive)
-  Expression eval(Environment & env);
+  /// Evaluate expression using a post-order traversal (recursive). The
+  /// expression itself is not modified, so it may be shared between threads.
+  Expression eval(Environment & env) const;
 
   /// Evaluate lambda expression using a post-order traversal (recursive)
-  Expression lambdaEval(const Atom & sym, Environment & env, std::vector<Expression>m_tail);
+  Expression lambdaEval(const Atom & sym, Environment & env, std::vector<Expression>m_tail) const;
+
+  /*! Evaluate the lambda named sym once for each tuple of a batch of
+    arguments, giving the same values as calling lambdaEval on each tuple
+    in turn. When the lambda compiles to a NumericFunction the real
+    arguments are evaluated together, the others with lambdaEval.
+    \param args one column of argument values per parameter, all of the same length
+    \return the value for each tuple
+   */
+  std::vector<Expression> lambdaEvalBatch(const Atom & sym, Environment & env,
+    const std::vector<std::vector<Expression>> & args) const;
+
+  /// move any part of the expression allocated in an Arena to the heap (recursive)
+  void promote();
+
+  /// a deep copy allocated on the heap, sharing no memory with this expression
+  Expression heapCopy() const;
 
   /// equality comparison for two expressions (recursive)
   bool operator==(const Expression & exp) const noexcept;
+
+  /*! exact comparison for two expressions (recursive), numbers must have
+    the same bits rather than be equal within the tolerance of operator==
+   */
+  bool identical(const Expression & exp) const noexcept;
+
+  /*! Structural hash of the head, tail and properties (recursive). It is
+    computed on the first call and cached until the expression is
+    modified. Identical expressions have equal hashes.
+   */
+  std::size_t hash() const noexcept;
   
   /// Appending expressions into expressions
   void append(const Expression &E);
@@ -99,49 +157,88 @@ private:
   // the head of the expression
   Atom m_head;
 
-  // the tail list is expressed as a vector for access efficiency
-  // and cache coherence, at the cost of wasted memory.
-  std::vector<Expression> m_tail;
+  // the tail list is a shared vector for access efficiency and cache
+  // coherence. Copies share it and detach on the first modification.
+  SharedList<Expression> m_tail;
+
+  // a lazily generated arithmetic sequence, with values accumulated by
+  // repeated addition of step, or packed Numbers standing in for m_tail
+  struct Sequence;
+
+  // non-null while the tail is an unmaterialized sequence
+  std::shared_ptr<Sequence> m_sequence;
+
+  // fill m_tail from m_sequence, if there is one
+  void materialize();
 
-	std::map<std::string,Expression> property;
+	// properties keyed by interned symbol, empty unless set-property was used
+	PropertyList<Expression> property;
+
+  // cached structural hash, 0 until computed. Not copied, so only the
+  // expression hash was called on, and the elements it shares, have one.
+  mutable std::atomic<std::size_t> m_hash;
+
+  // forget the cached hash before the expression is modified
+  void invalidate() noexcept { m_hash.store(0, std::memory_order_relaxed); }
 
   // convenience typedef
-  typedef std::vector<Expression>::iterator IteratorType;
+  typedef SharedList<Expression>::iterator IteratorType;
   
   // internal helper methods
-  Expression handle_lookup(const Atom & head, const Environment & env);
-  Expression handle_define(Environment & env);
-  Expression handle_begin(Environment & env);
-  Expression handle_lambda(Environment & env);
-  Expression handle_apply(Environment &env);
-  Expression handle_map(Environment &env);
-	Expression handle_set_property(Environment &env);
-	Expression handle_get_property(Environment &env);
-	Expression handle_discrete_plot(Environment &env);
-	Expression handle_continuous_plot(Environment &env);
+  Expression handle_lookup(const Atom & head, const Environment & env) const;
+  Expression handle_define(Environment & env) const;
+  Expression handle_begin(Environment & env) const;
+  Expression handle_lambda(Environment & env) const;
+  Expression handle_apply(Environment &env) const;
+  Expression handle_map(Environment &env) const;
+  Expression handle_memoize(Environment &env) const;
+  Expression handle_memo_stats(Environment &env) const;
+
+  // helpers for fused evaluation of (apply f (map g (map h ... list)))
+  Expression call_unary(const Atom & op, const Expression & arg, Environment & env) const;
+  std::vector<Expression> batch_eval(const Atom & sym, Environment & env, const NumericFunction & compiled,
+    const std::vector<std::vector<Expression>> & args) const;
+  bool map_compiled(const std::vector<Atom> & stages, const Expression & list, Environment & env, Expression & result) const;
+  const Expression & map_chain(Environment & env, std::vector<Atom> & stages) const;
+  Expression map_source(const Expression & source, Environment & env) const;
+  Expression map_chain_unfused(const std::vector<Atom> & stages, const Expression & list, Environment & env) const;
+  void run_map_chain(const std::vector<Atom> & stages, const Expression & list, Environment & env,
+    const std::function<void(const Expression &)> & sink) const;
+
+  // purity analysis deciding whether map may run in parallel
+  static bool is_pure(const Expression & exp, const Environment & env,
+    std::vector<std::string> & locals, std::vector<std::string> & visiting);
+  static bool is_pure_callee(const Atom & op, const Environment & env,
+    std::vector<std::string> & locals, std::vector<std::string> & visiting);
+	Expression handle_set_property(Environment &env) const;
+	Expression handle_get_property(Environment &env) const;
+	Expression handle_discrete_plot(Environment &env) const;
+	Expression handle_continuous_plot(Environment &env) const;
+
+	Expression construct_line(Expression&p1, Expression&p2, Environment &env) const;
 
-	Expression construct_line(Expression&p1, Expression&p2, Environment &env);
+	Expression construct_point(double x, double y, Environment &env) const;
 
-	Expression construct_point(double x, double y, Environment &env);
+	std::map<std::string, double> scaling_factor_and_bounds(const Expression&data) const;
 
-	std::map<std::string, double> scaling_factor_and_bounds(const Expression&data);
+	Expression add_options(Environment &env, std::map<std::string, double> &values) const;
 
-	Expression add_options(Environment &env, std::map<std::string, double> &values);
+	Expression add_boundaries(Environment &env, std::map<std::string, double> &value) const;
 
-	Expression add_boundaries(Environment &env, std::map<std::string, double> &value);
+	Expression add_axes(Environment &env, std::map<std::string, double> &value) const;
 
-	Expression add_axes(Environment &env, std::map<std::string, double> &value);
+	Expression draw_discrete(Environment &env, std::map<std::string, double> &value) const;
+	Expression draw_continuous(Environment &env, std::map<std::string, double> &value, const Atom & sym, const NumericFunction & compiled) const;
 
-	Expression draw_discrete(Environment &env, std::map<std::string, double> &value);
-	Expression draw_continuous(Environment &env, std::map<std::string, double> &value, const Atom & sym);
+	Expression add_labels(Environment &env, std::map<std::string, double> &values) const;
 
-	Expression add_labels(Environment &env, std::map<std::string, double> &values);
+	void sample_points(Environment &env, Expression& newdata, const Atom & sym, const NumericFunction & compiled) const;
 
-	void sample_points(Environment &env, Expression& newdata, const Atom & sym);
+	bool implement_iteration(Environment &env, Expression& new_points,Expression& current_points,const Atom & sym, const NumericFunction & compiled) const;
 
-	bool implement_iteration(Environment &env, Expression& new_points,Expression& current_points,const Atom & sym);
+	std::vector<double> plot_values(const Atom & sym, const std::vector<double> & xs, Environment &env, const NumericFunction & compiled) const;
 
-	double angle_between(Expression p1, Expression p2, Expression p3);
+	double angle_between(Expression p1, Expression p2, Expression p3) const;
 
 	
 };
@@ -1,6 +1,10 @@
 #include "catch.hpp"
 
+#include <sstream>
+
+#include "environment.hpp"
 #include "expression.hpp"
+#include "parse.hpp"
 #include "ostream"
 
 TEST_CASE( "Test default expression", "[expression]" ) {
@@ -61,3 +65,78 @@ TEST_CASE(" Test const prop function", "[expression]") {
 	const auto pro = exp.prop();
 	REQUIRE(pro.size() == 0);
 }
+
+TEST_CASE( "Test structural hash", "[expression]" ) {
+
+  Expression a(Atom("+"));
+  a.append(Atom(1.0));
+  a.append(Atom("x"));
+
+  Expression b(Atom("+"));
+  b.append(Atom(1.0));
+  b.append(Atom("x"));
+
+  REQUIRE(a == b);
+  REQUIRE(a.hash() == b.hash());
+
+  REQUIRE(a.identical(b));
+
+  // numbers equal within the comparison tolerance are not identical, and
+  // small numbers do not share one hash
+  Expression c(Atom("+"));
+  c.append(Atom(0.5));
+  Expression d(Atom("+"));
+  d.append(Atom(0.5 + 1e-16));
+  REQUIRE(Atom(0.5).asNumber() != Atom(0.5 + 1e-16).asNumber());
+  REQUIRE(c == d);
+  REQUIRE(!c.identical(d));
+  REQUIRE(Atom(0.25).hash() != Atom(0.5).hash());
+  REQUIRE(!Atom(0.0).identical(Atom(-0.0)));
+
+  // the cached hash is dropped when the expression changes
+  b.append(Atom(2.0));
+  REQUIRE(a != b);
+  REQUIRE(a.hash() != b.hash());
+
+  // properties compare, and hash, independently of their order
+  Expression p(Atom(1.0));
+  p.prop()["\"a\""] = Expression(Atom(1.0));
+  p.prop()["\"b\""] = Expression(Atom(2.0));
+  Expression q(Atom(1.0));
+  q.prop()["\"b\""] = Expression(Atom(2.0));
+  q.prop()["\"a\""] = Expression(Atom(1.0));
+  REQUIRE(p == q);
+  REQUIRE(p.identical(q));
+  REQUIRE(p.hash() == q.hash());
+}
+
+TEST_CASE( "Test batch lambda evaluation", "[expression]" ) {
+
+  Environment env;
+  std::istringstream iss("(define f (lambda (x y) (+ (* x y) (sqrt x))))");
+  parse(tokenize(iss)).eval(env);
+
+  std::vector<std::vector<Expression>> args = {
+    {Expression(4.), Expression(-1.), Expression(std::complex<double>(0, 1)), Expression(9.)},
+    {Expression(1.), Expression(2.), Expression(3.), Expression(0.)}
+  };
+
+  Expression call(Atom("f"));
+  std::vector<Expression> results = call.lambdaEvalBatch(Atom("f"), env, args);
+  REQUIRE(results.size() == 4);
+  for(std::size_t i = 0; i < results.size(); ++i){
+    std::vector<Expression> tuple = {args[0][i], args[1][i]};
+    REQUIRE(results[i] == call.lambdaEval(Atom("f"), env, tuple));
+  }
+  REQUIRE(results[0] == Expression(6.));
+  REQUIRE(results[1].isHeadComplex());
+
+  // a lambda that does not compile is evaluated tuple by tuple
+  std::istringstream iss2("(define g (lambda (x) (list x)))");
+  parse(tokenize(iss2)).eval(env);
+  results = call.lambdaEvalBatch(Atom("g"), env, std::vector<std::vector<Expression>>(1, args[1]));
+  REQUIRE(results.size() == 4);
+  REQUIRE(results[3].tailSize() == 1);
+
+  REQUIRE_THROWS(call.lambdaEvalBatch(Atom("f"), env, std::vector<std::vector<Expression>>(1, args[1])));
+}
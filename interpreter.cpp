@@ -2,6 +2,7 @@
 #include "interpreter.hpp"
 
 // system includes
+#include <sstream>
 #include <stdexcept>
 
 // module includes
@@ -10,18 +11,75 @@
 #include "expression.hpp"
 #include "environment.hpp"
 #include "semantic_error.hpp"
+#include "trace.hpp"
+
+Interpreter::Interpreter():
+  counts(), cache(new ParseCache(ParseCache::defaultCapacity())), arena(new Arena(Arena::defaultCapacity())){}
 
 bool Interpreter::parseStream(std::istream & expression) noexcept{
 
   TokenSequenceType tokens = tokenize(expression);
 
   ast = parse(tokens);
+  if(ast == Expression()){
+    return false;
+  }
 
-  return (ast != Expression());
+  fold();
+  return true;
 };
+
+bool Interpreter::parseString(const std::string & program) noexcept{
+
+  // the folded AST is cached, it is folded again once a constant it may
+  // have folded is bound or given another value
+  if(cache->find(program, ast, folder.foldable(env))){
+    return true;
+  }
+
+  std::istringstream expression(program);
+  ast = parse(tokenize(expression));
+  if(ast == Expression()){
+    return false;
+  }
+
+  fold();
+  cache->insert(program, ast, folder.foldable(env));
+  return true;
+}
+
+void Interpreter::fold() noexcept{
+  TraceScope trace("fold");
+  ast = folder.fold(ast, env);
+}
      
 
 Expression Interpreter::evaluate(){
-	Expression ret = ast.eval(env);
+	TraceScope trace("evaluate");
+	ArenaScope scope(*arena);
+	ProfilerScope profiling(profiler.get());
+	Counters::Counts before = Counters::snapshot();
+	Expression ret;
+	try {
+		ret = ast.eval(env);
+	}
+	catch (...) {
+		release();
+		counts = Counters::snapshot() - before;
+		throw;
+	}
+	ret.promote();
+	release();
+	counts = Counters::snapshot() - before;
 	return ret;
 }
+
+void Interpreter::enableProfiling(bool enabled){
+	profiler.reset(enabled ? new Profiler() : nullptr);
+}
+
+void Interpreter::release(){
+	ast.promote();
+	env.promote();
+	arena->reset();
+}
@@ -9,35 +9,95 @@ It maintains an environment during evaluation.
 
 // system includes
 #include <istream>
+#include <memory>
 #include <string>
 
 // module includes
+#include "arena.hpp"
+#include "constant_fold.hpp"
+#include "counters.hpp"
 #include "environment.hpp"
 #include "expression.hpp"
+#include "parse.hpp"
+#include "parse_cache.hpp"
+#include "profiler.hpp"
 
 /*! \class Interpreter
 \brief Class to parse and evaluate an expression (program)
 
 Interpreter has an Environment, which starts at a default.
-The parse method builds an internal AST.
+The parse method builds an internal AST, in which calls of pure built-in
+procedures on constants are folded.
 The eval method updates Environment and returns last result.
+Programs parsed from a string are kept folded in a ParseCache, so a
+program submitted again is neither parsed nor folded again.
+
+When profiling is enabled, the calls made by evaluate are recorded in a
+Profiler. In a build with counters, the copies and heap allocations made
+by the last evaluate are kept in stats.
+
+Temporaries built during one call to evaluate are allocated in an Arena
+that is reset when the call returns. The result, the definitions it made
+and the AST are promoted to the heap first.
 */
 
 class Interpreter {
 public:
 
+  /// Construct an interpreter with the default environment
+  Interpreter();
+
   /*! Parse into an internal Expression from a stream
     \param expression the raw text stream repreenting the candidate expression
     \return true on successful parsing 
    */
   bool parseStream(std::istream &expression) noexcept;
 
+  /*! Parse a program held in a string into the internal Expression,
+    reusing the AST of the same text when it is in the parse cache
+    \param program the text of the program
+    \return true on successful parsing
+   */
+  bool parseString(const std::string & program) noexcept;
+
+  /*! Parse the next top-level expression of reader into the internal Expression
+    \param reader the reader of a program of one or more expressions, a
+    Reader or anything with its next and failed members
+    \return true if an expression was parsed, false at the end of the
+    program or on a parse error, see Reader::failed
+   */
+  template<typename ReaderType>
+  bool parseNext(ReaderType & reader) noexcept{
+    if(!reader.next(ast)){
+      ast = Expression();
+      return false;
+    }
+    fold();
+    return true;
+  }
+
   /*! Evaluate the Expression by walking the tree, returning the result.
     \return the Expression resulting from the evaluation in the current environment
     \throws SemanticError when a semantic error is encountered
    */
   Expression evaluate();
 
+  /*! Record a profile of the following evaluations. Enabling profiling
+    starts a new profile, disabling it discards the profile.
+   */
+  void enableProfiling(bool enabled);
+
+  /// the profile recorded so far, or nullptr if profiling is disabled
+  const Profiler * profile() const noexcept { return profiler.get(); }
+
+  /*! The copies and heap allocations made by the last evaluate, all 0
+    unless Counters::compiled().
+   */
+  const Counters::Counts & stats() const noexcept { return counts; }
+
+  /// the cache of the ASTs parsed by parseString
+  const ParseCache & parseCache() const noexcept { return *cache; }
+
 	//void send_signal(env_mqueue *signal) {
 	//	env.setSignal(signal);
 	//}
@@ -49,6 +109,27 @@ private:
 
   // the AST
   Expression ast;
+
+  // folds constant calls of each parsed AST
+  ConstantFolder folder;
+
+  // profile of the evaluations, when profiling is enabled
+  std::unique_ptr<Profiler> profiler;
+
+  // counts made by the last evaluate
+  Counters::Counts counts;
+
+  // ASTs parsed by parseString, by program text
+  std::unique_ptr<ParseCache> cache;
+
+  // arena for the temporaries of one evaluate
+  std::unique_ptr<Arena> arena;
+
+  // fold the constant calls of the AST
+  void fold() noexcept;
+
+  // promote everything that outlives evaluate and reset the arena
+  void release();
 };
 
 #endif
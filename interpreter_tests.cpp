@@ -1,13 +1,16 @@
 #include "catch.hpp"
 
+#include <cstdio>
 #include <string>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 #include "semantic_error.hpp"
 #include "interpreter.hpp"
 #include "expression.hpp"
+#include "thread_pool.hpp"
 
 Expression run(const std::string & program){
   
@@ -901,6 +904,18 @@ TEST_CASE("get-property", "[interpreter]") {
 		Expression result2(Atom("NONE"));
 		REQUIRE(result2 == result);
 	}
+
+	SECTION("valid get-property calls") {
+		std::string input = "(begin (define b (set-property \"size\" 2 (set-property \"note\" \"two\" (1)))) "
+			"(define b (set-property \"size\" 3 b)) (list (get-property \"size\" b) (get-property \"note\" b)))";
+		REQUIRE(run(input) == run("(list 3 \"two\")"));
+	}
+
+	SECTION("properties compare in any order") {
+		REQUIRE(run("(set-property \"a\" 1 (set-property \"b\" 2 (0)))") ==
+			run("(set-property \"b\" 2 (set-property \"a\" 1 (0)))"));
+		REQUIRE(run("(set-property \"a\" 1 (0))") != run("(set-property \"a\" 2 (0))"));
+	}
 }
 
 TEST_CASE("get tail", "[interpreter]") {
@@ -973,3 +988,338 @@ TEST_CASE("continuous plot", "[interpreter]") {
 	}
 
 }
+
+TEST_CASE("read-csv", "[interpreter]") {
+	{
+		std::ofstream out("read_csv_tests.csv");
+		out << "x,y\n1,2\n3,4.5\n5,6\n";
+	}
+	SECTION("one column is a list of numbers") {
+		Expression comp(Atom("list"));
+		comp.append(2.);
+		comp.append(4.5);
+		comp.append(6.);
+		REQUIRE(run("(read-csv \"read_csv_tests.csv\" 1)") == comp);
+		REQUIRE(run("(read-csv \"read_csv_tests.csv\" \"y\")") == comp);
+		REQUIRE(run("(first (rest (read-csv \"read_csv_tests.csv\" 1)))") == Expression(4.5));
+		REQUIRE(run("(length (rest (read-csv \"read_csv_tests.csv\" 0)))") == Expression(2.));
+		REQUIRE(run("(apply + (map - (read-csv \"read_csv_tests.csv\" 0)))") == Expression(-9.));
+	}
+	SECTION("more columns are a list of points") {
+		Expression result = run("(read-csv \"read_csv_tests.csv\" \"x\" 1)");
+		REQUIRE(result == run("(list (list 1 2) (list 3 4.5) (list 5 6))"));
+		REQUIRE(runplot("(discrete-plot (read-csv \"read_csv_tests.csv\" 0 1))") ==
+			runplot("(discrete-plot (list (list 1 2) (list 3 4.5) (list 5 6)))"));
+	}
+	SECTION("errors") {
+		std::string programs[] = {"(read-csv \"read_csv_tests.csv\")", "(read-csv 1 0)",
+			"(read-csv \"read_csv_tests.csv\" -1)", "(read-csv \"read_csv_tests.csv\" 0.5)",
+			"(read-csv \"read_csv_tests.csv\" \"z\")", "(read-csv \"read_csv_tests.csv\" 2)",
+			"(read-csv \"missing.csv\" 0)", "(read-csv \"read_csv_tests.csv\" 1e15)",
+			"(read-csv \"read_csv_tests.csv\" 1e19)", "(read-csv \"read_csv_tests.csv\" 1e300)"};
+		for (auto & program : programs) {
+			std::istringstream iss(program);
+			Interpreter interp;
+			REQUIRE(interp.parseStream(iss));
+			REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+		}
+	}
+	std::remove("read_csv_tests.csv");
+}
+
+TEST_CASE("lazy range", "[interpreter]") {
+	SECTION("length, first and rest of a large range") {
+		REQUIRE(run("(length (range 0 1000000 1))") == Expression(1000001.));
+		REQUIRE(run("(first (range 5 1000000 1))") == Expression(5.));
+		REQUIRE(run("(first (rest (range 5 1000000 1)))") == Expression(6.));
+		REQUIRE(run("(length (rest (range 0 1000000 1)))") == Expression(1000000.));
+	}
+	SECTION("fractional steps accumulate like the eager range") {
+		Expression result = run("(range 0 1 0.1)");
+		Expression comp(Atom("list"));
+		for (double x = 0; x <= 1; x += 0.1) {
+			comp.append(Expression(x));
+		}
+		REQUIRE(result == comp);
+		REQUIRE(run("(length (range 0 1 0.1))") == Expression(static_cast<double>(comp.tailSize())));
+	}
+	SECTION("empty and single element ranges") {
+		REQUIRE(run("(range 5 1 1)") == Expression(Atom("list")));
+		REQUIRE(run("(rest (range 1 1 1))") == Expression(Atom("list")));
+	}
+	SECTION("map and apply over a range") {
+		Expression result = run("(map - (range 1 3 1))");
+		Expression comp(Atom("list"));
+		comp.append(-1);
+		comp.append(-2);
+		comp.append(-3);
+		REQUIRE(result == comp);
+		REQUIRE(run("(apply + (range 0 1000000 1))") == Expression(500000500000.));
+		REQUIRE(run("(apply * (range 1 5 1))") == Expression(120.));
+		REQUIRE(run("(begin (define r (range 1 4 1)) (apply + r))") == Expression(10.));
+	}
+}
+
+TEST_CASE("fused map and apply chains", "[interpreter]") {
+	SECTION("chains of builtins") {
+		REQUIRE(run("(apply + (map - (map / (range 1 3 1))))") == Expression(-(1 + 0.5 + 1.0 / 3)));
+		Expression result = run("(map - (map / (list 1 2 4)))");
+		Expression comp(Atom("list"));
+		comp.append(-1);
+		comp.append(-0.5);
+		comp.append(-0.25);
+		REQUIRE(result == comp);
+	}
+	SECTION("chains of lambdas") {
+		std::string input = "(begin (define f (lambda (x) (* 2 x))) (define g (lambda (x) (+ x 1))) "
+			"(apply + (map f (map g (map - (list 1 2 3))))))";
+		REQUIRE(run(input) == Expression(-6.));
+	}
+	SECTION("apply of a lambda over a map") {
+		std::string input = "(begin (define f (lambda (x y) (- x y))) (apply f (map - (list 1 2))))";
+		REQUIRE(run(input) == Expression(1.));
+	}
+	SECTION("errors match the unfused evaluation order") {
+		// imag fails on the second element before ln fails on the first
+		std::string input = "(map ln (map imag (list (- I I) 3)))";
+		std::istringstream iss(input);
+		Interpreter interp;
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_THROWS_WITH(interp.evaluate(), "Error in call to imag: invalid argument.");
+
+		std::string input2 = "(apply + (map imag (list I 3)))";
+		std::istringstream iss2(input2);
+		REQUIRE(interp.parseStream(iss2));
+		REQUIRE_THROWS_WITH(interp.evaluate(), "Error in call to imag: invalid argument.");
+	}
+	SECTION("a chunk of apply failing before a later map stage") {
+		// + fails on the first chunk, first fails on the last element
+		std::string elements = "(list \"a\")";
+		for (int i = 0; i < 5000; ++i) {
+			elements += " (list 1)";
+		}
+		Interpreter interp;
+		std::istringstream iss("(apply + (map first (list " + elements + " (list))))");
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_THROWS_WITH(interp.evaluate(), "Error: argument to first is an empty list");
+
+		std::istringstream iss2("(apply + (map first (list " + elements + ")))");
+		REQUIRE(interp.parseStream(iss2));
+		REQUIRE_THROWS_WITH(interp.evaluate(), "Error in call to add, argument not a number");
+	}
+}
+
+TEST_CASE("parallel map", "[interpreter]") {
+	std::size_t threshold = ThreadPool::threshold();
+	ThreadPool::configure(4, 16);
+
+	SECTION("results keep the input order") {
+		Expression result = run("(begin (define f (lambda (x) (* x x))) (map f (range 0 999 1)))");
+		REQUIRE(result.tailSize() == 1000);
+		double i = 0;
+		for (auto e = result.tailConstBegin(); e != result.tailConstEnd(); ++e, ++i) {
+			REQUIRE(*e == Expression(i * i));
+		}
+		REQUIRE(run("(apply + (map - (range 1 100 1)))") == Expression(-5050.));
+	}
+	SECTION("lambdas with local defines and nested calls") {
+		std::string input = "(begin (define g (lambda (x) (+ x 1))) "
+			"(define f (lambda (x) (begin (define y (g x)) (* 2 y)))) (apply + (map f (range 0 99 1))))";
+		REQUIRE(run(input) == Expression(10100.));
+	}
+	SECTION("the first error in input order is reported") {
+		std::string input = "(map ln (append (join (list 1 I) (range 1 200 1)) -1))";
+		std::istringstream iss(input);
+		Interpreter interp;
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_THROWS_WITH(interp.evaluate(), "Error in call to ln: invalid argument.");
+	}
+	SECTION("lists built on the pool are appended to safely after the arena is reset") {
+		Interpreter interp;
+		std::vector<std::string> program = {
+			"(define base (list 1))",
+			"(define f (lambda (x) (append base x)))",
+			"(define l (map f (range 0 99 1)))",
+			"(begin (append (first l) (list 1 2)) 0)",
+			"(begin (define g (lambda (x) (list x x))) (define junk (map g (list 1 2 3 4 5 6 7 8))) 0)",
+			"(append (first l) (list 3 4))",
+		};
+		Expression result;
+		for (auto & line : program) {
+			std::istringstream iss(line);
+			REQUIRE(interp.parseStream(iss));
+			REQUIRE_NOTHROW(result = interp.evaluate());
+		}
+		REQUIRE(result == run("(list 1 0 (list 3 4))"));
+	}
+
+	ThreadPool::configure(0, threshold);
+}
+
+TEST_CASE("shared lists", "[interpreter]") {
+	SECTION("append and join leave their arguments unchanged") {
+		std::string program = "(begin (define a (list 1 2 3)) (define b (append a 4)) "
+			"(define c (append a 5)) (define d (join b c)) (list a b c d))";
+		Expression result = run(program);
+		REQUIRE(result == run("(list (list 1 2 3) (list 1 2 3 4) (list 1 2 3 5) (list 1 2 3 4 1 2 3 5))"));
+	}
+	SECTION("rest shares the list") {
+		REQUIRE(run("(begin (define a (list 1 2 3)) (define b (rest a)) (append b 4))") == run("(list 2 3 4)"));
+		REQUIRE(run("(begin (define a (list 1 2 3)) (define b (rest a)) (append b 4) a)") == run("(list 1 2 3)"));
+	}
+	SECTION("append does not keep properties of the list") {
+		REQUIRE(run("(append (set-property \"note\" 1 (list 1)) 2)") == run("(list 1 2)"));
+	}
+	SECTION("repeated append builds a long list") {
+		std::string program = "(begin (define l (list)) "
+			"(define f (lambda (x) (append x (length x)))) "
+			"(f (f (f (f (f l))))))";
+		REQUIRE(run(program) == run("(list 0 1 2 3 4)"));
+	}
+}
+
+TEST_CASE("values outlive the evaluation arena", "[interpreter]") {
+	Interpreter interp;
+	std::vector<std::string> programs = {
+		"(begin (define f (lambda (x) (list x (list x 1)))) (define a (map f (list 1 2 3))))",
+		"(define b (append a (f 4)))",
+		"(begin (define c (set-property \"note\" (f 5) (list 6))) (first (rest b)))",
+		"(list b (get-property \"note\" c))",
+	};
+	Expression result;
+	for (auto & program : programs) {
+		std::istringstream iss(program);
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_NOTHROW(result = interp.evaluate());
+		// evaluating the same AST again reuses the reset arena
+		REQUIRE(interp.evaluate() == result);
+	}
+	REQUIRE(result == run("(list (list (list 1 (list 1 1)) (list 2 (list 2 1)) (list 3 (list 3 1)) (list 4 (list 4 1))) (list 5 (list 5 1)))"));
+
+	std::istringstream iss("(begin (define d (list 7 8)) (first 1))");
+	REQUIRE(interp.parseStream(iss));
+	REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+	std::istringstream iss2("(rest d)");
+	REQUIRE(interp.parseStream(iss2));
+	REQUIRE(interp.evaluate() == run("(list 8)"));
+}
+
+TEST_CASE("memoized lambdas", "[interpreter]") {
+	SECTION("repeated calls are answered from the cache") {
+		std::string program = "(begin (define f (lambda (x) (* x x))) (memoize f) "
+			"(define r (list (f 2) (f (+ 1 1)) (f 3))) (list r (memo-stats)))";
+		REQUIRE(run(program) == run("(list (list 4 4 9) (list 1 2 2 0))"));
+	}
+	SECTION("a memoized lambda value can be defined") {
+		REQUIRE(run("(begin (define f (memoize (lambda (x y) (list x y)))) (f 1 3) (f 1 3))") == run("(list 1 3)"));
+		REQUIRE(run("(begin (define f (memoize (lambda (x y) (list x y)))) (f 1 3) (f 1 3) (memo-stats))") == run("(list 1 1 1 0)"));
+	}
+	SECTION("arguments keep their properties") {
+		REQUIRE(run("(begin (define f (memoize (lambda (p) p))) "
+			"(define r (f (set-property \"size\" 2 (list 1 2)))) (get-property \"size\" r))") == Expression(2.));
+		REQUIRE(run("(begin (define f (memoize (lambda (x y) (list x y)))) (f 1 (+ 1 2)) (f 1 3) (memo-stats))") == run("(list 1 1 1 0)"));
+	}
+	SECTION("cached lists outlive the evaluation arena") {
+		Interpreter interp;
+		std::vector<std::string> programs = {
+			"(begin (define f (lambda (x) (list x (list x 1)))) (memoize f) (f 1))",
+			"(f 1)",
+			"(list (f 1) (memo-stats))",
+		};
+		Expression result;
+		for (auto & program : programs) {
+			std::istringstream iss(program);
+			REQUIRE(interp.parseStream(iss));
+			REQUIRE_NOTHROW(result = interp.evaluate());
+		}
+		REQUIRE(result == run("(list (list 1 (list 1 1)) (list 2 1 1 0))"));
+	}
+	SECTION("errors") {
+		std::vector<std::string> input = { "(memoize 1)", "(memoize + 1)", "(memo-stats 1)",
+			"(begin (define f (memoize (lambda (x) (ln x)))) (f -1))" };
+		for (auto a : input) {
+			std::istringstream iss(a);
+			Interpreter interp;
+			REQUIRE(interp.parseStream(iss));
+			REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+		}
+	}
+	SECTION("continuous plot of a memoized function") {
+		std::string plain = "(begin (define f (lambda(x) (/ 1 (+ 1 (^ e (- (* 20 x))))))) (continuous-plot f (list -1 1)))";
+		std::string memoized = "(begin (define f (memoize (lambda(x) (/ 1 (+ 1 (^ e (- (* 20 x)))))))) (continuous-plot f (list -1 1)))";
+		REQUIRE(runplot(memoized) == runplot(plain));
+	}
+}
+
+TEST_CASE("constant folding keeps evaluation results", "[interpreter]") {
+	REQUIRE(run("(begin (define f (lambda (x) (* x (/ (* 2 pi) 360)))) (f 180))") == Expression(std::atan2(0, -1)));
+	REQUIRE(run("(begin (define pi 3) (* 2 pi))") == Expression(6.));
+
+	std::vector<std::string> input = { "(ln -1)", "(begin (define f (lambda (x) (+ x (sqrt 1 2)))) (f 1))" };
+	for (auto a : input) {
+		std::istringstream iss(a);
+		Interpreter interp;
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+	}
+}
+
+TEST_CASE("batched lambda evaluation", "[interpreter]") {
+	SECTION("map gives the values of calling the lambda on each element") {
+		std::string define = "(begin (define g (lambda (u) (* u u))) (define f (lambda (x) (+ (sqrt x) (g x)))) ";
+		Expression mapped = run(define + "(map f (list 4 -1 I 0)))");
+		Expression called = run(define + "(list (f 4) (f -1) (f I) (f 0)))");
+		REQUIRE(mapped == called);
+		REQUIRE(mapped.tailSize() == 4);
+		REQUIRE((mapped.tailConstBegin() + 1)->isHeadComplex());
+	}
+	SECTION("batches of a long list keep the input order") {
+		Expression result = run("(begin (define f (lambda (x) (- (* x x) 1))) (map f (range 0 9999 1)))");
+		REQUIRE(result.tailSize() == 10000);
+		double i = 0;
+		for (auto e = result.tailConstBegin(); e != result.tailConstEnd(); ++e, ++i) {
+			REQUIRE(*e == Expression(i * i - 1));
+		}
+	}
+	SECTION("errors match the unfused evaluation order") {
+		// g fails on the second element before f fails on the first
+		std::string input = "(begin (define f (lambda (x) (ln (sqrt x)))) (define g (lambda (x) (ln (+ x 2)))) "
+			"(map f (map g (list -1.5 -2))))";
+		std::istringstream iss(input);
+		Interpreter interp;
+		REQUIRE(interp.parseStream(iss));
+		REQUIRE_THROWS_WITH(interp.evaluate(), "Error in call to ln: negative number.");
+	}
+}
+
+TEST_CASE( "Test Interpreter evaluates a program one expression at a time", "[interpreter]" ) {
+
+  std::istringstream iss("(define a 2)\n(define b (* a 3))\n(+ a b) (undefined-procedure 1) (+ 1");
+  Reader reader(iss);
+  Interpreter interp;
+
+  REQUIRE(interp.parseNext(reader));
+  REQUIRE(interp.evaluate() == Expression(2.));
+  REQUIRE(interp.parseNext(reader));
+  REQUIRE(interp.evaluate() == Expression(6.));
+  REQUIRE(interp.parseNext(reader));
+  REQUIRE(interp.evaluate() == Expression(8.));
+  REQUIRE(interp.parseNext(reader));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+  REQUIRE_FALSE(interp.parseNext(reader));
+  REQUIRE(reader.failed());
+}
+
+TEST_CASE( "Test Interpreter evaluates a program read on another thread", "[interpreter]" ) {
+
+  std::istringstream iss("(define a 2)\n(define b (* a 3))\n(+ a b)");
+  PipelinedReader reader(iss);
+  Interpreter interp;
+
+  Expression result;
+  while(interp.parseNext(reader)){
+    result = interp.evaluate();
+  }
+  REQUIRE(result == Expression(8.));
+  REQUIRE_FALSE(reader.failed());
+}
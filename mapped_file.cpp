@@ -0,0 +1,52 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#define MAPPED_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string & path): m_data(nullptr), m_size(0), m_open(false){
+
+#ifdef MAPPED_FILE_MMAP
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) return;
+
+  struct stat status;
+  if((::fstat(fd, &status) == 0) && S_ISREG(status.st_mode)){
+    m_open = true;
+    m_size = static_cast<std::size_t>(status.st_size);
+    if(m_size > 0){
+      void * p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(p == MAP_FAILED){
+        m_open = false;
+        m_size = 0;
+      }
+      else{
+        m_data = static_cast<const char *>(p);
+      }
+    }
+  }
+  ::close(fd);
+#else
+  std::ifstream ifs(path, std::ios::binary);
+  if(!ifs) return;
+  m_buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  m_open = true;
+  m_size = m_buffer.size();
+  m_data = m_size ? m_buffer.data() : nullptr;
+#endif
+}
+
+MappedFile::~MappedFile(){
+#ifdef MAPPED_FILE_MMAP
+  if(m_data){
+    ::munmap(const_cast<char *>(m_data), m_size);
+  }
+#endif
+}
@@ -0,0 +1,58 @@
+/*! \file mapped_file.hpp
+Defines the MappedFile giving read-only access to the bytes of a file.
+ */
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+
+/*! \class MappedFile
+\brief The contents of a file, mapped into memory where the platform
+supports it and read into a buffer otherwise.
+*/
+class MappedFile {
+public:
+
+  /// map the file at path, see isOpen
+  explicit MappedFile(const std::string & path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  /// true if the file could be opened
+  bool isOpen() const noexcept { return m_open; }
+
+  /// the first byte of the file, nullptr if it is empty or not open
+  const char * data() const noexcept { return m_data; }
+
+  /// the size of the file in bytes
+  std::size_t size() const noexcept { return m_size; }
+
+private:
+  const char * m_data;
+  std::size_t m_size;
+  bool m_open;
+
+  // the contents when the file is not mapped
+  std::string m_buffer;
+};
+
+/*! \class MemoryBuffer
+\brief A read-only stream buffer over bytes held elsewhere, so an
+std::istream can read them without a copy.
+*/
+class MemoryBuffer : public std::streambuf {
+public:
+
+  /// read the size bytes at data, which must outlive the buffer
+  MemoryBuffer(const char * data, std::size_t size){
+    char * begin = const_cast<char *>(data);
+    setg(begin, begin, begin + size);
+  }
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "memo_cache.hpp"
+
+#include <cstdlib>
+#include <iterator>
+
+// default number of cached results
+const std::size_t DEFAULT_MEMO_CAPACITY = 4096;
+
+MemoCache::MemoCache(std::size_t capacity):
+  m_capacity(capacity), m_hits(0), m_misses(0), m_evictions(0), m_next_id(1){}
+
+std::size_t MemoCache::newId() noexcept{
+  return m_next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::size_t MemoCache::hash(std::size_t id, const std::vector<Expression> & args) noexcept{
+  std::size_t seed = id;
+  for(auto & a : args){
+    seed = (seed * 1000003) ^ a.hash();
+  }
+  return seed;
+}
+
+bool MemoCache::matches(const Entry & entry, std::size_t id, const std::vector<Expression> & args) noexcept{
+  if((entry.id != id) || (entry.args.size() != args.size())) return false;
+  for(std::size_t i = 0; i < args.size(); ++i){
+    if(!entry.args[i].identical(args[i])) return false;
+  }
+  return true;
+}
+
+bool MemoCache::find(std::size_t id, const std::vector<Expression> & args, Expression & result){
+  std::size_t h = hash(id, args);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto range = m_index.equal_range(h);
+  for(auto it = range.first; it != range.second; ++it){
+    if(matches(*it->second, id, args)){
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      result = it->second->result;
+      ++m_hits;
+      return true;
+    }
+  }
+  ++m_misses;
+  return false;
+}
+
+void MemoCache::insert(std::size_t id, const std::vector<Expression> & args, const Expression & result){
+  if(m_capacity == 0) return;
+
+  // copy outside the lock, the copies share nothing with the caller
+  Entry entry;
+  entry.hash = hash(id, args);
+  entry.id = id;
+  entry.args.reserve(args.size());
+  for(auto & a : args){
+    entry.args.push_back(a.heapCopy());
+  }
+  entry.result = result.heapCopy();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // another thread may have computed the same call
+  auto range = m_index.equal_range(entry.hash);
+  for(auto it = range.first; it != range.second; ++it){
+    if(matches(*it->second, id, args)) return;
+  }
+
+  if(m_entries.size() >= m_capacity){
+    const Entry & oldest = m_entries.back();
+    auto old = m_index.equal_range(oldest.hash);
+    for(auto it = old.first; it != old.second; ++it){
+      if(it->second == std::prev(m_entries.end())){
+        m_index.erase(it);
+        break;
+      }
+    }
+    m_entries.pop_back();
+    ++m_evictions;
+  }
+
+  m_entries.push_front(std::move(entry));
+  m_index.emplace(m_entries.front().hash, m_entries.begin());
+}
+
+MemoCache::Stats MemoCache::stats() const{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats s;
+  s.hits = m_hits;
+  s.misses = m_misses;
+  s.entries = m_entries.size();
+  s.evictions = m_evictions;
+  return s;
+}
+
+void MemoCache::clear(){
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_index.clear();
+  m_entries.clear();
+  m_hits = 0;
+  m_misses = 0;
+  m_evictions = 0;
+}
+
+std::size_t MemoCache::defaultCapacity(){
+  const char * value = std::getenv("PLOTSCRIPT_MEMO");
+  if(value != nullptr){
+    char * end = nullptr;
+    long results = std::strtol(value, &end, 10);
+    if((end != value) && (results >= 0)){
+      return static_cast<std::size_t>(results);
+    }
+  }
+  return DEFAULT_MEMO_CAPACITY;
+}
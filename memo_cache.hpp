@@ -0,0 +1,99 @@
+/*! \file memo_cache.hpp
+Defines the MemoCache holding results of memoized lambda calls.
+ */
+#ifndef MEMO_CACHE_HPP
+#define MEMO_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.hpp"
+
+/*! \class MemoCache
+\brief A bounded least recently used cache of lambda results.
+
+Each memoized lambda is given an id by newId, and its results are cached
+under that id and the values of the arguments it was called with. When
+the cache is full the least recently used result is dropped. Arguments
+match only if they are identical, numbers within the tolerance of
+operator== are different keys. Cached
+expressions are copied to the heap, so they outlive the Arena of the
+evaluation that computed them. All members are safe to call from
+several threads.
+*/
+class MemoCache {
+public:
+
+  /// hit and miss counts since construction or the last clear
+  struct Stats {
+    std::size_t hits;      ///< calls answered from the cache
+    std::size_t misses;    ///< calls that had to be evaluated
+    std::size_t entries;   ///< results currently cached
+    std::size_t evictions; ///< results dropped to stay within capacity
+  };
+
+  /// Construct a cache holding at most capacity results, 0 disables it
+  explicit MemoCache(std::size_t capacity);
+
+  MemoCache(const MemoCache &) = delete;
+  MemoCache & operator=(const MemoCache &) = delete;
+
+  /// a new id for a memoized lambda, never 0
+  std::size_t newId() noexcept;
+
+  /*! Look up the result of lambda id called with args.
+    \return true and set result on a hit, false on a miss
+   */
+  bool find(std::size_t id, const std::vector<Expression> & args, Expression & result);
+
+  /// cache result as the value of lambda id called with args
+  void insert(std::size_t id, const std::vector<Expression> & args, const Expression & result);
+
+  /// current statistics
+  Stats stats() const;
+
+  /// drop all results and reset the statistics
+  void clear();
+
+  /// maximum number of results
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+  /*! Default capacity, from the PLOTSCRIPT_MEMO environment variable in
+    results if it is set, 0 disables memoization.
+   */
+  static std::size_t defaultCapacity();
+
+private:
+
+  struct Entry {
+    std::size_t hash;
+    std::size_t id;
+    std::vector<Expression> args;
+    Expression result;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+  // entries, most recently used first
+  EntryList m_entries;
+
+  // entries by hash of id and args
+  std::unordered_multimap<std::size_t, EntryList::iterator> m_index;
+
+  std::size_t m_capacity;
+  std::size_t m_hits;
+  std::size_t m_misses;
+  std::size_t m_evictions;
+  std::atomic<std::size_t> m_next_id;
+
+  mutable std::mutex m_mutex;
+
+  static std::size_t hash(std::size_t id, const std::vector<Expression> & args) noexcept;
+  static bool matches(const Entry & entry, std::size_t id, const std::vector<Expression> & args) noexcept;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "catch.hpp"
+
+#include "memo_cache.hpp"
+
+#include <vector>
+
+TEST_CASE( "Test MemoCache hits and misses", "[memo_cache]" ) {
+
+  MemoCache cache(16);
+  std::size_t f = cache.newId();
+  std::size_t g = cache.newId();
+  REQUIRE(f != 0);
+  REQUIRE(f != g);
+
+  std::vector<Expression> args = {Expression(1.0), Expression(Atom("\"a\""))};
+  Expression result;
+  REQUIRE(!cache.find(f, args, result));
+
+  cache.insert(f, args, Expression(2.0));
+  REQUIRE(cache.find(f, args, result));
+  REQUIRE(result == Expression(2.0));
+
+  // keyed by the lambda as well as the argument values
+  REQUIRE(!cache.find(g, args, result));
+  std::vector<Expression> other = {Expression(1.0), Expression(Atom("\"b\""))};
+  REQUIRE(!cache.find(f, other, result));
+
+  MemoCache::Stats stats = cache.stats();
+  REQUIRE(stats.hits == 1);
+  REQUIRE(stats.misses == 3);
+  REQUIRE(stats.entries == 1);
+  REQUIRE(stats.evictions == 0);
+
+  cache.clear();
+  REQUIRE(!cache.find(f, args, result));
+  REQUIRE(cache.stats().entries == 0);
+}
+
+TEST_CASE( "Test MemoCache keys small numbers exactly", "[memo_cache]" ) {
+
+  MemoCache cache(4096);
+  std::size_t f = cache.newId();
+
+  // plot abscissas in [-2, 2], each its own key
+  for(int i = 0; i < 4000; ++i){
+    cache.insert(f, {Expression(-2.0 + i * 0.001)}, Expression(static_cast<double>(i)));
+  }
+  Expression result;
+  for(int i = 0; i < 4000; ++i){
+    REQUIRE(cache.find(f, {Expression(-2.0 + i * 0.001)}, result));
+    REQUIRE(result == Expression(static_cast<double>(i)));
+  }
+
+  // equal within the tolerance is not enough
+  cache.insert(f, {Expression(0.5)}, Expression(1.0));
+  REQUIRE(!cache.find(f, {Expression(0.5 + 1e-16)}, result));
+}
+
+TEST_CASE( "Test MemoCache evicts the least recently used result", "[memo_cache]" ) {
+
+  MemoCache cache(2);
+  std::size_t f = cache.newId();
+
+  std::vector<Expression> one = {Expression(1.0)};
+  std::vector<Expression> two = {Expression(2.0)};
+  std::vector<Expression> three = {Expression(3.0)};
+  Expression result;
+
+  cache.insert(f, one, Expression(10.0));
+  cache.insert(f, two, Expression(20.0));
+  REQUIRE(cache.find(f, one, result));
+  cache.insert(f, three, Expression(30.0));
+
+  REQUIRE(cache.find(f, one, result));
+  REQUIRE(result == Expression(10.0));
+  REQUIRE(!cache.find(f, two, result));
+  REQUIRE(cache.find(f, three, result));
+  REQUIRE(cache.stats().entries == 2);
+  REQUIRE(cache.stats().evictions == 1);
+}
+
+TEST_CASE( "Test disabled MemoCache", "[memo_cache]" ) {
+
+  MemoCache cache(0);
+  std::size_t f = cache.newId();
+  std::vector<Expression> args = {Expression(1.0)};
+  Expression result;
+
+  cache.insert(f, args, Expression(2.0));
+  REQUIRE(!cache.find(f, args, result));
+  REQUIRE(cache.stats().entries == 0);
+}
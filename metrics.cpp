@@ -0,0 +1,176 @@
+#include "metrics.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#include "replace_file.hpp"
+
+// definitions of the constants, which are bound to references
+const int Histogram::SUB_BITS;
+const std::size_t Histogram::BUCKETS;
+
+const std::uint64_t SUB_BUCKETS = std::uint64_t(1) << Histogram::SUB_BITS;
+
+// percentiles shown and exported
+const double QUANTILES[] = {0.5, 0.99, 0.999};
+
+Histogram::Histogram() noexcept{
+  clear();
+}
+
+void Histogram::record(std::int64_t nanoseconds) noexcept{
+  if(nanoseconds < 0) nanoseconds = 0;
+
+  m_buckets[bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(static_cast<std::uint64_t>(nanoseconds), std::memory_order_relaxed);
+
+  std::int64_t largest = m_max.load(std::memory_order_relaxed);
+  while((nanoseconds > largest) &&
+        !m_max.compare_exchange_weak(largest, nanoseconds, std::memory_order_relaxed)){}
+}
+
+std::int64_t Histogram::percentile(double p) const noexcept{
+
+  // counts are read once, so a concurrent record cannot push the rank past the total
+  std::uint64_t counts[BUCKETS];
+  std::uint64_t total = 0;
+  for(std::size_t i = 0; i < BUCKETS; ++i){
+    counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if(total == 0) return 0;
+
+  if(p < 0) p = 0;
+  if(p > 1) p = 1;
+  std::uint64_t rank = static_cast<std::uint64_t>(p * total + 0.5);
+  if(rank == 0) rank = 1;
+
+  std::uint64_t seen = 0;
+  for(std::size_t i = 0; i < BUCKETS; ++i){
+    seen += counts[i];
+    if(seen >= rank){
+      std::int64_t largest = max();
+      std::int64_t bound = upperBound(i);
+      return ((largest > 0) && (bound > largest)) ? largest : bound;
+    }
+  }
+  return max();
+}
+
+void Histogram::clear() noexcept{
+  for(std::size_t i = 0; i < BUCKETS; ++i){
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  }
+  m_count.store(0, std::memory_order_relaxed);
+  m_sum.store(0, std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+std::size_t Histogram::bucket(std::int64_t value) noexcept{
+  std::uint64_t v = (value < 0) ? 0 : static_cast<std::uint64_t>(value);
+  if(v < SUB_BUCKETS) return static_cast<std::size_t>(v);
+
+  // position of the highest bit set
+  int magnitude = SUB_BITS;
+  while((v >> (magnitude + 1)) != 0) ++magnitude;
+
+  std::uint64_t group = magnitude - SUB_BITS + 1;
+  return static_cast<std::size_t>((group << SUB_BITS) + (v >> (magnitude - SUB_BITS)) - SUB_BUCKETS);
+}
+
+std::int64_t Histogram::upperBound(std::size_t i) noexcept{
+  if(i < SUB_BUCKETS) return static_cast<std::int64_t>(i);
+
+  std::uint64_t group = i >> SUB_BITS;
+  std::uint64_t sub = i & (SUB_BUCKETS - 1);
+  std::uint64_t width = std::uint64_t(1) << (group - 1);
+  return static_cast<std::int64_t>(((SUB_BUCKETS + sub) << (group - 1)) + width - 1);
+}
+
+static Histogram stages[Metrics::STAGE_COUNT];
+
+Histogram & Metrics::histogram(Stage stage) noexcept{
+  return stages[stage];
+}
+
+void Metrics::record(Stage stage, std::chrono::steady_clock::duration duration) noexcept{
+  stages[stage].record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+const char * Metrics::name(Stage stage) noexcept{
+  switch(stage){
+  case QUEUE_WAIT: return "queue_wait";
+  case PARSE: return "parse";
+  case EVAL: return "eval";
+  case OUTPUT_HANDOFF: return "output_handoff";
+  case RENDER: return "render";
+  default: return "";
+  }
+}
+
+void Metrics::report(std::ostream & out){
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+
+  out << std::left << std::setw(16) << "stage" << std::right << std::setw(10) << "count"
+      << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms"
+      << std::setw(12) << "p99.9 ms" << std::setw(12) << "max ms" << "\n";
+  out << std::fixed << std::setprecision(3);
+  for(int i = 0; i < STAGE_COUNT; ++i){
+    const Histogram & h = stages[i];
+    out << std::left << std::setw(16) << name(static_cast<Stage>(i)) << std::right
+        << std::setw(10) << h.count();
+    for(double q : QUANTILES){
+      out << std::setw(12) << h.percentile(q) / 1e6;
+    }
+    out << std::setw(12) << h.max() / 1e6 << "\n";
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void Metrics::writePrometheus(std::ostream & out){
+  std::streamsize precision = out.precision();
+  out << std::setprecision(9);
+
+  out << "# HELP plotscript_request_stage_seconds Latency of each stage of a kernel request.\n";
+  out << "# TYPE plotscript_request_stage_seconds summary\n";
+  for(int i = 0; i < STAGE_COUNT; ++i){
+    const Histogram & h = stages[i];
+    std::string stage = name(static_cast<Stage>(i));
+    for(double q : QUANTILES){
+      out << "plotscript_request_stage_seconds{stage=\"" << stage << "\",quantile=\"" << q << "\"} "
+          << h.percentile(q) / 1e9 << "\n";
+    }
+    out << "plotscript_request_stage_seconds_sum{stage=\"" << stage << "\"} " << h.sum() / 1e9 << "\n";
+    out << "plotscript_request_stage_seconds_count{stage=\"" << stage << "\"} " << h.count() << "\n";
+  }
+
+  out.precision(precision);
+}
+
+bool Metrics::writePrometheus(const std::string & path){
+  std::string temporary = temporaryPath(path);
+  {
+    std::ofstream ofs(temporary);
+    if(!ofs) return false;
+    writePrometheus(ofs);
+    if(!ofs){
+      ofs.close();
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  if(replaceFile(temporary, path)) return true;
+  std::remove(temporary.c_str());
+  return false;
+}
+
+void Metrics::clear() noexcept{
+  for(auto & h : stages){
+    h.clear();
+  }
+}
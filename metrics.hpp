@@ -0,0 +1,128 @@
+/*! \file metrics.hpp
+Defines the latency Histogram and the Metrics of the stages of a kernel request.
+ */
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*! \class Histogram
+\brief A lock-free histogram of durations in nanoseconds with bounded
+relative error, in the style of an HDR histogram.
+
+Values below 2^SUB_BITS are counted exactly. Larger values are counted in
+2^SUB_BITS linear buckets per power of two, so a percentile is reported
+within 1/2^SUB_BITS of the recorded value. Any number of threads can
+record and read at the same time; a read during a record may miss it.
+*/
+class Histogram {
+public:
+
+  /// bits of precision of a bucket
+  static const int SUB_BITS = 5;
+
+  /// number of buckets, enough for any non-negative std::int64_t
+  static const std::size_t BUCKETS = (64 - SUB_BITS) << SUB_BITS;
+
+  Histogram() noexcept;
+  Histogram(const Histogram &) = delete;
+  Histogram & operator=(const Histogram &) = delete;
+
+  /// count a duration of nanoseconds, negative durations count as 0
+  void record(std::int64_t nanoseconds) noexcept;
+
+  /// number of durations counted
+  std::uint64_t count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+
+  /// total of the durations counted in nanoseconds
+  std::uint64_t sum() const noexcept { return m_sum.load(std::memory_order_relaxed); }
+
+  /// largest duration counted
+  std::int64_t max() const noexcept { return m_max.load(std::memory_order_relaxed); }
+
+  /*! The duration below or at which fraction p of the counted durations
+    fall, as the largest value of its bucket, or 0 if none were counted.
+   */
+  std::int64_t percentile(double p) const noexcept;
+
+  /// forget everything counted, only while no thread is recording
+  void clear() noexcept;
+
+  /// the bucket a value is counted in
+  static std::size_t bucket(std::int64_t value) noexcept;
+
+  /// the largest value counted in bucket i
+  static std::int64_t upperBound(std::size_t i) noexcept;
+
+private:
+  std::atomic<std::uint64_t> m_buckets[BUCKETS];
+  std::atomic<std::uint64_t> m_count;
+  std::atomic<std::uint64_t> m_sum;
+  std::atomic<std::int64_t> m_max;
+};
+
+/*! \class Metrics
+\brief Process-wide latency histograms of the stages of a kernel request.
+
+The kernels of the REPL and the notebook record how long each request
+waits in the input queue, is parsed, is evaluated, waits for its output
+to be picked up and is printed or rendered. The histograms can be shown as
+a table of percentiles or written in the Prometheus text format.
+*/
+class Metrics {
+public:
+
+  /// a stage of a request
+  enum Stage { QUEUE_WAIT, PARSE, EVAL, OUTPUT_HANDOFF, RENDER, STAGE_COUNT };
+
+  /// the histogram of stage
+  static Histogram & histogram(Stage stage) noexcept;
+
+  /// count a duration of stage
+  static void record(Stage stage, std::chrono::steady_clock::duration duration) noexcept;
+
+  /// the name of stage, used as its Prometheus label
+  static const char * name(Stage stage) noexcept;
+
+  /// write a table of count, p50, p99, p99.9 and max of every stage in milliseconds
+  static void report(std::ostream & out);
+
+  /// write every stage as a Prometheus summary in seconds
+  static void writePrometheus(std::ostream & out);
+
+  /*! Write the Prometheus text to a temporary file renamed to path, so a
+    scraper never reads a partial file.
+    \return true on success
+   */
+  static bool writePrometheus(const std::string & path);
+
+  /// forget everything recorded
+  static void clear() noexcept;
+};
+
+/*! \class StageTimer
+\brief Records its lifetime as a duration of a Metrics stage.
+*/
+class StageTimer {
+public:
+
+  explicit StageTimer(Metrics::Stage stage) noexcept:
+    m_stage(stage), m_start(std::chrono::steady_clock::now()) {}
+
+  ~StageTimer(){
+    Metrics::record(m_stage, std::chrono::steady_clock::now() - m_start);
+  }
+
+  StageTimer(const StageTimer &) = delete;
+  StageTimer & operator=(const StageTimer &) = delete;
+
+private:
+  Metrics::Stage m_stage;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.hpp"
+
+TEST_CASE( "Test histogram buckets", "[metrics]" ) {
+
+  // small values are exact
+  for(std::int64_t v = 0; v < 32; ++v){
+    REQUIRE(Histogram::bucket(v) == static_cast<std::size_t>(v));
+    REQUIRE(Histogram::upperBound(Histogram::bucket(v)) == v);
+  }
+
+  // larger values are within 1/32 of their bucket's upper bound
+  std::int64_t values[] = {32, 63, 64, 65, 1000, 123456, 999999999, std::int64_t(1) << 40,
+                           std::numeric_limits<std::int64_t>::max()};
+  for(std::int64_t v : values){
+    std::size_t b = Histogram::bucket(v);
+    REQUIRE(b < Histogram::BUCKETS);
+    std::int64_t bound = Histogram::upperBound(b);
+    REQUIRE(bound >= v);
+    REQUIRE(bound - v <= v / 32);
+    REQUIRE(Histogram::bucket(bound) == b);
+  }
+
+  // buckets are ordered
+  for(std::size_t i = 1; i < Histogram::BUCKETS; ++i){
+    REQUIRE(Histogram::upperBound(i) > Histogram::upperBound(i - 1));
+  }
+}
+
+TEST_CASE( "Test histogram percentiles", "[metrics]" ) {
+
+  Histogram h;
+  REQUIRE(h.count() == 0);
+  REQUIRE(h.percentile(0.5) == 0);
+
+  for(std::int64_t v = 1; v <= 1000; ++v){
+    h.record(v * 1000);
+  }
+  REQUIRE(h.count() == 1000);
+  REQUIRE(h.sum() == 500500000);
+  REQUIRE(h.max() == 1000000);
+
+  REQUIRE(h.percentile(0.5) >= 500000);
+  REQUIRE(h.percentile(0.5) <= 500000 * 33 / 32);
+  REQUIRE(h.percentile(0.99) >= 990000);
+  REQUIRE(h.percentile(0.99) <= 990000 * 33 / 32);
+  REQUIRE(h.percentile(1) == 1000000);
+
+  h.record(-5);
+  REQUIRE(h.percentile(0) == 0);
+
+  h.clear();
+  REQUIRE(h.count() == 0);
+  REQUIRE(h.max() == 0);
+}
+
+TEST_CASE( "Test histogram records from several threads", "[metrics]" ) {
+
+  Histogram h;
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; ++t){
+    threads.emplace_back([&h, t](){
+        for(int i = 0; i < 10000; ++i){
+          h.record(t * 10000 + i);
+        }
+      });
+  }
+  for(auto & t : threads){
+    t.join();
+  }
+
+  REQUIRE(h.count() == 40000);
+  REQUIRE(h.max() == 39999);
+  REQUIRE(h.percentile(0.5) >= 20000);
+  REQUIRE(h.percentile(0.5) <= 20000 * 33 / 32);
+}
+
+TEST_CASE( "Test metrics report and Prometheus text", "[metrics]" ) {
+
+  Metrics::clear();
+  {
+    StageTimer timer(Metrics::EVAL);
+  }
+  Metrics::record(Metrics::PARSE, std::chrono::milliseconds(2));
+  REQUIRE(Metrics::histogram(Metrics::EVAL).count() == 1);
+  REQUIRE(Metrics::histogram(Metrics::PARSE).count() == 1);
+  REQUIRE(Metrics::histogram(Metrics::RENDER).count() == 0);
+
+  std::ostringstream report;
+  Metrics::report(report);
+  REQUIRE(report.str().find("queue_wait") != std::string::npos);
+  REQUIRE(report.str().find("p99.9 ms") != std::string::npos);
+
+  std::ostringstream text;
+  Metrics::writePrometheus(text);
+  REQUIRE(text.str().find("# TYPE plotscript_request_stage_seconds summary") != std::string::npos);
+  REQUIRE(text.str().find("plotscript_request_stage_seconds_count{stage=\"parse\"} 1\n") != std::string::npos);
+  REQUIRE(text.str().find("plotscript_request_stage_seconds{stage=\"parse\",quantile=\"0.999\"} 0.002") != std::string::npos);
+  REQUIRE(text.str().find("plotscript_request_stage_seconds_sum{stage=\"render\"} 0\n") != std::string::npos);
+
+  std::string path = "metrics_tests.prom";
+  REQUIRE(Metrics::writePrometheus(path));
+  REQUIRE(Metrics::writePrometheus(path));
+  std::ifstream ifs(path);
+  std::stringstream written;
+  written << ifs.rdbuf();
+  REQUIRE(written.str() == text.str());
+  ifs.close();
+  std::remove(path.c_str());
+
+  Metrics::clear();
+  REQUIRE(Metrics::histogram(Metrics::PARSE).count() == 0);
+}
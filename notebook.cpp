@@ -1,16 +1,46 @@
 
 #include <QApplication>
 #include <QWidget>
+#include <fstream>
+#include <iostream>
 #include "notebook_app.hpp"
+#include "trace.hpp"
 
 int main(int argc, char *argv[])
 {
   QApplication app(argc, argv);
 
+  // --trace <file> records trace events and writes them to file on exit,
+  // --metrics <file> writes the request metrics to file after each output
+  std::string trace_file;
+  std::string metrics_file;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::string(argv[i]) == "--trace") {
+      trace_file = argv[i + 1];
+      Trace::enable(true);
+      Trace::nameThread("gui");
+    }
+    else if (std::string(argv[i]) == "--metrics") {
+      metrics_file = argv[i + 1];
+    }
+  }
+
 	NotebookApp widget;
 	widget.setObjectName("NotebookApp");
+  widget.setMetricsFile(metrics_file);
   widget.show();
 
-  return app.exec();
+  int status = app.exec();
+
+  if (!trace_file.empty()) {
+    std::ofstream ofs(trace_file);
+    if (!ofs) {
+      std::cerr << "Error: Could not open trace file for writing." << std::endl;
+    }
+    else {
+      Trace::writeChrome(ofs);
+    }
+  }
+  return status;
 }
 
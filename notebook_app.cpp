@@ -75,14 +75,21 @@ void NotebookApp::timerEvent(QTimerEvent *event)
 {
 	auto eval_output = output_comms.try_get_output();
 	if (!eval_output.first.empty() || !eval_output.second.head().isNone()) {
-		if (eval_output.first.empty()) {
-			emit sendClear();
-			parseExpression(eval_output.second);
+		{
+			TraceScope trace("render");
+			StageTimer timer(Metrics::RENDER);
+			if (eval_output.first.empty()) {
+				emit sendClear();
+				parseExpression(eval_output.second);
 
+			}
+			else {
+				emit sendClear();
+				emit sendExpression(eval_output.first);
+			}
 		}
-		else {
-			emit sendClear();
-			emit sendExpression(eval_output.first);
+		if (!metrics_file.empty() && !Metrics::writePrometheus(metrics_file)) {
+			std::cerr << "Error: Could not write metrics file." << std::endl;
 		}
 	}
 	else {
@@ -105,6 +112,11 @@ void NotebookApp::reset_thread() {
 	}
 }
 
+void NotebookApp::setMetricsFile(const std::string & file)
+{
+	metrics_file = file;
+}
+
 void NotebookApp::output_is_ready()
 {
 	auto output = output_comms.get_output();
@@ -121,7 +133,13 @@ void NotebookApp::output_is_ready()
 
 void NotebookApp::evaluate(std::string input)
 {
-	if (eval_thread.joinable()) {
+	if (input == "%metrics") {
+		std::ostringstream report;
+		Metrics::report(report);
+		emit sendClear();
+		emit sendExpression(report.str());
+	}
+	else if (eval_thread.joinable()) {
 		input_comms.store_input(input);
 	}
 	
@@ -157,6 +175,9 @@ void NotebookApp::loadStartupFile(Interpreter & interp)
 
 void NotebookApp::interpretation(Interpreter&interp)
 {
+	if (Trace::enabled()) {
+		Trace::nameThread("kernel");
+	}
 	//REPL
 	while (1) {
 		auto user_input = input_comms.get_input();
@@ -164,13 +185,22 @@ void NotebookApp::interpretation(Interpreter&interp)
 			break;
 		}
 
-		std::istringstream expression(user_input);
-		if (!interp.parseStream(expression)) {
+		TraceScope trace("request");
+		bool parsed;
+		{
+			StageTimer timer(Metrics::PARSE);
+			parsed = interp.parseString(user_input);
+		}
+		if (!parsed) {
 			output_comms.store_output(std::pair<std::string, Expression>("Error: Invalid Program. Could not parse.", Expression()));
 		}
 		else {
 			try {
-				Expression exp = interp.evaluate();
+				Expression exp;
+				{
+					StageTimer timer(Metrics::EVAL);
+					exp = interp.evaluate();
+				}
 				output_comms.store_output(std::pair<std::string, Expression>("", exp));
 				
 			}
@@ -216,20 +246,22 @@ void NotebookApp::parseExpression(Expression &exp) {
 
 void NotebookApp::sendSignal(Expression &exp)
 {
-	auto property = exp.prop();
+	const auto & property = exp.prop();
 
 	std::string names[3] = { "\"point\"","\"line\"","\"text\"" };
 
-	if (property["\"object-name\""].head().asSymbol() == names[0]) {
+	const std::string name = property.get(OBJECT_NAME_KEY).head().asSymbol();
+
+	if (name == names[0]) {
 		auto tail = exp.tailConstBegin();
 		auto x = tail->head().asNumber();
 		tail++;
 		double y = tail->head().asNumber();
-		double dia = property["\"size\""].head().asNumber();
+		double dia = property.get(SIZE_KEY).head().asNumber();
 		emit sendCircle(x, y, dia);
 	}
 
-	else if (property["\"object-name\""].head().asSymbol() == names[1]) {
+	else if (name == names[1]) {
 		auto tail = exp.tailConstBegin();
 
 		auto subTail0 = tail->tailConstBegin();
@@ -244,19 +276,19 @@ void NotebookApp::sendSignal(Expression &exp)
 		subTail1++;
 		auto y2 = subTail1->head().asNumber();
 
-		double thickness = property["\"thickness\""].head().asNumber();
+		double thickness = property.get(THICKNESS_KEY).head().asNumber();
 
 		emit sendLine(x1, y1, x2, y2, thickness);
 	}
 
-	else if (property["\"object-name\""].head().asSymbol() == names[2]) {
+	else if (name == names[2]) {
 		std::string str = exp.head().asSymbol();
-		auto t = exp.prop()["\"position\""].tailConstBegin();
+		auto t = property.get(POSITION_KEY).tailConstBegin();
 		double x = t->head().asNumber();
 		t++;
 		double y = t->head().asNumber();
-		double rotate = property["\"text-rotation\""].head().asNumber();
-		double size = property["\"text-scale\""].head().asNumber();
+		double rotate = property.get(TEXT_ROTATION_KEY).head().asNumber();
+		double size = property.get(TEXT_SCALE_KEY).head().asNumber();
 		emit sendText(str, x, y, rotate, size);
 	}
 
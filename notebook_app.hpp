@@ -7,7 +7,9 @@
 #include "interpreter.hpp"
 #include "startup_config.hpp"
 #include "expression.hpp"
+#include "metrics.hpp"
 #include "thread_safe.hpp"
+#include "trace.hpp"
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -26,6 +28,10 @@ class NotebookApp : public QWidget
 	NotebookApp(QWidget * parent = nullptr);
 	~NotebookApp();
 
+	/*writes the request metrics to file in the Prometheus
+	text format after each output is rendered*/
+	void setMetricsFile(const std::string & file);
+
 public slots:
 	/*receives data from input.hpp with the suer entered string 
 	and runs it through interpreter to evaluate it*/
@@ -74,6 +80,9 @@ private:
 
 	outputCommunication output_comms;
 
+	// file the metrics are written to, empty for none
+	std::string metrics_file;
+
 	/*env_mqueue environment_queue;*/
 
 	Interpreter interp;
@@ -0,0 +1,293 @@
+#include "numeric_function.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <string>
+#include <utility>
+
+// heads the interpreter evaluates as special forms
+static const char * SPECIAL_FORMS[] = {
+  "list", "begin", "define", "lambda", "apply", "map", "set-property", "get-property",
+  "discrete-plot", "continuous-plot", "memoize", "memo-stats"
+};
+
+static bool is_special_form(const std::string & name){
+  return std::find(std::begin(SPECIAL_FORMS), std::end(SPECIAL_FORMS), name) != std::end(SPECIAL_FORMS);
+}
+
+struct NumericFunction::Compiler {
+
+  // variables visible at a point of the body and their frame slots,
+  // searched from the back so inner bindings hide outer ones
+  typedef std::vector<std::pair<std::string, std::size_t>> Scope;
+
+  const Environment & env;
+
+  // frame slots used so far
+  std::size_t slots;
+
+  // lambdas being inlined, a lambda calling itself is not compiled
+  std::vector<std::string> inlining;
+
+  explicit Compiler(const Environment & e): env(e), slots(0) {}
+
+  // the parameter names of lambda, false if lambdaEval would not bind them all
+  bool parameters(const Expression & lambda, std::vector<std::string> & names) const {
+    if(lambda.tailSize() != 2) return false;
+    const Expression & params = *lambda.tailConstBegin();
+    for(auto p = params.tailConstBegin(); p != params.tailConstEnd(); ++p){
+      if((p->tailSize() != 0) || !p->isHeadSymbol()) return false;
+      const std::string name = p->head().asSymbol();
+      // lambdaEval binds each parameter with define, which rejects these
+      if((name == "define") || (name == "begin") || env.is_proc(p->head())) return false;
+      names.push_back(name);
+    }
+    return true;
+  }
+
+  // the body of a lambda, reading its parameters from the first slots.
+  // Memoized lambdas are left to the interpreter and its cache
+  bool function(const Expression & lambda, Closure & out, std::size_t & arity){
+    if(!lambda.prop().empty()) return false;
+
+    std::vector<std::string> names;
+    if(!parameters(lambda, names) || names.empty()) return false;
+
+    Scope scope;
+    for(auto & n : names){
+      scope.push_back(std::make_pair(n, slots++));
+    }
+    arity = names.size();
+    return compile(*(lambda.tailConstBegin() + 1), scope, out);
+  }
+
+  bool compile(const Expression & exp, const Scope & scope, Closure & out){
+    if(exp.tailSize() == 0){
+      return terminal(exp.head(), scope, out);
+    }
+
+    if(!exp.isHeadSymbol()) return false;
+    const std::string name = exp.head().asSymbol();
+    if(is_special_form(name) || find(scope, name) != scope.rend()) return false;
+
+    if(env.isLambda(exp.head())){
+      return call(exp, scope, out);
+    }
+
+    std::vector<Closure> args;
+    for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
+      Closure arg;
+      if(!compile(*e, scope, arg)) return false;
+      args.push_back(arg);
+    }
+    return builtin(exp.head(), args, out);
+  }
+
+  Scope::const_reverse_iterator find(const Scope & scope, const std::string & name) const {
+    return std::find_if(scope.rbegin(), scope.rend(),
+      [&name](const Scope::value_type & v){ return v.first == name; });
+  }
+
+  // a number, a variable or a symbol bound to a number
+  bool terminal(const Atom & head, const Scope & scope, Closure & out){
+    if(head.isNumber()){
+      out = constant(head.asNumber());
+      return true;
+    }
+    if(!head.isSymbol()) return false;
+
+    auto variable = find(scope, head.asSymbol());
+    if(variable != scope.rend()){
+      std::size_t slot = variable->second;
+      out = [slot](Frame & frame, Column & result){ result = frame.slots[slot]; };
+      return true;
+    }
+
+    if(!env.is_exp(head)) return false;
+    Expression bound = env.get_exp(head);
+    if((bound.tailSize() != 0) || !bound.isHeadNumber()) return false;
+    out = constant(bound.head().asNumber());
+    return true;
+  }
+
+  static Closure constant(double value){
+    return [value](Frame & frame, Column & result){ result.assign(frame.size, value); };
+  }
+
+  // inline a call of a lambda. Like lambdaEval, each argument is evaluated
+  // after the parameters before it are bound, and the body sees the
+  // variables of the caller
+  bool call(const Expression & exp, const Scope & scope, Closure & out){
+    const std::string name = exp.head().asSymbol();
+    if(std::find(inlining.begin(), inlining.end(), name) != inlining.end()) return false;
+
+    const Expression lambda = env.get_exp(exp.head());
+    if(!lambda.prop().empty()) return false;
+
+    std::vector<std::string> names;
+    if(!parameters(lambda, names) || (names.size() != exp.tailSize())) return false;
+
+    Scope inner = scope;
+    std::vector<std::pair<std::size_t, Closure>> bindings;
+    auto arg = exp.tailConstBegin();
+    for(auto & n : names){
+      Closure value;
+      if(!compile(*arg++, inner, value)) return false;
+      std::size_t slot = slots++;
+      bindings.push_back(std::make_pair(slot, value));
+      inner.push_back(std::make_pair(n, slot));
+    }
+
+    inlining.push_back(name);
+    Closure body;
+    bool compiled = compile(*(lambda.tailConstBegin() + 1), inner, body);
+    inlining.pop_back();
+    if(!compiled) return false;
+
+    out = [bindings, body](Frame & frame, Column & result){
+      for(auto & b : bindings){
+        b.second(frame, result);
+        frame.slots[b.first].swap(result);
+      }
+      body(frame, result);
+    };
+    return true;
+  }
+
+  template<typename F>
+  static Closure unary(const Closure & a, F f){
+    return [a, f](Frame & frame, Column & result){
+      a(frame, result);
+      for(std::size_t i = 0; i < frame.size; ++i){
+        result[i] = f(result[i], frame.ok[i]);
+      }
+    };
+  }
+
+  template<typename F>
+  static Closure binary(const Closure & a, const Closure & b, F f){
+    return [a, b, f](Frame & frame, Column & result){
+      Column right;
+      a(frame, result);
+      b(frame, right);
+      for(std::size_t i = 0; i < frame.size; ++i){
+        result[i] = f(result[i], right[i]);
+      }
+    };
+  }
+
+  // fold the arguments left with f starting from the first
+  template<typename F>
+  static Closure fold(const std::vector<Closure> & args, F f){
+    return [args, f](Frame & frame, Column & result){
+      Column next;
+      args[0](frame, result);
+      for(std::size_t a = 1; a < args.size(); ++a){
+        args[a](frame, next);
+        for(std::size_t i = 0; i < frame.size; ++i){
+          result[i] = f(result[i], next[i]);
+        }
+      }
+    };
+  }
+
+  // the real path of the arithmetic built-ins in environment.cpp
+  bool builtin(const Atom & op, std::vector<Closure> args, Closure & out){
+    if(!env.is_proc(op)) return false;
+    const std::string name = op.asSymbol();
+    std::size_t n = args.size();
+
+    if(name == "+"){
+      // the sum starts from 0
+      args.insert(args.begin(), constant(0.0));
+      out = fold(args, [](double l, double r){ return l + r; });
+    }
+    else if((name == "*") && (n > 0)){
+      out = fold(args, [](double l, double r){ return l * r; });
+    }
+    else if((name == "-") && (n == 1)){
+      out = unary(args[0], [](double x, char &){ return -x; });
+    }
+    else if((name == "-") && (n == 2)){
+      out = binary(args[0], args[1], [](double l, double r){ return l - r; });
+    }
+    else if((name == "/") && (n == 1)){
+      out = unary(args[0], [](double x, char &){ return 1.0 / x; });
+    }
+    else if((name == "/") && (n == 2)){
+      out = binary(args[0], args[1], [](double l, double r){ return l / r; });
+    }
+    else if((name == "^") && (n == 2)){
+      out = binary(args[0], args[1], [](double l, double r){ return std::pow(l, r); });
+    }
+    else if((name == "sqrt") && (n == 1)){
+      out = unary(args[0], [](double x, char & ok) -> double {
+          if(x >= 0) return std::pow(x, 0.5);
+          // a negative number has a complex root, NaN gives 0
+          if(x < 0) ok = 0;
+          return 0.0;
+        });
+    }
+    else if((name == "ln") && (n == 1)){
+      out = unary(args[0], [](double x, char & ok) -> double {
+          if(x > 0) return std::log(x);
+          ok = 0;
+          return 0.0;
+        });
+    }
+    else if((name == "sin") && (n == 1)){
+      out = unary(args[0], [](double x, char &){ return std::sin(x); });
+    }
+    else if((name == "cos") && (n == 1)){
+      out = unary(args[0], [](double x, char &){ return std::cos(x); });
+    }
+    else if((name == "tan") && (n == 1)){
+      out = unary(args[0], [](double x, char &){ return std::tan(x); });
+    }
+    else{
+      return false;
+    }
+    return true;
+  }
+};
+
+NumericFunction::NumericFunction(const Atom & sym, const Environment & env): m_arity(0), m_slots(0){
+  if(!env.isLambda(sym)) return;
+
+  Compiler compiler(env);
+  Closure body;
+  std::size_t arity = 0;
+  if(compiler.function(env.get_exp(sym), body, arity)){
+    m_body = body;
+    m_arity = arity;
+    m_slots = compiler.slots;
+  }
+}
+
+bool NumericFunction::evaluate(double x, double & y) const{
+  if(!m_body || (m_arity != 1)) return false;
+
+  std::vector<double> ys;
+  std::vector<char> ok;
+  evaluate(std::vector<std::vector<double>>(1, std::vector<double>(1, x)), ys, ok);
+  y = ys[0];
+  return ok[0] != 0;
+}
+
+void NumericFunction::evaluate(const std::vector<std::vector<double>> & args, std::vector<double> & ys, std::vector<char> & ok) const{
+  Frame frame;
+  frame.size = args.empty() ? 0 : args[0].size();
+  frame.ok.assign(frame.size, 1);
+  if(!m_body || (args.size() != m_arity)){
+    ys.assign(frame.size, 0.0);
+    frame.ok.assign(frame.size, 0);
+    ok.swap(frame.ok);
+    return;
+  }
+
+  frame.slots.resize(m_slots);
+  std::copy(args.begin(), args.end(), frame.slots.begin());
+  m_body(frame, ys);
+  ok.swap(frame.ok);
+}
@@ -0,0 +1,82 @@
+/*! \file numeric_function.hpp
+Defines the NumericFunction used to sample lambdas of one real variable.
+ */
+#ifndef NUMERIC_FUNCTION_HPP
+#define NUMERIC_FUNCTION_HPP
+
+#include <functional>
+#include <vector>
+
+#include "atom.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class NumericFunction
+\brief A lambda of real variables compiled to a tree of closures on arrays of doubles.
+
+The body of the lambda is compiled once into closures that compute on
+raw doubles, so evaluating it does not build Expressions, copy the
+Environment or look up names. Numbers, the parameters, symbols bound to
+numbers, the real arithmetic built-ins and calls of other lambdas whose
+bodies compile are supported. A lambda using anything else is not
+compiled and the caller evaluates it with lambdaEval instead.
+
+The closures evaluate a whole batch of argument tuples at a time: each
+node of the tree runs once per batch, looping over packed columns of
+values, one per parameter.
+
+The closures follow the built-ins exactly on real values. A point where
+a built-in would return a complex or raise an error is reported by
+evaluate, and the caller evaluates that point with the interpreter.
+*/
+class NumericFunction {
+public:
+
+  /*! Compile the lambda named sym in env.
+    \param sym the name of the lambda
+    \param env the environment the lambda would be evaluated in
+   */
+  NumericFunction(const Atom & sym, const Environment & env);
+
+  /// true if the lambda was compiled
+  bool compiled() const noexcept { return static_cast<bool>(m_body); }
+
+  /// number of parameters of the compiled lambda
+  std::size_t arity() const noexcept { return m_arity; }
+
+  /*! Evaluate the compiled lambda of one parameter at x.
+    \return true and set y, or false if the interpreter must evaluate this point
+   */
+  bool evaluate(double x, double & y) const;
+
+  /*! Evaluate the compiled lambda on a batch of argument tuples.
+    \param args one column of values per parameter, all of the same length
+    \param ys set to the value for each tuple
+    \param ok set to 0 for the tuples the interpreter must evaluate, 1 otherwise
+   */
+  void evaluate(const std::vector<std::vector<double>> & args, std::vector<double> & ys, std::vector<char> & ok) const;
+
+private:
+
+  typedef std::vector<double> Column;
+
+  // the values of the parameters and of the parameters of inlined
+  // lambdas for each tuple of a batch
+  struct Frame {
+    std::size_t size;
+    std::vector<Column> slots;
+    std::vector<char> ok;
+  };
+
+  // a compiled expression, computing its value for each tuple of the
+  // frame into out and clearing ok where the interpreter must take over
+  typedef std::function<void(Frame & frame, Column & out)> Closure;
+
+  struct Compiler;
+
+  Closure m_body;
+  std::size_t m_arity;
+  std::size_t m_slots;
+};
+
+#endif
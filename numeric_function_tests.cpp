@@ -0,0 +1,134 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "environment.hpp"
+#include "numeric_function.hpp"
+#include "parse.hpp"
+#include "semantic_error.hpp"
+
+// evaluate each program in env
+static void define(Environment & env, const std::vector<std::string> & programs){
+  for(auto & program : programs){
+    std::istringstream iss(program);
+    parse(tokenize(iss)).eval(env);
+  }
+}
+
+// value of the lambda f at x from the interpreter
+static Expression interpret(Environment & env, double x){
+  Expression call(Atom("f"));
+  return call.lambdaEval(Atom("f"), env, std::vector<Expression>(1, Expression(x)));
+}
+
+TEST_CASE( "Test compiled lambdas match the interpreter", "[numeric_function]" ) {
+
+  std::vector<std::string> bodies = {
+    "(+ (* 2 x) (sin x))",
+    "(/ 1 (+ 1 (^ e (- (* 20 x)))))",
+    "(- (* x x x) (+ (/ x) (cos (tan x))))",
+    "(+ x)",
+    "(* pi (- x))",
+    "(+ (sqrt (* x x)) (ln (+ 2 x)) a)",
+    "(g (+ x 1) x)",
+    "(g x (h x))",
+  };
+
+  for(auto & body : bodies){
+    Environment env;
+    define(env, {"(define a 3)", "(define g (lambda (u v) (- u (* 2 v))))",
+          "(define h (lambda (y) (g y a)))", "(define f (lambda (x) " + body + "))"});
+
+    INFO(body);
+    NumericFunction compiled(Atom("f"), env);
+    REQUIRE(compiled.compiled());
+    for(double x = -1; x <= 1; x += 0.125){
+      double y = 0;
+      REQUIRE(compiled.evaluate(x, y));
+      Expression expected = interpret(env, x);
+      REQUIRE(expected.isHeadNumber());
+      REQUIRE(y == expected.head().asNumber());
+    }
+  }
+}
+
+TEST_CASE( "Test points left to the interpreter", "[numeric_function]" ) {
+
+  Environment env;
+  define(env, {"(define f (lambda (x) (+ (sqrt x) (ln (+ x 2)))))"});
+
+  NumericFunction compiled(Atom("f"), env);
+  REQUIRE(compiled.compiled());
+
+  double y = 0;
+  REQUIRE(compiled.evaluate(1, y));
+  REQUIRE(y == 1 + std::log(3.0));
+
+  // complex root
+  REQUIRE(!compiled.evaluate(-1, y));
+  REQUIRE(interpret(env, -1).isHeadComplex());
+
+  // ln raises an error
+  REQUIRE(!compiled.evaluate(-3, y));
+  REQUIRE_THROWS_AS(interpret(env, -3), SemanticError);
+}
+
+TEST_CASE( "Test lambdas that are not compiled", "[numeric_function]" ) {
+
+  std::vector<std::string> lambdas = {
+    "(define f (lambda (x) (* x I)))",
+    "(define f (lambda (x) (real x)))",
+    "(define f (lambda (x) (first (list x))))",
+    "(define f (lambda (x) (begin (define y x) y)))",
+    "(define f (lambda (x) (+ x y)))",
+    "(define f (lambda (x) (- x 1 2)))",
+    "(define f (lambda (x) (x 1)))",
+    "(define f (memoize (lambda (x) x)))",
+    "(begin (define g (memoize (lambda (y) y))) (define f (lambda (x) (g x))))",
+  };
+
+  for(auto & lambda : lambdas){
+    Environment env;
+    define(env, {lambda});
+    INFO(lambda);
+    NumericFunction compiled(Atom("f"), env);
+    REQUIRE(!compiled.compiled());
+    double y = 0;
+    REQUIRE(!compiled.evaluate(0, y));
+  }
+
+  Environment env;
+  NumericFunction undefined(Atom("f"), env);
+  REQUIRE(!undefined.compiled());
+}
+
+TEST_CASE( "Test batches of argument tuples", "[numeric_function]" ) {
+
+  Environment env;
+  define(env, {"(define f (lambda (x y) (- (sqrt x) (* 2 y))))"});
+
+  NumericFunction compiled(Atom("f"), env);
+  REQUIRE(compiled.compiled());
+  REQUIRE(compiled.arity() == 2);
+
+  double y = 0;
+  REQUIRE(!compiled.evaluate(1, y));
+
+  std::vector<std::vector<double>> args = {{4, -1, 9, 0}, {1, 2, 3, 4}};
+  std::vector<double> ys;
+  std::vector<char> ok;
+  compiled.evaluate(args, ys, ok);
+
+  REQUIRE(ys.size() == 4);
+  REQUIRE(ok == std::vector<char>({1, 0, 1, 1}));
+  REQUIRE(ys[0] == 0);
+  REQUIRE(ys[2] == -3);
+  REQUIRE(ys[3] == -8);
+
+  // a batch of the wrong arity is left to the interpreter
+  compiled.evaluate(std::vector<std::vector<double>>(1, std::vector<double>(3, 1.0)), ys, ok);
+  REQUIRE(ok == std::vector<char>(3, 0));
+}
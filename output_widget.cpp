@@ -3,6 +3,7 @@
 #include <string>
 #include <QGraphicsTextItem>
 #include <QDebug>
+#include "trace.hpp"
 
 void OutputWidget::resizeEvent(QResizeEvent * event)
 {
@@ -24,6 +25,7 @@ OutputWidget::OutputWidget(QWidget * parent):QWidget(parent) {
 }
 
 void OutputWidget::showExpression(std::string output) {
+	TraceScope trace("paint");
 	
 	QGraphicsTextItem *expression = new QGraphicsTextItem();
 	QString out = QString::fromStdString(output);
@@ -43,6 +45,7 @@ OutputWidget::~OutputWidget()
 
 void OutputWidget::showCircle(double x, double y, double dia)
 {
+	TraceScope trace("paint");
 	QGraphicsEllipseItem *circle = new QGraphicsEllipseItem();
   QRectF rec(x - (dia / 2), y - (dia / 2), dia, dia);
 
@@ -59,6 +62,7 @@ void OutputWidget::showCircle(double x, double y, double dia)
 
 void OutputWidget::showLine(double x1, double y1, double x2, double y2, double thick)
 {
+	TraceScope trace("paint");
 	QGraphicsLineItem *line = new QGraphicsLineItem(x1, y1, x2, y2);
 	QPen *pen = new QPen;
 	pen->setWidth(thick);
@@ -69,6 +73,7 @@ void OutputWidget::showLine(double x1, double y1, double x2, double y2, double t
 
 void OutputWidget::showText(std::string input, double x, double y, double rotate, double scale)
 {
+	TraceScope trace("paint");
 	//removing the quotes
 	input.erase(0, 1); // erase the first character
 	input.erase(input.size() - 1); // erase the last character
@@ -92,6 +97,7 @@ void OutputWidget::showText(std::string input, double x, double y, double rotate
 
 void OutputWidget::showClear()
 {
+	TraceScope trace("paint");
 	scene->clear();
 }
 
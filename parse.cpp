@@ -1,6 +1,11 @@
 #include "parse.hpp"
 
+#include <algorithm>
 #include <stack>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.hpp"
 
 bool setHead(Expression &exp, const Token &token) {
 
@@ -20,7 +25,37 @@ bool append(Expression *exp, const Token &token) {
   return !a.isNone();
 }
 
+// canonical subtrees seen so far, by structural hash
+typedef std::unordered_multimap<std::size_t, Expression> SubtreeTable;
+
+// replace every subtree of exp identical to one seen before by a copy of
+// that one, so they share their tail. Numbers must match exactly, sharing
+// one merely equal within the tolerance would change the program. Children first, so the
+// hashes and comparisons of parents see shared children.
+void share_subtrees(Expression &exp, SubtreeTable &seen) {
+
+  if (exp.tailSize() == 0) {
+    return;
+  }
+
+  for (auto e = exp.tailBegin(); e != exp.tailEnd(); ++e) {
+    share_subtrees(*e, seen);
+  }
+
+  std::size_t hash = exp.hash();
+  auto range = seen.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.identical(exp)) {
+      exp = it->second;
+      exp.hash();
+      return;
+    }
+  }
+  seen.emplace(hash, exp);
+}
+
 Expression parse(const TokenSequenceType &tokens) noexcept {
+  TraceScope trace("parse");
 
   Expression ast;
 
@@ -96,8 +131,92 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
   }
 
   if (stack.empty() && (num_tokens_seen == tokens.size())) {
+    SubtreeTable seen;
+    share_subtrees(ast, seen);
     return ast;
   }
 
   return Expression();
 };
+
+Reader::Reader(std::istream & input): m_tokens(input), m_failed(false) {}
+
+bool Reader::next(Expression & exp) {
+
+  if (m_failed) {
+    return false;
+  }
+
+  // the tokens up to the close of the first open
+  TokenSequenceType tokens;
+  std::size_t depth = 0;
+  Token t(Token::OPEN);
+  while (m_tokens.next(t)) {
+    tokens.push_back(t);
+    if (t.type() == Token::OPEN) {
+      depth += 1;
+    }
+    else if (t.type() == Token::CLOSE) {
+      if (depth <= 1) {
+        break;
+      }
+      depth -= 1;
+    }
+    else if (depth == 0) {
+      break;
+    }
+  }
+
+  if (tokens.empty()) {
+    return false;
+  }
+
+  exp = parse(tokens);
+  m_failed = (exp == Expression());
+  return !m_failed;
+}
+
+PipelinedReader::PipelinedReader(std::istream & input, std::size_t capacity):
+  m_reader(input), m_queue((capacity + BATCH_SIZE - 1) / BATCH_SIZE), m_failed(false),
+  m_thread(&PipelinedReader::read, this) {}
+
+PipelinedReader::~PipelinedReader() {
+  m_queue.close();
+  m_thread.join();
+}
+
+bool PipelinedReader::next(Expression & exp) {
+  if (m_batch.empty() && !m_queue.pop(m_batch)) {
+    return false;
+  }
+  exp = m_batch.back();
+  m_batch.pop_back();
+  return true;
+}
+
+void PipelinedReader::read() {
+  if (Trace::enabled()) {
+    Trace::nameThread("reader");
+  }
+
+  std::vector<Expression> batch;
+  Expression exp;
+  while (m_reader.next(exp)) {
+    batch.push_back(exp);
+    if (batch.size() == BATCH_SIZE) {
+      std::reverse(batch.begin(), batch.end());
+      if (!m_queue.push(std::move(batch))) {
+        return;
+      }
+      batch.clear();
+    }
+  }
+  std::reverse(batch.begin(), batch.end());
+  if (!batch.empty()) {
+    m_queue.push(std::move(batch));
+  }
+
+  // set before close, so it is seen once the queue is drained
+  m_failed.store(m_reader.failed());
+  m_queue.close();
+}
@@ -4,6 +4,11 @@ Defines the parse function.
 #ifndef PARSE_HPP
 #define PARSE_HPP
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
 #include "token.hpp"
 #include "expression.hpp"
 
@@ -15,4 +20,118 @@ Defines the parse function.
  */
 Expression parse(const TokenSequenceType & tokens) noexcept;
 
+/*! \class Reader
+\brief Reads the top-level expressions of a stream one at a time.
+
+Only the tokens of the expression being read are held in memory, so a
+script of many top-level expressions can be evaluated as it is read.
+*/
+class Reader {
+public:
+
+  /// read expressions from input, which must outlive the Reader
+  explicit Reader(std::istream & input);
+
+  /*! Read and parse the next top-level expression.
+    \param exp set to the expression read
+    \return false at the end of the input or when the next expression
+    cannot be parsed, in which case failed() is true
+   */
+  bool next(Expression & exp);
+
+  /// true if reading stopped at an expression that could not be parsed
+  bool failed() const noexcept { return m_failed; }
+
+private:
+  TokenStream m_tokens;
+  bool m_failed;
+};
+
+/*! \class PipelinedReader
+\brief A Reader that tokenizes and parses on a thread of its own.
+
+The reading thread runs ahead of the thread taking the expressions by up
+to capacity expressions, so reading the input overlaps with evaluating the
+expressions already read. Expressions are handed over in batches of
+BATCH_SIZE, so the threads rarely wait on each other. Constant folding depends on the environment, so
+it is left to the thread taking the expressions.
+*/
+class PipelinedReader {
+public:
+
+  /// default number of expressions read ahead
+  static const std::size_t DEFAULT_CAPACITY = 256;
+
+  /// expressions handed over at once
+  static const std::size_t BATCH_SIZE = 32;
+
+  /// start reading input, which must outlive the PipelinedReader
+  explicit PipelinedReader(std::istream & input, std::size_t capacity = DEFAULT_CAPACITY);
+
+  /// stop reading and join the reading thread
+  ~PipelinedReader();
+
+  PipelinedReader(const PipelinedReader &) = delete;
+  PipelinedReader & operator=(const PipelinedReader &) = delete;
+
+  /*! Take the next top-level expression, waiting for it to be read.
+    \param exp set to the expression read
+    \return false at the end of the input or when the next expression
+    cannot be parsed, in which case failed() is true
+   */
+  bool next(Expression & exp);
+
+  /// true if reading stopped at an expression that could not be parsed
+  bool failed() const noexcept { return m_failed.load(); }
+
+private:
+  Reader m_reader;
+  BoundedQueue<std::vector<Expression>> m_queue;
+  std::atomic<bool> m_failed;
+
+  // the batch being taken, in reverse order
+  std::vector<Expression> m_batch;
+
+  std::thread m_thread;
+
+  // read every expression into the queue, on the reading thread
+  void read();
+};
+
+/*! \class LookaheadReader
+\brief Takes expressions from another reader one expression behind it.
+
+An expression is handed out only once the expression after it was read,
+or the input ended cleanly, so a program with a syntax error anywhere
+after its last expression is rejected before that expression is
+evaluated, as it was when the whole program was parsed up front.
+*/
+template<typename ReaderType>
+class LookaheadReader {
+public:
+
+  /// take expressions from reader, which must outlive the LookaheadReader
+  explicit LookaheadReader(ReaderType & reader): m_reader(reader), m_ready(reader.next(m_next)) {}
+
+  /*! Take the next top-level expression.
+    \param exp set to the expression read
+    \return false at the end of the input or when the next expression or
+    the one after it cannot be parsed, in which case failed() is true
+   */
+  bool next(Expression & exp){
+    if(!m_ready) return false;
+    exp = m_next;
+    m_ready = m_reader.next(m_next);
+    return m_ready || !m_reader.failed();
+  }
+
+  /// true if reading stopped at an expression that could not be parsed
+  bool failed() const noexcept { return m_reader.failed(); }
+
+private:
+  ReaderType & m_reader;
+  Expression m_next;
+  bool m_ready;
+};
+
 #endif
@@ -0,0 +1,102 @@
+#include "parse_cache.hpp"
+
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+
+// default parse cache capacity, 16 MiB
+const std::size_t DEFAULT_PARSE_CACHE_CAPACITY = 16 * 1024 * 1024;
+
+// estimated bytes held by the nodes of exp, shared subtrees are counted each time
+static std::size_t node_bytes(const Expression & exp){
+  std::size_t bytes = sizeof(Expression);
+  for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
+    bytes += node_bytes(*e);
+  }
+  return bytes;
+}
+
+ParseCache::ParseCache(std::size_t capacity):
+  m_capacity(capacity), m_bytes(0), m_hits(0), m_misses(0){}
+
+bool ParseCache::find(const std::string & text, Expression & ast, unsigned state){
+  if(m_capacity == 0) return false;
+
+  auto entry = lookup(std::hash<std::string>()(text), text);
+  if((entry == m_entries.end()) || (entry->state != state)){
+    ++m_misses;
+    return false;
+  }
+
+  m_entries.splice(m_entries.begin(), m_entries, entry);
+  ++m_hits;
+  ast = entry->ast;
+  return true;
+}
+
+void ParseCache::insert(const std::string & text, const Expression & ast, unsigned state){
+  std::size_t hash = std::hash<std::string>()(text);
+  auto entry = lookup(hash, text);
+  if(entry != m_entries.end()){
+    if(entry->state == state) return;
+    erase(entry);
+  }
+
+  std::size_t bytes = sizeof(Entry) + text.size() + node_bytes(ast);
+  if(bytes > m_capacity) return;
+
+  m_entries.push_front({hash, text, ast, state, bytes});
+  m_index.emplace(hash, m_entries.begin());
+  m_bytes += bytes;
+  evict();
+}
+
+void ParseCache::clear() noexcept{
+  m_entries.clear();
+  m_index.clear();
+  m_bytes = 0;
+  m_hits = 0;
+  m_misses = 0;
+}
+
+ParseCache::Stats ParseCache::stats() const noexcept{
+  return {m_hits, m_misses, m_entries.size(), m_bytes};
+}
+
+std::size_t ParseCache::defaultCapacity(){
+  const char * value = std::getenv("PLOTSCRIPT_PARSE_CACHE");
+  if(value != nullptr){
+    char * end = nullptr;
+    long kib = std::strtol(value, &end, 10);
+    if((end != value) && (kib >= 0)){
+      return static_cast<std::size_t>(kib) * 1024;
+    }
+  }
+  return DEFAULT_PARSE_CACHE_CAPACITY;
+}
+
+ParseCache::EntryList::iterator ParseCache::lookup(std::size_t hash, const std::string & text){
+  auto range = m_index.equal_range(hash);
+  for(auto it = range.first; it != range.second; ++it){
+    if(it->second->text == text) return it->second;
+  }
+  return m_entries.end();
+}
+
+void ParseCache::erase(EntryList::iterator entry){
+  auto range = m_index.equal_range(entry->hash);
+  for(auto it = range.first; it != range.second; ++it){
+    if(it->second == entry){
+      m_index.erase(it);
+      break;
+    }
+  }
+  m_bytes -= entry->bytes;
+  m_entries.erase(entry);
+}
+
+void ParseCache::evict(){
+  while(m_bytes > m_capacity){
+    erase(std::prev(m_entries.end()));
+  }
+}
@@ -0,0 +1,94 @@
+/*! \file parse_cache.hpp
+Defines the ParseCache of the ASTs of programs parsed before.
+ */
+#ifndef PARSE_CACHE_HPP
+#define PARSE_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "expression.hpp"
+
+/*! \class ParseCache
+\brief A least recently used cache from program text to its parsed AST.
+
+Entries are found by the hash of their text and the text is compared, so
+a hash collision is a miss. The memory held by the entries, estimated
+from their text and number of nodes, is kept within the capacity by
+evicting the least recently used entries. Each AST is cached with a
+state, such as the ConstantFolder::foldable state it was folded in, and
+is only found again in the same state.
+*/
+class ParseCache {
+public:
+
+  /// hit and miss counts and current size
+  struct Stats {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t entries;
+    std::size_t bytes;
+  };
+
+  /// Construct an empty cache of capacity bytes, a capacity of 0 disables it
+  explicit ParseCache(std::size_t capacity);
+
+  ParseCache(const ParseCache &) = delete;
+  ParseCache & operator=(const ParseCache &) = delete;
+
+  /*! Find the AST of text, counting a hit or a miss.
+    \param text the program text
+    \param ast set to the cached AST on a hit
+    \param state the state the AST must have been cached in, an entry in
+    another state is a miss
+    \return true on a hit
+   */
+  bool find(const std::string & text, Expression & ast, unsigned state = 0);
+
+  /*! cache the AST of text in state, replacing an entry of text in another
+    state and evicting least recently used entries to make room
+   */
+  void insert(const std::string & text, const Expression & ast, unsigned state = 0);
+
+  /// remove every entry and reset the counts
+  void clear() noexcept;
+
+  /// the counts since construction or the last clear
+  Stats stats() const noexcept;
+
+  /// capacity in bytes
+  std::size_t capacity() const noexcept { return m_capacity; }
+
+  /*! Default capacity, from the PLOTSCRIPT_PARSE_CACHE environment
+    variable in KiB if it is set, 0 disables the cache.
+   */
+  static std::size_t defaultCapacity();
+
+private:
+
+  struct Entry {
+    std::size_t hash;
+    std::string text;
+    Expression ast;
+    unsigned state;
+    std::size_t bytes;
+  };
+
+  // most recently used first
+  typedef std::list<Entry> EntryList;
+
+  EntryList m_entries;
+  std::unordered_multimap<std::size_t, EntryList::iterator> m_index;
+  std::size_t m_capacity;
+  std::size_t m_bytes;
+  std::size_t m_hits;
+  std::size_t m_misses;
+
+  EntryList::iterator lookup(std::size_t hash, const std::string & text);
+  void erase(EntryList::iterator entry);
+  void evict();
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <string>
+
+#include "interpreter.hpp"
+#include "parse_cache.hpp"
+#include "test_helpers.hpp"
+
+TEST_CASE( "Test parse cache hits and misses", "[parse_cache]" ) {
+
+  ParseCache cache(1 << 20);
+  Expression ast;
+
+  REQUIRE_FALSE(cache.find("(+ 1 2)", ast));
+  cache.insert("(+ 1 2)", parse_text("(+ 1 2)"));
+  REQUIRE(cache.find("(+ 1 2)", ast));
+  REQUIRE(ast == parse_text("(+ 1 2)"));
+  REQUIRE_FALSE(cache.find("(+ 1 2) ", ast));
+
+  ParseCache::Stats stats = cache.stats();
+  REQUIRE(stats.hits == 1);
+  REQUIRE(stats.misses == 2);
+  REQUIRE(stats.entries == 1);
+  REQUIRE(stats.bytes > 0);
+
+  cache.clear();
+  stats = cache.stats();
+  REQUIRE(stats.hits == 0);
+  REQUIRE(stats.entries == 0);
+  REQUIRE(stats.bytes == 0);
+  REQUIRE_FALSE(cache.find("(+ 1 2)", ast));
+}
+
+TEST_CASE( "Test parse cache evicts the least recently used entries", "[parse_cache]" ) {
+
+  // measure the size of one entry, all entries below have the same size
+  ParseCache probe(1 << 20);
+  probe.insert("(+ 1 0)", parse_text("(+ 1 0)"));
+  std::size_t entry = probe.stats().bytes;
+
+  ParseCache cache(3 * entry);
+  Expression ast;
+  for(int i = 0; i < 3; ++i){
+    std::string text = "(+ 1 " + std::to_string(i) + ")";
+    cache.insert(text, parse_text(text));
+  }
+  REQUIRE(cache.stats().entries == 3);
+
+  // using the oldest entry makes the second one the least recently used
+  REQUIRE(cache.find("(+ 1 0)", ast));
+  cache.insert("(+ 1 3)", parse_text("(+ 1 3)"));
+  REQUIRE(cache.stats().entries == 3);
+  REQUIRE(cache.stats().bytes <= cache.capacity());
+  REQUIRE(cache.find("(+ 1 0)", ast));
+  REQUIRE_FALSE(cache.find("(+ 1 1)", ast));
+  REQUIRE(cache.find("(+ 1 2)", ast));
+  REQUIRE(cache.find("(+ 1 3)", ast));
+
+  // an entry larger than the capacity is not cached
+  std::string big = "(list";
+  for(int i = 0; i < 100; ++i){
+    big += " " + std::to_string(i);
+  }
+  big += ")";
+  cache.insert(big, parse_text(big));
+  REQUIRE_FALSE(cache.find(big, ast));
+  REQUIRE(cache.stats().entries == 3);
+
+  ParseCache disabled(0);
+  disabled.insert("(+ 1 0)", parse_text("(+ 1 0)"));
+  REQUIRE_FALSE(disabled.find("(+ 1 0)", ast));
+  REQUIRE(disabled.stats().misses == 0);
+}
+
+TEST_CASE( "Test Interpreter reuses the AST of a program parsed before", "[parse_cache]" ) {
+
+  Interpreter interp;
+  REQUIRE(interp.parseString("(define a (+ 1 2))"));
+  REQUIRE(interp.evaluate() == Expression(3.));
+  REQUIRE(interp.parseString("(* a 2)"));
+  REQUIRE(interp.evaluate() == Expression(6.));
+
+  REQUIRE(interp.parseString("(define a 4)"));
+  interp.evaluate();
+  REQUIRE(interp.parseString("(* a 2)"));
+  REQUIRE(interp.evaluate() == Expression(8.));
+
+  REQUIRE_FALSE(interp.parseString("(* a 2"));
+
+  ParseCache::Stats stats = interp.parseCache().stats();
+  REQUIRE(stats.hits == 1);
+  REQUIRE(stats.misses == 4);
+  REQUIRE(stats.entries == 3);
+}
+
+TEST_CASE( "Test parse cache entries are found in their own state", "[parse_cache]" ) {
+
+  ParseCache cache(1 << 20);
+  Expression ast;
+
+  cache.insert("(* 2 pi)", parse_text("(* 2 pi)"), 1);
+  REQUIRE(cache.find("(* 2 pi)", ast, 1));
+  REQUIRE_FALSE(cache.find("(* 2 pi)", ast, 0));
+
+  // inserting in another state replaces the entry
+  cache.insert("(* 2 pi)", Expression(6.), 0);
+  REQUIRE(cache.stats().entries == 1);
+  REQUIRE(cache.find("(* 2 pi)", ast, 0));
+  REQUIRE(ast == Expression(6.));
+  REQUIRE_FALSE(cache.find("(* 2 pi)", ast, 1));
+}
+
+TEST_CASE( "Test Interpreter folds a cached program again once a constant is bound", "[parse_cache]" ) {
+
+  Interpreter interp;
+  const double pi = std::atan2(0, -1);
+  REQUIRE(interp.parseString("(* 2 pi)"));
+  REQUIRE(interp.evaluate() == Expression(2 * pi));
+  REQUIRE(interp.parseString("(* 2 pi)"));
+  REQUIRE(interp.evaluate() == Expression(2 * pi));
+  REQUIRE(interp.parseCache().stats().hits == 1);
+
+  REQUIRE(interp.parseString("(define pi 3)"));
+  interp.evaluate();
+  REQUIRE(interp.parseString("(* 2 pi)"));
+  REQUIRE(interp.evaluate() == Expression(6.));
+  REQUIRE(interp.parseCache().stats().hits == 1);
+  REQUIRE(interp.parseCache().stats().entries == 2);
+}
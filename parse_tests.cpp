@@ -57,3 +57,133 @@ TEST_CASE( "Test empty parens", "[parse]" ) {
   REQUIRE(parse(tokens) == Expression());
 }
 
+
+TEST_CASE( "Test repeated subtrees are shared", "[parse]" ) {
+
+  std::string program = "(+ (* 2 3) (* 2 3) (- 2 3))";
+
+  std::istringstream iss(program);
+
+  TokenSequenceType tokens = tokenize(iss);
+
+  Expression ast = parse(tokens);
+  const Expression & exp = ast;
+  REQUIRE(exp.tailSize() == 3);
+
+  auto it = exp.tailConstBegin();
+  const Expression & first = *it++;
+  const Expression & second = *it++;
+  const Expression & third = *it;
+
+  REQUIRE(first == second);
+  REQUIRE(&*first.tailConstBegin() == &*second.tailConstBegin());
+  REQUIRE(first != third);
+  REQUIRE(&*first.tailConstBegin() != &*third.tailConstBegin());
+
+  // numbers merely equal within the tolerance keep their own values
+  std::istringstream close("(list (list 0.5 1) (list 0.5000000000000001 1))");
+  Expression list = parse(tokenize(close));
+  const Expression & points = list;
+  const Expression & a = *points.tailConstBegin();
+  const Expression & b = *(points.tailConstBegin() + 1);
+  REQUIRE(a == b);
+  REQUIRE(a.tailConstBegin()->head().asNumber() == 0.5);
+  REQUIRE(b.tailConstBegin()->head().asNumber() > 0.5);
+}
+
+TEST_CASE( "Test reading top-level expressions one at a time", "[parse]" ) {
+
+  std::istringstream iss("(define a 1) ; comment\n(+ a (* 2 3))\n\n(list)");
+  Reader reader(iss);
+  Expression exp;
+
+  REQUIRE(reader.next(exp));
+  REQUIRE(exp.head().asSymbol() == "define");
+  REQUIRE(reader.next(exp));
+  REQUIRE(exp.head().asSymbol() == "+");
+  REQUIRE(exp.tailSize() == 2);
+  REQUIRE(reader.next(exp));
+  REQUIRE(exp.head().asSymbol() == "list");
+  REQUIRE_FALSE(reader.next(exp));
+  REQUIRE_FALSE(reader.failed());
+}
+
+TEST_CASE( "Test reading stops at an invalid expression", "[parse]" ) {
+
+  std::vector<std::string> programs = {"(+ 1 2) )", "(+ 1 2) + 1", "(+ 1 2) (1.2abc)", "(+ 1 2) (+ 1"};
+  for(auto & program : programs){
+    std::istringstream iss(program);
+    Reader reader(iss);
+    Expression exp;
+
+    REQUIRE(reader.next(exp));
+    REQUIRE_FALSE(reader.next(exp));
+    REQUIRE(reader.failed());
+    REQUIRE_FALSE(reader.next(exp));
+  }
+
+  std::istringstream empty(" ; nothing\n");
+  Reader reader(empty);
+  Expression exp;
+  REQUIRE_FALSE(reader.next(exp));
+  REQUIRE_FALSE(reader.failed());
+}
+
+TEST_CASE( "Test reading top-level expressions on another thread", "[parse]" ) {
+
+  std::string program;
+  for(int i = 0; i < 1000; ++i){
+    program += "(define v" + std::to_string(i) + " " + std::to_string(i) + ")\n";
+  }
+
+  std::istringstream iss(program);
+  PipelinedReader reader(iss, 4);
+  Expression exp;
+  int count = 0;
+  while(reader.next(exp)){
+    REQUIRE(exp.head().asSymbol() == "define");
+    REQUIRE(exp.tailConstBegin()->head().asSymbol() == "v" + std::to_string(count));
+    count += 1;
+  }
+  REQUIRE(count == 1000);
+  REQUIRE_FALSE(reader.failed());
+
+  std::istringstream invalid("(+ 1 2) (+ 1");
+  PipelinedReader failing(invalid);
+  REQUIRE(failing.next(exp));
+  REQUIRE_FALSE(failing.next(exp));
+  REQUIRE(failing.failed());
+
+  // stopping early leaves the rest unread
+  std::istringstream early(program);
+  PipelinedReader stopped(early, 1);
+  REQUIRE(stopped.next(exp));
+}
+
+TEST_CASE( "Test reading one expression ahead", "[parse]" ) {
+
+  std::istringstream valid("(define a 1) (+ a 1)");
+  Reader reader(valid);
+  LookaheadReader<Reader> ahead(reader);
+  Expression exp;
+  REQUIRE(ahead.next(exp));
+  REQUIRE(exp.head().asSymbol() == "define");
+  REQUIRE(ahead.next(exp));
+  REQUIRE(exp.head().asSymbol() == "+");
+  REQUIRE_FALSE(ahead.next(exp));
+  REQUIRE_FALSE(ahead.failed());
+
+  // the last expression is not handed out before a syntax error after it
+  std::istringstream trailing("(+ 1 a) )");
+  Reader failing(trailing);
+  LookaheadReader<Reader> failing_ahead(failing);
+  REQUIRE_FALSE(failing_ahead.next(exp));
+  REQUIRE(failing_ahead.failed());
+
+  std::istringstream later("(define a 1) (+ 1 a) (+ 1");
+  Reader later_reader(later);
+  LookaheadReader<Reader> later_ahead(later_reader);
+  REQUIRE(later_ahead.next(exp));
+  REQUIRE_FALSE(later_ahead.next(exp));
+  REQUIRE(later_ahead.failed());
+}
@@ -4,10 +4,14 @@
 #include <fstream>
 #include <thread>
 
+#include "ast_cache.hpp"
 #include "interpreter.hpp"
+#include "mapped_file.hpp"
+#include "metrics.hpp"
 #include "semantic_error.hpp"
 #include "startup_config.hpp"
 #include "thread_safe.hpp"
+#include "trace.hpp"
 
 #include <csignal>
 #include <cstdlib>
@@ -78,8 +82,56 @@ void error(const std::string & err_str) {
 	std::cerr << "Error: " << err_str << std::endl;
 }
 
+// run a %profile command on the kernel, returning the message to print
+std::string profile_command(Interpreter & interp, const std::string & command) {
+	std::ostringstream message;
+	if (command == "%profile on") {
+		interp.enableProfiling(true);
+		message << "Info: profiling on";
+	}
+	else if (command == "%profile off") {
+		if (interp.profile()) {
+			interp.profile()->report(message);
+		}
+		interp.enableProfiling(false);
+		message << "Info: profiling off";
+	}
+	else if (command == "%profile") {
+		if (interp.profile()) {
+			interp.profile()->report(message);
+			message << "Info: profiling on";
+		}
+		else {
+			message << "Error: profiling is off";
+		}
+	}
+	else {
+		message << "Error: usage %profile [on|off]";
+	}
+	return message.str();
+}
+
+// run a %stats command on the kernel, returning the message to print
+std::string stats_command(const Interpreter & interp) {
+	std::ostringstream message;
+	ParseCache::Stats cache = interp.parseCache().stats();
+	message << "parse cache hits " << cache.hits << ", misses " << cache.misses
+		<< ", entries " << cache.entries << ", bytes " << cache.bytes << "\n";
+	if (Counters::compiled()) {
+		Counters::report(interp.stats(), message);
+		message << "Info: counts of the last evaluation";
+	}
+	else {
+		message << "Info: counters are not compiled in, configure with -DPLOTSCRIPT_COUNTERS=ON";
+	}
+	return message.str();
+}
+
 void interpretation(inputCommunication & ins, outputCommunication &out) {
 	
+	if (Trace::enabled()) {
+		Trace::nameThread("kernel");
+	}
 	Interpreter interp;
 	/*env_mqueue new_queue;
 	interp.send_signal(&new_queue);*/
@@ -104,15 +156,30 @@ void interpretation(inputCommunication & ins, outputCommunication &out) {
 		if (user_input == "%stop") {
 			break;
 		}
+		else if (user_input.compare(0, 8, "%profile") == 0) {
+			out.store_output(std::pair<std::string, Expression>(profile_command(interp, user_input), Expression()));
+		}
+		else if (user_input == "%stats") {
+			out.store_output(std::pair<std::string, Expression>(stats_command(interp), Expression()));
+		}
 		else {
-			std::istringstream expression(user_input);
-			if (!interp.parseStream(expression)) {
+			TraceScope trace("request");
+			bool parsed;
+			{
+				StageTimer timer(Metrics::PARSE);
+				parsed = interp.parseString(user_input);
+			}
+			if (!parsed) {
 				//error("Invalid Expression. Could not parse.");
 				out.store_output(std::pair<std::string, Expression>("Error: Invalid Expression. Could not parse.", Expression()));
 			}
 			else {
 				try {
-					Expression exp = interp.evaluate();
+					Expression exp;
+					{
+						StageTimer timer(Metrics::EVAL);
+						exp = interp.evaluate();
+					}
 					out.store_output(std::pair<std::string, Expression>("", exp));
 				}
 				catch (const SemanticError & ex) {
@@ -139,29 +206,51 @@ void info(const std::string & err_str){
   std::cout << "Info: " << err_str << std::endl;
 }
 
-int eval_from_stream(std::istream & stream){
+// evaluate the top-level expressions of reader as they are read and print
+// the result of the last one, with profile the report is written to stderr
+template<typename ReaderType>
+int eval_from_reader(ReaderType & input, bool profile){
 
   Interpreter interp;
-  
-  if(!interp.parseStream(stream)){
+  interp.enableProfiling(profile);
+
+  // a syntax error after the last expression fails the program before it runs
+  LookaheadReader<ReaderType> reader(input);
+
+  int status = EXIT_SUCCESS;
+  bool parsed = false;
+  Expression exp;
+  try{
+    while(interp.parseNext(reader)){
+      parsed = true;
+      exp = interp.evaluate();
+    }
+  }
+  catch(const SemanticError & ex){
+    std::cerr << ex.what() << std::endl;
+    status = EXIT_FAILURE;
+  }
+
+  if((status == EXIT_SUCCESS) && (reader.failed() || !parsed)){
     error("Error: Invalid Program. Could not parse.");
-    return EXIT_FAILURE;
+    status = EXIT_FAILURE;
   }
-  else{
-    try{
-      Expression exp = interp.evaluate();
-      std::cout << exp << std::endl;
-    }
-    catch(const SemanticError & ex){
-      std::cerr << ex.what() << std::endl;
-      return EXIT_FAILURE;
-    }	
+  else if(status == EXIT_SUCCESS){
+    std::cout << exp << std::endl;
   }
 
-  return EXIT_SUCCESS;
+  if(interp.profile()){
+    interp.profile()->report(std::cerr);
+  }
+  return status;
+}
+
+int eval_from_stream(std::istream & stream, bool profile = false){
+  Reader reader(stream);
+  return eval_from_reader(reader, profile);
 }
 
-int eval_from_file(std::string filename){
+int eval_from_file(std::string filename, bool profile = false){
       
   std::ifstream ifs(filename);
   
@@ -170,7 +259,72 @@ int eval_from_file(std::string filename){
     return EXIT_FAILURE;
   }
   
-  return eval_from_stream(ifs);
+  // with a core to spare the file is read and parsed on a thread of its own
+  if(std::thread::hardware_concurrency() > 1){
+    PipelinedReader reader(ifs);
+    return eval_from_reader(reader, profile);
+  }
+  Reader reader(ifs);
+  return eval_from_reader(reader, profile);
+}
+
+// a reader writing the expressions it reads to a cache entry, committed
+// once the whole program has been read
+template<typename ReaderType>
+class CachingReader {
+public:
+  CachingReader(ReaderType & reader, AstCacheWriter & writer): reader(reader), writer(writer) {}
+
+  bool next(Expression & exp){
+    if(!reader.next(exp)){
+      if(!reader.failed()){
+        writer.commit();
+      }
+      return false;
+    }
+    writer.add(exp);
+    return true;
+  }
+
+  bool failed() const { return reader.failed(); }
+
+private:
+  ReaderType & reader;
+  AstCacheWriter & writer;
+};
+
+// evaluate a file through the AST cache, parsing it and adding it to the
+// cache when it is not there
+int eval_from_cached_file(std::string filename, bool profile = false){
+
+  MappedFile file(filename);
+  if(!file.isOpen()){
+    error("Could not open file for reading.");
+    return EXIT_FAILURE;
+  }
+
+  AstCache cache(AstCache::defaultDirectory());
+  if(!cache.enabled()){
+    std::cerr << "Info: no cache directory, set XDG_CACHE_HOME or HOME to use --cache" << std::endl;
+    return eval_from_file(filename, profile);
+  }
+  AstCache::Source source = AstCache::source(file.data(), file.size());
+  AstCacheReader cached(cache, source);
+  if(cached.valid()){
+    return eval_from_reader(cached, profile);
+  }
+
+  MemoryBuffer buffer(file.data(), file.size());
+  std::istream input(&buffer);
+  AstCacheWriter writer(cache, source);
+  if(std::thread::hardware_concurrency() > 1){
+    PipelinedReader reader(input);
+    CachingReader<PipelinedReader> caching(reader, writer);
+    return eval_from_reader(caching, profile);
+  }
+  Reader reader(input);
+  CachingReader<Reader> caching(reader, writer);
+  return eval_from_reader(caching, profile);
 }
 
 int eval_from_command(std::string argexp){
@@ -181,6 +335,15 @@ int eval_from_command(std::string argexp){
 }
 
 
+// file the metrics are written to after each request and at exit, with --metrics
+std::string metrics_file;
+
+void write_metrics() {
+	if (!metrics_file.empty() && !Metrics::writePrometheus(metrics_file)) {
+		error("Could not write metrics file.");
+	}
+}
+
 // A REPL is a repeated read-eval-print loop
 void repl(inputCommunication &ins, outputCommunication& out) {
 	install_handler();
@@ -220,6 +383,9 @@ void repl(inputCommunication &ins, outputCommunication& out) {
 					t1 = std::thread(interpretation,  std::ref(ins), std::ref(out));
 				}
 			}
+			else if (line == "%metrics") {
+				Metrics::report(std::cout);
+			}
 			else if (line == "%exit") {
 				if (t1.joinable()) {
 					ins.store_input("%stop");
@@ -229,6 +395,7 @@ void repl(inputCommunication &ins, outputCommunication& out) {
 			}
 
 			else if (t1.joinable()) {
+				TraceScope trace("wait_output");
 				ins.store_input(line);
 				std::pair<std::string, Expression> eval_output;
 
@@ -246,13 +413,18 @@ void repl(inputCommunication &ins, outputCommunication& out) {
 						continue;
 					}
 					else {
-						eval_output = output;
-						if (eval_output.first.empty()) {
-							std::cout << eval_output.second << std::endl;
-						}
-						else {
-							std::cout << eval_output.first << std::endl;
+						{
+							TraceScope trace("print");
+							StageTimer timer(Metrics::RENDER);
+							eval_output = output;
+							if (eval_output.first.empty()) {
+								std::cout << eval_output.second << std::endl;
+							}
+							else {
+								std::cout << eval_output.first << std::endl;
+							}
 						}
+						write_metrics();
 						break;
 					}
 				}
@@ -264,10 +436,40 @@ void repl(inputCommunication &ins, outputCommunication& out) {
 	t1.join();
 }
 
+// file the trace is written to at exit, with --trace
+std::string trace_file;
+
+void write_trace() {
+	std::ofstream ofs(trace_file);
+	if (!ofs) {
+		error("Could not open trace file for writing.");
+		return;
+	}
+	Trace::writeChrome(ofs);
+}
+
 int main(int argc, char *argv[])
 {
 	inputCommunication ins;
 	outputCommunication out;
+
+	// --trace <file> records trace events and writes them to file at exit,
+	// --metrics <file> writes the request metrics to file in the REPL
+	while ((argc >= 3) && ((std::string(argv[1]) == "--trace") || (std::string(argv[1]) == "--metrics"))) {
+		if (std::string(argv[1]) == "--trace") {
+			trace_file = argv[2];
+			Trace::enable(true);
+			Trace::nameThread("main");
+			std::atexit(write_trace);
+		}
+		else {
+			metrics_file = argv[2];
+			std::atexit(write_metrics);
+		}
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
 	
   if(argc == 2){
     return eval_from_file(argv[1]);
@@ -276,6 +478,12 @@ int main(int argc, char *argv[])
     if(std::string(argv[1]) == "-e"){
       return eval_from_command(argv[2]);
     }
+    else if(std::string(argv[1]) == "--profile"){
+      return eval_from_file(argv[2], true);
+    }
+    else if(std::string(argv[1]) == "--cache"){
+      return eval_from_cached_file(argv[2]);
+    }
     else{
       error("Incorrect number of command line arguments.");
     }
@@ -0,0 +1,229 @@
+#include "printer.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <locale>
+#include <sstream>
+
+#include "symbol_table.hpp"
+
+// largest precision formatted without the stream
+const int MAX_FAST_PRECISION = 9;
+
+// a fraction of a scaled number closer than this to one half is rounded by the stream
+const double TIE_MARGIN = 1e-6;
+
+const double POWERS[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13};
+const double NEGATIVE_POWERS[] = {1e0, 1e-1, 1e-2, 1e-3, 1e-4};
+
+// true if a stream formats numbers the way format_general does
+static bool is_plain(const std::ostream & format){
+  const std::ios_base::fmtflags special = std::ios_base::floatfield | std::ios_base::showpoint |
+    std::ios_base::showpos | std::ios_base::uppercase;
+  return ((format.flags() & special) == 0) && (format.getloc() == std::locale::classic());
+}
+
+/*
+  Append value to text as printf("%.*g", precision, value) formats it,
+  for numbers from 1e-4 up to 10^precision written without an exponent.
+  Returns false without appending anything for other numbers and for those
+  too close to a rounding tie to be sure of the last digit.
+*/
+static bool format_general(double value, int precision, std::string & text){
+  if(precision == 0) precision = 1;
+  if((precision < 0) || (precision > MAX_FAST_PRECISION)) return false;
+
+  if(value == 0){
+    text.append(std::signbit(value) ? "-0" : "0");
+    return true;
+  }
+  double magnitude = std::fabs(value);
+  if(!(magnitude >= NEGATIVE_POWERS[4]) || !(magnitude < POWERS[precision])) return false;
+
+  // the decimal exponent, the nearest doubles to 10^-k are above it
+  int exponent = precision - 1;
+  while(magnitude < ((exponent >= 0) ? POWERS[exponent] : NEGATIVE_POWERS[-exponent])){
+    --exponent;
+  }
+
+  double scaled = magnitude * POWERS[precision - 1 - exponent];
+  double whole = std::floor(scaled);
+  double fraction = scaled - whole;
+  if(std::fabs(fraction - 0.5) < TIE_MARGIN) return false;
+  double rounded = whole + ((fraction > 0.5) ? 1 : 0);
+  if((rounded < POWERS[precision - 1]) || (rounded >= POWERS[precision])) return false;
+
+  char digits[MAX_FAST_PRECISION];
+  std::uint64_t remaining = static_cast<std::uint64_t>(rounded);
+  for(int i = precision - 1; i >= 0; --i){
+    digits[i] = static_cast<char>('0' + remaining % 10);
+    remaining /= 10;
+  }
+
+  // trailing zeros after the decimal point are not written
+  int end = precision;
+  int integer = (exponent >= 0) ? exponent + 1 : 0;
+  while((end > integer) && (digits[end - 1] == '0')){
+    --end;
+  }
+
+  if(value < 0){
+    text.push_back('-');
+  }
+  if(exponent >= 0){
+    text.append(digits, integer);
+    if(end > integer){
+      text.push_back('.');
+      text.append(digits + integer, end - integer);
+    }
+  }
+  else{
+    text.append("0.");
+    text.append(static_cast<std::size_t>(-exponent - 1), '0');
+    text.append(digits, end);
+  }
+  return true;
+}
+
+// append value to text as format writes it, through a stream with its flags
+static void format_stream(double value, const std::ostream & format, std::string & text){
+  std::ostringstream stream;
+  stream.flags(format.flags());
+  stream.precision(format.precision());
+  stream.imbue(format.getloc());
+  stream << value;
+  text.append(stream.str());
+}
+
+void Printer::formatNumber(double value, const std::ostream & format, std::string & text){
+  std::streamsize precision = format.precision();
+  if(!is_plain(format) || !format_general(value, (precision < 0) ? 6 : static_cast<int>(precision), text)){
+    format_stream(value, format, text);
+  }
+}
+
+Printer::Printer(std::ostream & out, std::size_t capacity):
+  m_out(out), m_capacity(capacity), m_plain(is_plain(out)), m_width(out.width()){
+
+  std::streamsize precision = out.precision();
+  m_precision = (precision < 0) ? 6 : ((precision > MAX_FAST_PRECISION) ? -1 : static_cast<int>(precision));
+  m_out.width(0);
+}
+
+Printer::~Printer(){
+  flush();
+  if(m_width != 0){
+    // nothing was printed, leave the width for the next output
+    m_out.width(m_width);
+  }
+}
+
+void Printer::flush(){
+  if(!m_buffer.empty()){
+    m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    m_buffer.clear();
+  }
+}
+
+void Printer::write(const std::string & text){
+  put(text);
+}
+
+void Printer::put(const char * text, std::size_t size){
+  if(m_width != 0){
+    // the stream pads the first piece to its width, as it always has
+    flush();
+    m_out.width(m_width);
+    m_width = 0;
+    m_out << std::string(text, size);
+    return;
+  }
+  m_buffer.append(text, size);
+  if(m_buffer.size() >= m_capacity){
+    flush();
+  }
+}
+
+void Printer::number(double value){
+  if(!m_plain || !format_general(value, m_precision, m_buffer)){
+    format_stream(value, m_out, m_buffer);
+  }
+  if(m_buffer.size() >= m_capacity){
+    flush();
+  }
+}
+
+void Printer::complex(const std::complex<double> & value){
+  // the way operator<< on a complex writes it, as one piece
+  std::string text(1, '(');
+  formatNumber(value.real(), m_out, text);
+  text.push_back(',');
+  formatNumber(value.imag(), m_out, text);
+  text.push_back(')');
+  put(text);
+}
+
+void Printer::open(const Expression & exp){
+  static const SymbolId list = SymbolTable::intern("list");
+  static const SymbolId lambda = SymbolTable::intern("lambda");
+  static const SymbolId none = SymbolTable::intern("NONE");
+
+  // what to write around and between the tail, see operator<<
+  bool space_before_each = false;
+  bool space_between = true;
+  bool close = true;
+
+  const Atom & head = exp.head();
+  if(head.isComplex()){
+    complex(head.asComplex());
+    space_between = false;
+    close = false;
+  }
+  else if(head.isSymbol()){
+    SymbolId id = head.asSymbolId();
+    if(id == none){
+      put(head.symbolName());
+      return;
+    }
+    put('(');
+    if((id != list) && (id != lambda)){
+      put(head.symbolName());
+      space_before_each = true;
+      space_between = false;
+    }
+  }
+  else{
+    put('(');
+    if(head.isNumber()){
+      number(head.asNumber());
+    }
+  }
+
+  if(exp.tailSize() == 0){
+    if(close) put(')');
+    return;
+  }
+  Frame frame = {exp.tailConstBegin(), exp.tailConstEnd(), space_before_each, space_between, close, true};
+  m_stack.push_back(frame);
+}
+
+void Printer::print(const Expression & exp){
+  m_stack.clear();
+  open(exp);
+  while(!m_stack.empty()){
+    Frame & frame = m_stack.back();
+    if(frame.next == frame.end){
+      bool close = frame.close;
+      m_stack.pop_back();
+      if(close) put(')');
+      continue;
+    }
+    if(frame.space_before_each || (frame.space_between && !frame.first)){
+      put(' ');
+    }
+    frame.first = false;
+    const Expression & child = *frame.next;
+    ++frame.next;
+    open(child);
+  }
+}
@@ -0,0 +1,91 @@
+/*! \file printer.hpp
+Defines the Printer writing the text of expressions to a stream.
+ */
+#ifndef PRINTER_HPP
+#define PRINTER_HPP
+
+#include <complex>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "expression.hpp"
+
+/*! \class Printer
+\brief Writes the text of expressions to a stream, byte for byte as
+operator<< on the expression always has, through a buffer.
+
+The text is built in a buffer that is written to the stream whenever it
+holds the capacity, when flush is called and when the Printer is
+destroyed, so a large result goes out in a few large writes. Expressions
+are walked with a stack rather than recursion and numbers are formatted
+without going through the stream when its flags allow it. A Printer may
+print any number of expressions, reusing its buffer and stack.
+*/
+class Printer {
+public:
+
+  /// bytes buffered before they are written, unless another capacity is given
+  static const std::size_t DEFAULT_CAPACITY = 1 << 16;
+
+  /// print to out, formatting numbers with its flags, precision and locale
+  explicit Printer(std::ostream & out, std::size_t capacity = DEFAULT_CAPACITY);
+
+  /// write what is still buffered
+  ~Printer();
+
+  Printer(const Printer &) = delete;
+  Printer & operator=(const Printer &) = delete;
+
+  /// append the text of exp
+  void print(const Expression & exp);
+
+  /// append text as it is
+  void write(const std::string & text);
+
+  /// write the buffer to the stream
+  void flush();
+
+  /*! Append value to text as an ostream with the flags, precision and
+    locale of format writes it, in the shortest time for the default flags.
+   */
+  static void formatNumber(double value, const std::ostream & format, std::string & text);
+
+private:
+
+  // an expression whose tail is being printed
+  struct Frame {
+    Expression::ConstIteratorType next;
+    Expression::ConstIteratorType end;
+    // write a space before every element, or between elements only
+    bool space_before_each;
+    bool space_between;
+    // write a closing parenthesis after the tail
+    bool close;
+    bool first;
+  };
+
+  std::ostream & m_out;
+  std::size_t m_capacity;
+  std::string m_buffer;
+  std::vector<Frame> m_stack;
+
+  // true if numbers can be formatted without the stream
+  bool m_plain;
+  int m_precision;
+
+  // width of the stream applied to the first piece printed, 0 once it is
+  std::streamsize m_width;
+
+  void put(const char * text, std::size_t size);
+  void put(const std::string & text) { put(text.data(), text.size()); }
+  void put(char c) { put(&c, 1); }
+  void number(double value);
+  void complex(const std::complex<double> & value);
+
+  // write the start of exp and push the frame of its tail
+  void open(const Expression & exp);
+};
+
+#endif
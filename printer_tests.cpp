@@ -0,0 +1,111 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "printer.hpp"
+#include "test_helpers.hpp"
+
+static std::string print(const Expression & exp, std::size_t capacity = Printer::DEFAULT_CAPACITY){
+  std::ostringstream out;
+  {
+    Printer printer(out, capacity);
+    printer.print(exp);
+  }
+  return out.str();
+}
+
+TEST_CASE( "Test formatNumber matches the stream", "[printer]" ) {
+
+  std::mt19937_64 random(3574);
+  std::vector<double> values = {0, -0.0, 1, -1, 0.1, 0.0001, 0.00009999999, 999999.4, 999999.5,
+    1e6, 123456789, 0.5, 2.5, 1.25, 1e-300, 1e300, std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::denorm_min()};
+  for(int i = 0; i < 20000; ++i){
+    std::uint64_t bits = random();
+    double value = std::ldexp(static_cast<double>(bits >> 11), -static_cast<int>(bits % 80));
+    values.push_back(((bits & 1) ? -1 : 1) * value);
+    values.push_back(static_cast<double>(bits % 2000000) / std::pow(10, static_cast<int>(bits % 9)));
+  }
+
+  for(int precision = 0; precision <= 12; ++precision){
+    std::ostringstream format;
+    format.precision(precision);
+    for(double value : values){
+      std::ostringstream expected;
+      expected.precision(precision);
+      expected << value;
+      std::string text;
+      Printer::formatNumber(value, format, text);
+      REQUIRE(text == expected.str());
+    }
+  }
+
+  // other flags are formatted by the stream
+  std::ostringstream fixed;
+  fixed << std::fixed << std::setprecision(2);
+  std::string text;
+  Printer::formatNumber(3.14159, fixed, text);
+  REQUIRE(text == "3.14");
+}
+
+TEST_CASE( "Test Printer writes the text of expressions", "[printer]" ) {
+
+  REQUIRE(print(parse_text("(list 1 2.5 (list))")) == "((1) (2.5) ())");
+  REQUIRE(print(parse_text("(lambda (x) (+ x 1))")) == "((x) (+ (x) (1)))");
+  REQUIRE(print(parse_text("(f \"a\" b)")) == "(f (\"a\") (b))");
+  REQUIRE(print(Expression(Atom("NONE"))) == "NONE");
+  REQUIRE(print(Expression()) == "()");
+  REQUIRE(print(Expression(Atom(std::complex<double>(1, -2)))) == "(1,-2)");
+  REQUIRE(print(Expression::makeSequence(0, 0.5, 4)) == "((0) (0.5) (1) (1.5))");
+
+  // a head that is not a symbol has no space before its tail
+  Expression number(Atom(3.0));
+  number.append(Atom(4.0));
+  number.append(Atom(5.0));
+  REQUIRE(print(number) == "(3(4) (5))");
+
+  // the width of the stream pads the first piece only
+  std::ostringstream padded;
+  padded << std::setw(4) << parse_text("(list 1 2)") << "|";
+  REQUIRE(padded.str() == "   ((1) (2))|");
+}
+
+TEST_CASE( "Test Printer flushes and reuses its buffer", "[printer]" ) {
+
+  Expression deep = parse_text("(a (b (c (d (e 1.5 2.5 -3)))))");
+  Expression wide = parse_text("(list 0.1 0.2 0.3 0.4 0.5 0.6 0.7 0.8 0.9)");
+  REQUIRE(print(deep, 1) == print(deep));
+  REQUIRE(print(wide, 3) == print(wide));
+
+  std::ostringstream out;
+  Printer printer(out, 8);
+  printer.print(deep);
+  printer.write("\n");
+  printer.print(wide);
+  printer.flush();
+  REQUIRE(out.str() == print(deep) + "\n" + print(wide));
+
+  // deep nesting is printed without recursion
+  Expression nested(Atom(1.0));
+  for(int i = 0; i < 100000; ++i){
+    Expression outer(Atom("f"));
+    outer.append(nested);
+    nested = outer;
+  }
+  std::string text = print(nested);
+  REQUIRE(text.size() == 100000 * 4 + 3);
+  REQUIRE(text.compare(0, 8, "(f (f (f") == 0);
+
+  // destroying an expression recurses, so take it apart one level at a time
+  while(nested.tailSize() > 0){
+    Expression inner = *nested.tailConstBegin();
+    nested = inner;
+  }
+}
@@ -0,0 +1,82 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+thread_local Profiler * Profiler::t_current = nullptr;
+
+void Profiler::enter(Kind kind, SymbolId name){
+  std::uint64_t key = (static_cast<std::uint64_t>(kind) << 32) | name;
+  auto found = m_index.find(key);
+  std::size_t entry;
+  if(found == m_index.end()){
+    entry = m_totals.size();
+    m_totals.push_back({{kind, name, 0, 0.0, 0.0}, 0});
+    m_index.emplace(key, entry);
+  }
+  else{
+    entry = found->second;
+  }
+
+  ++m_totals[entry].active;
+  m_stack.push_back({entry, Clock::now(), Clock::duration::zero()});
+}
+
+void Profiler::leave() noexcept{
+  Clock::duration elapsed = Clock::now() - m_stack.back().start;
+  Frame frame = m_stack.back();
+  m_stack.pop_back();
+
+  Totals & totals = m_totals[frame.entry];
+  ++totals.entry.calls;
+  totals.entry.exclusive += std::chrono::duration<double>(elapsed - frame.children).count();
+  if(--totals.active == 0){
+    totals.entry.inclusive += std::chrono::duration<double>(elapsed).count();
+  }
+
+  if(!m_stack.empty()){
+    m_stack.back().children += elapsed;
+  }
+}
+
+std::vector<Profiler::Entry> Profiler::entries() const{
+  std::vector<Entry> result;
+  for(auto & t : m_totals){
+    result.push_back(t.entry);
+  }
+  std::stable_sort(result.begin(), result.end(), [](const Entry & a, const Entry & b){
+      return a.exclusive > b.exclusive;
+    });
+  return result;
+}
+
+void Profiler::report(std::ostream & out) const{
+  static const char * KINDS[] = {"builtin", "lambda", "special form"};
+
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::left << std::setw(24) << "name" << std::setw(14) << "kind"
+      << std::right << std::setw(10) << "calls"
+      << std::setw(16) << "inclusive ms" << std::setw(16) << "exclusive ms" << '\n';
+  for(auto & e : entries()){
+    out << std::left << std::setw(24) << SymbolTable::name(e.name) << std::setw(14) << KINDS[e.kind]
+        << std::right << std::setw(10) << e.calls << std::fixed << std::setprecision(3)
+        << std::setw(16) << e.inclusive * 1000 << std::setw(16) << e.exclusive * 1000 << '\n';
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void Profiler::clear(){
+  m_totals.clear();
+  m_index.clear();
+  m_stack.clear();
+}
+
+ProfilerScope::ProfilerScope(Profiler * profiler) noexcept: m_previous(Profiler::t_current){
+  Profiler::t_current = profiler;
+}
+
+ProfilerScope::~ProfilerScope(){
+  Profiler::t_current = m_previous;
+}
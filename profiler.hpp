@@ -0,0 +1,132 @@
+/*! \file profiler.hpp
+Defines the Profiler recording where evaluation time goes.
+ */
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "atom.hpp"
+#include "symbol_table.hpp"
+
+/*! \class Profiler
+\brief Call counts and times of the built-ins, lambdas and special forms
+called during evaluation.
+
+A Profiler is made current on a thread with a ProfilerScope, and every
+ProfiledCall made on that thread while it is current is recorded.
+Inclusive time is the time spent in a call, exclusive time leaves out the
+profiled calls made from it. The inclusive time of a recursive call is
+only counted once, by its outermost call.
+
+When no profiler is current a ProfiledCall costs one thread local load
+and a branch. Evaluations on the worker threads of a parallel map are not
+recorded, and a batch evaluated by a compiled lambda counts as one call.
+*/
+class Profiler {
+public:
+
+  /// what a profiled call calls
+  enum Kind { BUILTIN, LAMBDA, SPECIAL_FORM };
+
+  /// totals of the calls of one procedure, times are in seconds
+  struct Entry {
+    Kind kind;
+    SymbolId name;
+    std::size_t calls;
+    double inclusive;
+    double exclusive;
+  };
+
+  Profiler() = default;
+  Profiler(const Profiler &) = delete;
+  Profiler & operator=(const Profiler &) = delete;
+
+  /// the entries recorded so far, by decreasing exclusive time
+  std::vector<Entry> entries() const;
+
+  /// write a table of the entries, by decreasing exclusive time
+  void report(std::ostream & out) const;
+
+  /// forget everything recorded
+  void clear();
+
+  /// the profiler current on the calling thread, or nullptr
+  static Profiler * current() noexcept { return t_current; }
+
+private:
+
+  friend class ProfilerScope;
+  friend class ProfiledCall;
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct Frame {
+    std::size_t entry;
+    Clock::time_point start;
+    Clock::duration children;
+  };
+
+  struct Totals {
+    Entry entry;
+    // calls of this entry on the stack
+    std::size_t active;
+  };
+
+  std::vector<Totals> m_totals;
+  std::unordered_map<std::uint64_t, std::size_t> m_index;
+  std::vector<Frame> m_stack;
+
+  void enter(Kind kind, SymbolId name);
+  void leave() noexcept;
+
+  static thread_local Profiler * t_current;
+};
+
+/*! \class ProfilerScope
+\brief Makes a Profiler current on the calling thread for its lifetime.
+A nullptr profiler turns profiling off for the lifetime of the scope.
+*/
+class ProfilerScope {
+public:
+
+  explicit ProfilerScope(Profiler * profiler) noexcept;
+  ~ProfilerScope();
+
+  ProfilerScope(const ProfilerScope &) = delete;
+  ProfilerScope & operator=(const ProfilerScope &) = delete;
+
+private:
+  Profiler * m_previous;
+};
+
+/*! \class ProfiledCall
+\brief Records its lifetime as a call of name in the current Profiler, if any.
+*/
+class ProfiledCall {
+public:
+
+  ProfiledCall(Profiler::Kind kind, const Atom & name): m_profiler(Profiler::current()) {
+    if(m_profiler){
+      m_profiler->enter(kind, name.asSymbolId());
+    }
+  }
+
+  ~ProfiledCall(){
+    if(m_profiler){
+      m_profiler->leave();
+    }
+  }
+
+  ProfiledCall(const ProfiledCall &) = delete;
+  ProfiledCall & operator=(const ProfiledCall &) = delete;
+
+private:
+  Profiler * m_profiler;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "interpreter.hpp"
+#include "profiler.hpp"
+#include "semantic_error.hpp"
+
+// the entry of the profile named name, or an entry with no calls
+static Profiler::Entry find(const Profiler & profiler, Profiler::Kind kind, const std::string & name){
+  for(auto & e : profiler.entries()){
+    if((e.kind == kind) && (SymbolTable::name(e.name) == name)) return e;
+  }
+  return {kind, 0, 0, 0.0, 0.0};
+}
+
+static void evaluate(Interpreter & interp, const std::string & program){
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  interp.evaluate();
+}
+
+TEST_CASE( "Test profiling is off by default", "[profiler]" ) {
+
+  Interpreter interp;
+  REQUIRE(interp.profile() == nullptr);
+  REQUIRE(Profiler::current() == nullptr);
+
+  // without a current profiler a call records nothing
+  ProfiledCall call(Profiler::BUILTIN, Atom("+"));
+  REQUIRE(Profiler::current() == nullptr);
+}
+
+TEST_CASE( "Test profile of an evaluation", "[profiler]" ) {
+
+  Interpreter interp;
+  interp.enableProfiling(true);
+  REQUIRE(interp.profile() != nullptr);
+
+  evaluate(interp, "(begin (define f (lambda (x) (+ x 1))) (define g (lambda (x) (* 2 (f x)))) (list (g 1) (f 2)))");
+  const Profiler & profile = *interp.profile();
+  REQUIRE(Profiler::current() == nullptr);
+
+  REQUIRE(find(profile, Profiler::SPECIAL_FORM, "begin").calls == 1);
+  // lambda calls bind their parameters directly, not with a define
+  REQUIRE(find(profile, Profiler::SPECIAL_FORM, "define").calls == 2);
+  REQUIRE(find(profile, Profiler::SPECIAL_FORM, "lambda").calls == 2);
+  REQUIRE(find(profile, Profiler::LAMBDA, "f").calls == 2);
+  REQUIRE(find(profile, Profiler::LAMBDA, "g").calls == 1);
+  REQUIRE(find(profile, Profiler::BUILTIN, "+").calls == 2);
+  REQUIRE(find(profile, Profiler::BUILTIN, "*").calls == 1);
+  REQUIRE(find(profile, Profiler::BUILTIN, "list").calls == 1);
+
+  for(auto & e : profile.entries()){
+    REQUIRE(e.exclusive >= 0);
+    REQUIRE(e.exclusive <= e.inclusive * (1 + 1e-9));
+  }
+  Profiler::Entry begin = find(profile, Profiler::SPECIAL_FORM, "begin");
+  REQUIRE(begin.inclusive >= find(profile, Profiler::LAMBDA, "g").inclusive);
+
+  // entries are sorted by exclusive time
+  auto entries = profile.entries();
+  for(std::size_t i = 1; i < entries.size(); ++i){
+    REQUIRE(entries[i - 1].exclusive >= entries[i].exclusive);
+  }
+
+  std::ostringstream report;
+  profile.report(report);
+  REQUIRE(report.str().find("special form") != std::string::npos);
+
+  // the profile accumulates over evaluations, including failed ones
+  std::istringstream iss("(f (list))");
+  REQUIRE(interp.parseStream(iss));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+  REQUIRE(find(*interp.profile(), Profiler::LAMBDA, "f").calls == 3);
+
+  interp.enableProfiling(false);
+  REQUIRE(interp.profile() == nullptr);
+}
@@ -0,0 +1,131 @@
+/*! \file property_list.hpp
+Defines the PropertyList container used for the properties of an Expression.
+ */
+#ifndef PROPERTY_LIST_HPP
+#define PROPERTY_LIST_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "symbol_table.hpp"
+
+/*! \class PropertyList
+\brief A small flat map from interned keys to values.
+
+The entries are kept in a vector that is only allocated when the first
+property is set, so an empty list is a single null pointer. Keys are
+SymbolIds, plot objects use the WellKnownKey ids, and lookup is a scan of
+the few entries an object carries. Entries keep the order they were set.
+*/
+template<typename T>
+class PropertyList {
+public:
+
+  typedef std::pair<SymbolId, T> Entry;
+  typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+  /// construct an empty list, does not allocate
+  PropertyList() {}
+
+  /// copy the entries of other
+  PropertyList(const PropertyList & other):
+    m_entries(other.m_entries ? new std::vector<Entry>(*other.m_entries) : nullptr) {}
+
+  PropertyList(PropertyList && other) noexcept: m_entries(std::move(other.m_entries)) {}
+
+  PropertyList & operator=(const PropertyList & other){
+    if(this != &other){
+      PropertyList copy(other);
+      m_entries.swap(copy.m_entries);
+    }
+    return *this;
+  }
+
+  PropertyList & operator=(PropertyList && other) noexcept {
+    m_entries = std::move(other.m_entries);
+    return *this;
+  }
+
+  bool empty() const noexcept { return !m_entries || m_entries->empty(); }
+
+  std::size_t size() const noexcept { return m_entries ? m_entries->size() : 0; }
+
+  void clear() noexcept { m_entries.reset(); }
+
+  const_iterator begin() const noexcept { return entries().cbegin(); }
+  const_iterator end() const noexcept { return entries().cend(); }
+
+  /// pointer to the value of key, or nullptr if it is not set
+  const T * find(SymbolId key) const noexcept {
+    if(m_entries){
+      for(auto & e : *m_entries){
+        if(e.first == key) return &e.second;
+      }
+    }
+    return nullptr;
+  }
+
+  /// pointer to the value of the named key, or nullptr if it is not set
+  const T * find(const std::string & key) const {
+    SymbolId id;
+    return SymbolTable::lookup(key, id) ? find(id) : nullptr;
+  }
+
+  /// value of key, or a default constructed T if it is not set
+  const T & get(SymbolId key) const {
+    static const T none = T();
+    const T * value = find(key);
+    return value ? *value : none;
+  }
+
+  /// value of key, inserting a default constructed T if it is not set
+  T & operator[](SymbolId key){
+    if(!m_entries){
+      m_entries.reset(new std::vector<Entry>);
+    }
+    for(auto & e : *m_entries){
+      if(e.first == key) return e.second;
+    }
+    m_entries->emplace_back(key, T());
+    return m_entries->back().second;
+  }
+
+  /// value of the named key, inserting a default constructed T if it is not set
+  T & operator[](const std::string & key){
+    return (*this)[SymbolTable::intern(key)];
+  }
+
+  /// call f on each value in order, allowing it to be modified
+  template<typename F>
+  void forEachValue(F f){
+    if(m_entries){
+      for(auto & e : *m_entries){
+        f(e.second);
+      }
+    }
+  }
+
+  /// true if both lists have the same keys with equal values, in any order
+  bool operator==(const PropertyList & other) const {
+    if(size() != other.size()) return false;
+    for(auto & e : *this){
+      const T * value = other.find(e.first);
+      if(!value || !(*value == e.second)) return false;
+    }
+    return true;
+  }
+
+private:
+
+  std::unique_ptr<std::vector<Entry>> m_entries;
+
+  const std::vector<Entry> & entries() const noexcept {
+    static const std::vector<Entry> none;
+    return m_entries ? *m_entries : none;
+  }
+};
+
+#endif
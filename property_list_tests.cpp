@@ -0,0 +1,64 @@
+#include "catch.hpp"
+
+#include "property_list.hpp"
+#include "symbol_table.hpp"
+
+#include <string>
+
+TEST_CASE( "Test SymbolTable interning", "[property_list]" ) {
+
+  REQUIRE(SymbolTable::intern("\"object-name\"") == OBJECT_NAME_KEY);
+  REQUIRE(SymbolTable::intern("\"text-rotation\"") == TEXT_ROTATION_KEY);
+  REQUIRE(SymbolTable::name(SIZE_KEY) == "\"size\"");
+
+  SymbolId id = SymbolTable::intern("\"property-list-test\"");
+  REQUIRE(id >= WELL_KNOWN_KEY_COUNT);
+  REQUIRE(SymbolTable::intern("\"property-list-test\"") == id);
+  REQUIRE(SymbolTable::name(id) == "\"property-list-test\"");
+
+  SymbolId found;
+  REQUIRE(SymbolTable::lookup("\"property-list-test\"", found));
+  REQUIRE(found == id);
+  REQUIRE(!SymbolTable::lookup("\"never-interned\"", found));
+}
+
+TEST_CASE( "Test PropertyList set and find", "[property_list]" ) {
+
+  PropertyList<int> props;
+  REQUIRE(props.empty());
+  REQUIRE(props.find(SIZE_KEY) == nullptr);
+  REQUIRE(props.get(SIZE_KEY) == 0);
+
+  props[SIZE_KEY] = 2;
+  props["\"thickness\""] = 3;
+  props[SIZE_KEY] = 4;
+
+  REQUIRE(props.size() == 2);
+  REQUIRE(*props.find(SIZE_KEY) == 4);
+  REQUIRE(*props.find("\"thickness\"") == 3);
+  REQUIRE(props.find("\"no-such-key\"") == nullptr);
+
+  PropertyList<int> copy(props);
+  copy[SIZE_KEY] = 5;
+  REQUIRE(props.get(SIZE_KEY) == 4);
+  REQUIRE(copy.get(SIZE_KEY) == 5);
+
+  props.clear();
+  REQUIRE(props.empty());
+}
+
+TEST_CASE( "Test PropertyList equality ignores order", "[property_list]" ) {
+
+  PropertyList<int> a, b;
+  a[SIZE_KEY] = 1;
+  a[POSITION_KEY] = 2;
+  b[POSITION_KEY] = 2;
+  b[SIZE_KEY] = 1;
+  REQUIRE(a == b);
+
+  b[SIZE_KEY] = 3;
+  REQUIRE(!(a == b));
+
+  b[OBJECT_NAME_KEY] = 0;
+  REQUIRE(!(a == b));
+}
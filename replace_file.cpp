@@ -0,0 +1,20 @@
+#include "replace_file.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+std::string temporaryPath(const std::string & path){
+  std::random_device random;
+  return path + "." + std::to_string(random()) + ".tmp";
+}
+
+bool replaceFile(const std::string & temporary, const std::string & path){
+  if(std::rename(temporary.c_str(), path.c_str()) == 0) return true;
+
+  // renaming over an existing file fails on some platforms, but path is
+  // only removed when there is a temporary to take its place
+  if(!std::ifstream(temporary)) return false;
+  std::remove(path.c_str());
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,26 @@
+/*! \file replace_file.hpp
+Defines the helpers writing a file by renaming a temporary over it, so a
+reader of the file sees either the old contents or the new, never a
+partly written file.
+ */
+#ifndef REPLACE_FILE_HPP
+#define REPLACE_FILE_HPP
+
+#include <string>
+
+/*! \fn temporaryPath
+\brief A name for a temporary file next to path, unique to the caller so
+concurrent writers of the same path do not mix.
+*/
+std::string temporaryPath(const std::string & path);
+
+/*! \fn replaceFile
+\brief Rename the file at temporary to path, replacing any file there.
+
+\param temporary the complete new file, usually named by temporaryPath
+\param path the file to replace
+\return false if the file could not be renamed, temporary is then left
+ */
+bool replaceFile(const std::string & temporary, const std::string & path);
+
+#endif
@@ -0,0 +1,44 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "replace_file.hpp"
+
+static void write(const std::string & path, const std::string & text){
+  std::ofstream ofs(path);
+  ofs << text;
+}
+
+static std::string read(const std::string & path){
+  std::ifstream ifs(path);
+  std::stringstream text;
+  text << ifs.rdbuf();
+  return text.str();
+}
+
+TEST_CASE( "Test replacing a file with a temporary", "[replace_file]" ) {
+
+  std::string path = "replace_file_tests.txt";
+  std::string first = temporaryPath(path);
+  std::string second = temporaryPath(path);
+  REQUIRE(first != second);
+  REQUIRE(first.compare(0, path.size(), path) == 0);
+
+  write(first, "first");
+  REQUIRE(replaceFile(first, path));
+  REQUIRE(read(path) == "first");
+
+  // an existing file is replaced
+  write(second, "second");
+  REQUIRE(replaceFile(second, path));
+  REQUIRE(read(path) == "second");
+  REQUIRE_FALSE(std::ifstream(second).good());
+
+  // without a temporary the file is kept
+  REQUIRE_FALSE(replaceFile(second, path));
+  REQUIRE(read(path) == "second");
+  REQUIRE(std::remove(path.c_str()) == 0);
+}
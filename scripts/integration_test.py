@@ -54,6 +54,12 @@ class TestExecuteCommandline(unittest.TestCase):
                 self.assertNotEqual(retcode, 0)
                 self.assertTrue(output.strip().startswith(b'Error'))
 
+        def test_parse_error(self):
+                args = ' -e ' + ' "(+ 1 a) )" '
+                (output, retcode) = pexpect.run(cmd+args, withexitstatus=True, extra_args=args)
+                self.assertNotEqual(retcode, 0)
+                self.assertIn(b"Invalid Program. Could not parse.", output)
+
 class TestExecuteFromFile(unittest.TestCase):
                 
         def test_unix(self):
@@ -0,0 +1,449 @@
+#include "serialize.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// the kind of a node's head, in the low bits of its tag. A run is not a
+// node but stands for several numbers in a tail.
+enum Kind : unsigned char { NONE_KIND, NUMBER_KIND, COMPLEX_KIND, SYMBOL_KIND, INTEGER_KIND, FLOAT_KIND, RUN_KIND };
+
+const unsigned char KIND_MASK = 0x0f;
+
+// set in the tag of a node with a tail, or with properties
+const unsigned char TAIL_FLAG = 0x10;
+const unsigned char PROPERTIES_FLAG = 0x20;
+
+// fewest numbers in a row written as a run
+const std::size_t RUN_MINIMUM = 4;
+
+// alignment of runs and of the size of an encoding
+const std::size_t ALIGNMENT = 8;
+
+// largest magnitude written as an integer, all integers up to it are exact doubles
+const double INTEGER_LIMIT = 9007199254740992.0;
+
+// deepest nesting decoded, deeper input is rejected rather than overflowing the stack
+const std::size_t MAX_DEPTH = 10000;
+
+bool little_endian() noexcept{
+  const std::uint16_t probe = 1;
+  unsigned char first;
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+// true if value is written as an integer, -0 is not so it keeps its sign
+bool is_integer(double value) noexcept{
+  return (value == std::trunc(value)) && (std::fabs(value) <= INTEGER_LIMIT) &&
+    !((value == 0) && std::signbit(value));
+}
+
+// true if value is written as a float, which holds it exactly
+bool is_float(double value) noexcept{
+  return (std::fabs(value) <= FLT_MAX) && (static_cast<double>(static_cast<float>(value)) == value);
+}
+
+// true if exp is written as part of a run
+bool is_plain_number(const Expression & exp) noexcept{
+  return exp.head().isNumber() && (exp.tailSize() == 0) && exp.prop().empty();
+}
+
+void put_varint(std::uint64_t value, std::string & out){
+  while(value >= 0x80){
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void put_double(double value, std::string & out){
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for(int i = 0; i < 8; ++i){
+    out.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+  }
+}
+
+void put_float(float value, std::string & out){
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for(int i = 0; i < 4; ++i){
+    out.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+  }
+}
+
+bool get_varint(const char *& data, const char * end, std::uint64_t & value){
+  value = 0;
+  for(int shift = 0; (shift < 64) && (data < end); shift += 7){
+    unsigned char byte = static_cast<unsigned char>(*data++);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+bool get_double(const char *& data, const char * end, double & value){
+  if(end - data < 8) return false;
+  std::uint64_t bits = 0;
+  for(int i = 0; i < 8; ++i){
+    bits |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+  }
+  std::memcpy(&value, &bits, sizeof(value));
+  data += 8;
+  return true;
+}
+
+bool get_float(const char *& data, const char * end, float & value){
+  if(end - data < 4) return false;
+  std::uint32_t bits = 0;
+  for(int i = 0; i < 4; ++i){
+    bits |= static_cast<std::uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+  }
+  std::memcpy(&value, &bits, sizeof(value));
+  data += 4;
+  return true;
+}
+
+// true if count items of at least size bytes each fit before end
+bool fits(const char * data, const char * end, std::uint64_t count, std::size_t size = 1) noexcept{
+  return count <= static_cast<std::uint64_t>(end - data) / size;
+}
+
+// skip the zeros aligning data to ALIGNMENT bytes from start
+bool skip_padding(const char *& data, const char * start, const char * end){
+  std::size_t padding = (ALIGNMENT - static_cast<std::size_t>(data - start) % ALIGNMENT) % ALIGNMENT;
+  if(!fits(data, end, padding)) return false;
+  for(std::size_t i = 0; i < padding; ++i){
+    if(*data++ != 0) return false;
+  }
+  return true;
+}
+
+class Encoder {
+public:
+  explicit Encoder(std::string & out): m_out(out), m_start(out.size()) {}
+
+  void encode(const Expression & exp){
+    collect(exp);
+    put_varint(m_symbols.size(), m_out);
+    for(const std::string & name : m_symbols){
+      put_varint(name.size(), m_out);
+      m_out.append(name);
+    }
+    node(exp);
+    pad();
+  }
+
+private:
+  std::string & m_out;
+  std::size_t m_start;
+
+  // the symbols, string literals and property keys in order of first
+  // use, and the index of each
+  std::vector<std::string> m_symbols;
+  std::unordered_map<std::string, std::uint64_t> m_index;
+
+  // numbers of the tail being written that are not written yet
+  std::vector<double> m_run;
+
+  void symbol(const std::string & name){
+    if(m_index.emplace(name, m_symbols.size()).second){
+      m_symbols.push_back(name);
+    }
+  }
+
+  void collect(const Expression & exp){
+    if(exp.head().isSymbol()){
+      symbol(exp.head().symbolName());
+    }
+    exp.forEachTail([this](const Expression & e){ collect(e); });
+    for(auto & entry : exp.prop()){
+      symbol(SymbolTable::name(entry.first));
+      collect(entry.second);
+    }
+  }
+
+  void pad(){
+    while((m_out.size() - m_start) % ALIGNMENT != 0){
+      m_out.push_back(0);
+    }
+  }
+
+  void number(double value, unsigned char flags){
+    if(is_integer(value)){
+      std::int64_t integer = static_cast<std::int64_t>(value);
+      m_out.push_back(static_cast<char>(INTEGER_KIND | flags));
+      put_varint((static_cast<std::uint64_t>(integer) << 1) ^ static_cast<std::uint64_t>(integer >> 63), m_out);
+    }
+    else if(is_float(value)){
+      m_out.push_back(static_cast<char>(FLOAT_KIND | flags));
+      put_float(static_cast<float>(value), m_out);
+    }
+    else{
+      m_out.push_back(static_cast<char>(NUMBER_KIND | flags));
+      put_double(value, m_out);
+    }
+  }
+
+  // write the pending numbers, as a run if there are enough of them
+  void flush(){
+    if(m_run.size() >= RUN_MINIMUM){
+      m_out.push_back(RUN_KIND);
+      put_varint(m_run.size(), m_out);
+      pad();
+      if(little_endian()){
+        m_out.append(reinterpret_cast<const char *>(m_run.data()), m_run.size() * sizeof(double));
+      }
+      else{
+        for(double value : m_run){
+          put_double(value, m_out);
+        }
+      }
+    }
+    else{
+      for(double value : m_run){
+        number(value, 0);
+      }
+    }
+    m_run.clear();
+  }
+
+  void node(const Expression & exp){
+    unsigned char flags = 0;
+    if(exp.tailSize() > 0) flags |= TAIL_FLAG;
+    if(!exp.prop().empty()) flags |= PROPERTIES_FLAG;
+
+    const Atom & head = exp.head();
+    if(head.isNumber()){
+      number(head.asNumber(), flags);
+    }
+    else if(head.isComplex()){
+      m_out.push_back(static_cast<char>(COMPLEX_KIND | flags));
+      put_double(head.asComplex().real(), m_out);
+      put_double(head.asComplex().imag(), m_out);
+    }
+    else if(head.isSymbol()){
+      m_out.push_back(static_cast<char>(SYMBOL_KIND | flags));
+      put_varint(m_index[head.symbolName()], m_out);
+    }
+    else{
+      m_out.push_back(static_cast<char>(NONE_KIND | flags));
+    }
+
+    if(flags & TAIL_FLAG){
+      put_varint(exp.tailSize(), m_out);
+      exp.forEachTail([this](const Expression & e){
+          if(is_plain_number(e)){
+            m_run.push_back(e.head().asNumber());
+          }
+          else{
+            flush();
+            node(e);
+          }
+        });
+      flush();
+    }
+
+    if(flags & PROPERTIES_FLAG){
+      put_varint(exp.prop().size(), m_out);
+      for(auto & entry : exp.prop()){
+        put_varint(m_index[SymbolTable::name(entry.first)], m_out);
+        node(entry.second);
+      }
+    }
+  }
+};
+
+class Decoder {
+public:
+  Decoder(const char *& data, const char * end): m_data(data), m_start(data), m_end(end) {}
+
+  bool decode(Expression & exp){
+    std::uint64_t count;
+    if(!get_varint(m_data, m_end, count) || !fits(m_data, m_end, count)) return false;
+    m_symbols.reserve(static_cast<std::size_t>(count));
+    for(std::uint64_t i = 0; i < count; ++i){
+      std::uint64_t size;
+      if(!get_varint(m_data, m_end, size) || !fits(m_data, m_end, size)) return false;
+      m_symbols.push_back(Atom(std::string(m_data, static_cast<std::size_t>(size))));
+      m_data += size;
+    }
+    return node(exp, 0) && skip_padding(m_data, m_start, m_end);
+  }
+
+private:
+  const char *& m_data;
+  const char * m_start;
+  const char * m_end;
+
+  // the symbols of the table at the start of the encoding
+  std::vector<Atom> m_symbols;
+
+  bool symbol(Atom & atom){
+    std::uint64_t index;
+    if(!get_varint(m_data, m_end, index) || (index >= m_symbols.size())) return false;
+    atom = m_symbols[static_cast<std::size_t>(index)];
+    return true;
+  }
+
+  // append a run of at most limit numbers to exp, counting them in count
+  bool run(Expression & exp, std::uint64_t limit, std::uint64_t & count){
+    if(!get_varint(m_data, m_end, count) || (count < RUN_MINIMUM) || (count > limit)) return false;
+    if(!skip_padding(m_data, m_start, m_end) || !fits(m_data, m_end, count, sizeof(double))) return false;
+    for(std::uint64_t i = 0; i < count; ++i){
+      double value;
+      get_double(m_data, m_end, value);
+      exp.append(Atom(value));
+    }
+    return true;
+  }
+
+  bool node(Expression & exp, std::size_t depth){
+    if((m_data >= m_end) || (depth > MAX_DEPTH)) return false;
+
+    unsigned char tag = static_cast<unsigned char>(*m_data++);
+    if(tag & ~(KIND_MASK | TAIL_FLAG | PROPERTIES_FLAG)) return false;
+
+    switch(tag & KIND_MASK){
+    case NUMBER_KIND:{
+      double value;
+      if(!get_double(m_data, m_end, value)) return false;
+      exp = Expression(Atom(value));
+      break;
+    }
+    case INTEGER_KIND:{
+      std::uint64_t bits;
+      if(!get_varint(m_data, m_end, bits)) return false;
+      std::int64_t integer = static_cast<std::int64_t>(bits >> 1) ^ -static_cast<std::int64_t>(bits & 1);
+      exp = Expression(Atom(static_cast<double>(integer)));
+      break;
+    }
+    case FLOAT_KIND:{
+      float value;
+      if(!get_float(m_data, m_end, value)) return false;
+      exp = Expression(Atom(static_cast<double>(value)));
+      break;
+    }
+    case COMPLEX_KIND:{
+      double real, imag;
+      if(!get_double(m_data, m_end, real) || !get_double(m_data, m_end, imag)) return false;
+      exp = Expression(Atom(std::complex<double>(real, imag)));
+      break;
+    }
+    case SYMBOL_KIND:{
+      Atom atom;
+      if(!symbol(atom)) return false;
+      exp = Expression(atom);
+      break;
+    }
+    case NONE_KIND:
+      exp = Expression();
+      break;
+    default:
+      return false;
+    }
+
+    if(tag & TAIL_FLAG){
+      // every expression takes at least a byte, which bounds a valid count
+      std::uint64_t count;
+      if(!get_varint(m_data, m_end, count) || (count == 0) || !fits(m_data, m_end, count)) return false;
+      for(std::uint64_t i = 0; i < count;){
+        if((m_data < m_end) && (*m_data == RUN_KIND)){
+          ++m_data;
+          std::uint64_t numbers;
+          if(!run(exp, count - i, numbers)) return false;
+          i += numbers;
+        }
+        else{
+          Expression child;
+          if(!node(child, depth + 1)) return false;
+          exp.append(child);
+          ++i;
+        }
+      }
+    }
+
+    if(tag & PROPERTIES_FLAG){
+      std::uint64_t count;
+      if(!get_varint(m_data, m_end, count) || (count == 0) || !fits(m_data, m_end, count)) return false;
+      for(std::uint64_t i = 0; i < count; ++i){
+        Atom key;
+        Expression value;
+        if(!symbol(key) || !node(value, depth + 1)) return false;
+        exp.prop()[key.symbolName()] = value;
+      }
+    }
+    return true;
+  }
+};
+
+}
+
+void serialize(const Expression & exp, std::string & out){
+  Encoder(out).encode(exp);
+}
+
+bool deserialize(const char *& data, const char * end, Expression & exp){
+  try{
+    return Decoder(data, end).decode(exp);
+  }
+  catch(const std::length_error &){
+    // the symbol table is full
+    return false;
+  }
+}
+
+bool serializedNumbers(const char * data, const char * end, const double *& numbers, std::size_t & count){
+  if(!little_endian() || (reinterpret_cast<std::uintptr_t>(data) % ALIGNMENT != 0)) return false;
+  const char * start = data;
+
+  std::uint64_t symbols;
+  if(!get_varint(data, end, symbols)) return false;
+  for(std::uint64_t i = 0; i < symbols; ++i){
+    std::uint64_t size;
+    if(!get_varint(data, end, size) || !fits(data, end, size)) return false;
+    data += size;
+  }
+
+  if(data >= end) return false;
+  unsigned char tag = static_cast<unsigned char>(*data++);
+  if((tag & ~KIND_MASK) != TAIL_FLAG) return false;
+
+  std::uint64_t skipped;
+  double ignored;
+  float ignored_float;
+  switch(tag & KIND_MASK){
+  case NONE_KIND:
+    break;
+  case SYMBOL_KIND:
+  case INTEGER_KIND:
+    if(!get_varint(data, end, skipped)) return false;
+    break;
+  case NUMBER_KIND:
+    if(!get_double(data, end, ignored)) return false;
+    break;
+  case FLOAT_KIND:
+    if(!get_float(data, end, ignored_float)) return false;
+    break;
+  case COMPLEX_KIND:
+    if(!get_double(data, end, ignored) || !get_double(data, end, ignored)) return false;
+    break;
+  default:
+    return false;
+  }
+
+  std::uint64_t total, run;
+  if(!get_varint(data, end, total) || (data >= end) || (*data++ != RUN_KIND)) return false;
+  if(!get_varint(data, end, run) || (run != total) || (run < RUN_MINIMUM)) return false;
+  if(!skip_padding(data, start, end) || !fits(data, end, run, sizeof(double))) return false;
+
+  numbers = reinterpret_cast<const double *>(data);
+  count = static_cast<std::size_t>(run);
+  return true;
+}
@@ -0,0 +1,65 @@
+/*! \file serialize.hpp
+Defines the binary encoding of Expression trees.
+ */
+#ifndef SERIALIZE_HPP
+#define SERIALIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "expression.hpp"
+
+/// version of the binary encoding, changed whenever the encoding changes
+const std::uint32_t SERIAL_VERSION = 2;
+
+/*! \fn serialize
+\brief Append the binary encoding of an expression to out.
+
+The encoding starts with a table of the names of the symbols used in the
+expression, so each name is written once and nodes refer to it by index.
+Each node is then a tag byte for the kind of its head and for whether it
+has a tail and properties, the head value, the tail and the properties as
+pairs of a key and a value. Numbers with an integer value are written as
+variable length integers, others as little endian IEEE floats when that
+keeps their value and as doubles otherwise.
+
+Four or more numbers in a row in a tail are written as a packed run of
+doubles aligned to 8 bytes from the start of the encoding, and the
+encoding is padded with zeros to a multiple of 8 bytes. Encodings written
+one after the other into a buffer aligned to 8 bytes, such as a mapped
+file, keep their runs aligned, so serializedNumbers can read a run in
+place. The encoding does not depend on the platform.
+
+\param exp the expression to encode, with its properties
+\param out the string the encoding is appended to
+ */
+void serialize(const Expression & exp, std::string & out);
+
+/*! \fn deserialize
+\brief Decode one expression encoded by serialize.
+
+\param data the first byte of the encoding, advanced past it on success
+\param end one past the last byte that may be read
+\param exp set to the decoded expression
+\return false if the bytes are not a valid encoding or their symbols do not
+fit in the symbol table, data is then unspecified
+ */
+bool deserialize(const char *& data, const char * end, Expression & exp);
+
+/*! \fn serializedNumbers
+\brief Read the numbers of an encoded list in place, without decoding it.
+
+This succeeds when the expression encoded at data has no properties and
+its whole tail is one packed run of numbers, the platform is little endian
+and the run is aligned to 8 bytes, as it is when data is.
+
+\param data the first byte of the encoding, which is not advanced
+\param end one past the last byte that may be read
+\param numbers set to the first number of the run, which lives in the encoding
+\param count set to the number of numbers in the run
+\return true if numbers and count were set
+ */
+bool serializedNumbers(const char * data, const char * end, const double *& numbers, std::size_t & count);
+
+#endif
@@ -0,0 +1,150 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "serialize.hpp"
+#include "test_helpers.hpp"
+
+static Expression round_trip(const Expression & exp){
+  std::string bytes;
+  serialize(exp, bytes);
+  const char * data = bytes.data();
+  Expression result;
+  REQUIRE(deserialize(data, bytes.data() + bytes.size(), result));
+  REQUIRE(data == bytes.data() + bytes.size());
+  return result;
+}
+
+TEST_CASE( "Test serialize round trip", "[serialize]" ) {
+
+  std::string programs[] = {
+    "(begin (define a 1) (define b (+ a I)) (list a b \"a string\" -2.5e-300))",
+    "(lambda (x y) (/ (sqrt x) (^ y 3)))",
+    "(f)",
+  };
+  for(auto & program : programs){
+    Expression exp = parse_text(program);
+    REQUIRE(round_trip(exp) == exp);
+  }
+
+  REQUIRE(round_trip(Expression()) == Expression());
+  REQUIRE(round_trip(Expression(Atom(std::complex<double>(1.5, -2)))) == Expression(Atom(std::complex<double>(1.5, -2))));
+  REQUIRE(round_trip(Expression::makeSequence(0, 1, 100)) == Expression::makeSequence(0, 1, 100));
+
+  // several expressions decode one after the other
+  std::string bytes;
+  serialize(parse_text("(+ 1 2)"), bytes);
+  serialize(parse_text("(- 1 2)"), bytes);
+  const char * data = bytes.data();
+  const char * end = data + bytes.size();
+  Expression first, second;
+  REQUIRE(deserialize(data, end, first));
+  REQUIRE(deserialize(data, end, second));
+  REQUIRE(data == end);
+  REQUIRE(first == parse_text("(+ 1 2)"));
+  REQUIRE(second == parse_text("(- 1 2)"));
+}
+
+TEST_CASE( "Test deserialize rejects invalid bytes", "[serialize]" ) {
+
+  std::string bytes;
+  serialize(parse_text("(define a (list 1 2 \"three\"))"), bytes);
+
+  // every truncation is rejected
+  for(std::size_t size = 0; size < bytes.size(); ++size){
+    const char * data = bytes.data();
+    Expression exp;
+    REQUIRE_FALSE(deserialize(data, bytes.data() + size, exp));
+  }
+
+  // a number has no symbols, so its tag is the second byte
+  std::string unknown_tag;
+  serialize(Expression(Atom(1.5)), unknown_tag);
+  unknown_tag[1] = 0x4f;
+  const char * data = unknown_tag.data();
+  Expression exp;
+  REQUIRE_FALSE(deserialize(data, data + unknown_tag.size(), exp));
+
+  // the padding must be zeros
+  std::string padding;
+  serialize(Expression(Atom(1.0)), padding);
+  padding.back() = 1;
+  data = padding.data();
+  REQUIRE_FALSE(deserialize(data, data + padding.size(), exp));
+}
+
+TEST_CASE( "Test serialize keeps properties and numbers", "[serialize]" ) {
+
+  Expression point = parse_text("(list 1 2)");
+  point.prop()["\"object-name\""] = Expression(Atom("\"point\""));
+  point.prop()["\"size\""] = Expression(Atom(0.5));
+  Expression nested = parse_text("(list 3)");
+  nested.prop()["\"size\""] = point;
+  for(auto & exp : {point, nested}){
+    Expression result = round_trip(exp);
+    REQUIRE(result == exp);
+    REQUIRE(result.prop() == exp.prop());
+  }
+
+  // integers, doubles, signed zeros and large values keep their exact value
+  double numbers[] = {0, -0.0, 1, -1, 0.1, 0.5, -3.25e10, 1e-40, -2.5e-300, 1e300, 9007199254740992.0, -9007199254740993.0, 123456789};
+  for(double number : numbers){
+    Expression result = round_trip(Expression(Atom(number)));
+    double value = result.head().asNumber();
+    REQUIRE(std::memcmp(&number, &value, sizeof(double)) == 0);
+  }
+
+  // runs of numbers mixed with other expressions, shorter ones are not packed
+  std::string programs[] = {
+    "(list 0.5 1.5 2.5 3.5 4.5 a 5.5 6.5 (f 7.5 8.5 9.5 10.5) 11.5 12.5 13.5 14.5 15.5)",
+    "(list 0.5 1.5 2.5)",
+    "(list (list 0.25 0.5) 0.75 1 1.25 1.5)",
+  };
+  for(auto & program : programs){
+    Expression exp = parse_text(program);
+    REQUIRE(round_trip(exp) == exp);
+  }
+
+  // each symbol is written once, and every encoding is a multiple of 8 bytes
+  std::string once, twice;
+  serialize(parse_text("(+ 1 a_long_symbol_name)"), once);
+  serialize(parse_text("(+ a_long_symbol_name a_long_symbol_name)"), twice);
+  REQUIRE(twice.size() == once.size());
+  REQUIRE(once.size() % 8 == 0);
+}
+
+TEST_CASE( "Test serializedNumbers reads a run in place", "[serialize]" ) {
+
+  Expression exp;
+  for(unsigned i = 0; i < 100; ++i){
+    exp.append(Atom(i + 0.5));
+  }
+  Expression small = parse_text("(a)");
+  small.prop()["\"size\""] = Expression(Atom(1.0));
+
+  // a buffer of doubles is aligned, the second encoding follows the first
+  std::string bytes;
+  serialize(small, bytes);
+  std::size_t offset = bytes.size();
+  serialize(exp, bytes);
+  std::vector<double> aligned(bytes.size() / sizeof(double));
+  std::memcpy(aligned.data(), bytes.data(), bytes.size());
+  const char * begin = reinterpret_cast<const char *>(aligned.data());
+  const char * end = begin + bytes.size();
+
+  const double * numbers = nullptr;
+  std::size_t count = 0;
+  REQUIRE_FALSE(serializedNumbers(begin, end, numbers, count));
+  REQUIRE(serializedNumbers(begin + offset, end, numbers, count));
+  REQUIRE(count == 100);
+  REQUIRE(numbers[0] == 0.5);
+  REQUIRE(numbers[99] == 99.5);
+  // compared as addresses, Catch would print char pointers as strings
+  REQUIRE(static_cast<const void *>(numbers) > static_cast<const void *>(begin + offset));
+  REQUIRE(static_cast<const void *>(numbers + count) <= static_cast<const void *>(end));
+
+  // truncated runs are not read
+  REQUIRE_FALSE(serializedNumbers(begin + offset, end - 8, numbers, count));
+}
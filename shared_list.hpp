@@ -0,0 +1,342 @@
+/*! \file shared_list.hpp
+Defines the SharedList container used for the tail of an Expression.
+ */
+#ifndef SHARED_LIST_HPP
+#define SHARED_LIST_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+
+/*! \class SharedList
+\brief An implicitly shared, copy-on-write view of a vector.
+
+A SharedList is an (offset, length) view into a reference counted buffer.
+Copies share the buffer, so copying is O(1), and dropping the first
+element (rest) is O(1) by moving the offset.
+
+Each buffer counts the views ending at each of its slots. Appending to a
+view pushes into the buffer's spare capacity in place when no other view
+extends past it, first dropping elements past the view that only views
+already gone could see, so repeated appends are amortized O(1) even when
+the list is shared and no hidden element outlives its views. Otherwise
+the view is copied into a new buffer with room to grow.
+
+Read access through a const SharedList never copies. Non-const element
+access and non-const iterators detach first (copy-on-write), so a view
+that shares its buffer gets a private copy of its own elements before
+they can be modified. Copies are shallow, elements are copied with their
+own copy constructors.
+
+Buffers are allocated with an ArenaAllocator, so a list built while an
+Arena is current lives in that arena until it is promoted. A shared
+buffer is appended to in place only from the thread of its own arena,
+never on the heap, so a shared heap list is copied into the current
+arena on its first append.
+*/
+template<typename T>
+class SharedList {
+public:
+
+  typedef std::vector<T, ArenaAllocator<T>> vector_type;
+  typedef typename vector_type::const_iterator const_iterator;
+  typedef typename vector_type::iterator iterator;
+
+  /// construct an empty list, does not allocate
+  SharedList(): m_offset(0), m_length(0) {}
+
+  /// construct a list owning the given elements
+  explicit SharedList(std::vector<T> && items): m_offset(0), m_length(items.size()) {
+    if(m_length > 0){
+      m_buffer = make_buffer(Arena::current(), m_length);
+      m_buffer->items.insert(m_buffer->items.end(),
+        std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+      hold();
+    }
+  }
+
+  SharedList(const SharedList & other) noexcept:
+    m_buffer(other.m_buffer), m_offset(other.m_offset), m_length(other.m_length) {
+    hold();
+  }
+
+  SharedList(SharedList && other) noexcept:
+    m_buffer(std::move(other.m_buffer)), m_offset(other.m_offset), m_length(other.m_length) {
+    other.m_offset = 0;
+    other.m_length = 0;
+  }
+
+  SharedList & operator=(const SharedList & other) noexcept {
+    SharedList copy(other);
+    swap(copy);
+    return *this;
+  }
+
+  SharedList & operator=(SharedList && other) noexcept {
+    SharedList moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  ~SharedList(){ letGo(); }
+
+  void swap(SharedList & other) noexcept {
+    m_buffer.swap(other.m_buffer);
+    std::swap(m_offset, other.m_offset);
+    std::swap(m_length, other.m_length);
+  }
+
+  std::size_t size() const noexcept { return m_length; }
+
+  bool empty() const noexcept { return m_length == 0; }
+
+  const_iterator begin() const noexcept { return items().cbegin() + m_offset; }
+  const_iterator end() const noexcept { return begin() + m_length; }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+
+  iterator begin() { detach(); return mutable_items().begin() + m_offset; }
+  iterator end() { detach(); return mutable_items().begin() + m_offset + m_length; }
+
+  const T & operator[](std::size_t i) const { return items()[m_offset + i]; }
+  T & operator[](std::size_t i) { detach(); return mutable_items()[m_offset + i]; }
+
+  const T & front() const { return (*this)[0]; }
+  const T & back() const { return (*this)[m_length - 1]; }
+  T & back() { detach(); return mutable_items()[m_offset + m_length - 1]; }
+
+  /// view of all but the first element, sharing the buffer
+  SharedList rest() const {
+    SharedList result(*this);
+    if(result.m_length > 0){
+      ++result.m_offset;
+      --result.m_length;
+    }
+    if(result.m_length == 0){
+      result.clear();
+    }
+    return result;
+  }
+
+  /*! Append an element, in place when no other view extends past this
+    one. A shared heap buffer is never appended to in place, a slot past
+    the views promote sees could hold an element from an arena after the
+    arena is reset, so the view grows into a new buffer instead.
+   */
+  void push_back(const T & value){
+    if(m_buffer && !local()){
+      grow(value);
+      return;
+    }
+    if(m_buffer && (m_buffer.use_count() == 1)){
+      // sole owner, trim anything past the view and push directly
+      detach();
+      if(m_buffer->items.size() < m_buffer->items.capacity()){
+        m_buffer->items.push_back(value);
+        extend();
+        return;
+      }
+    }
+    else if(m_buffer){
+      std::lock_guard<std::mutex> lock(m_buffer->mutex);
+      if(reclaim()){
+        m_buffer->items.push_back(value);
+        extend();
+        return;
+      }
+    }
+    grow(value);
+  }
+
+  void emplace_back(const T & value){ push_back(value); }
+
+  /// make room for n elements in a private buffer
+  void reserve(std::size_t n){
+    if(n <= m_length) return;
+    unshare(n);
+  }
+
+  /// drop this view, the buffer is released when no view remains
+  void clear() noexcept {
+    letGo();
+    m_buffer.reset();
+    m_offset = 0;
+    m_length = 0;
+  }
+
+  /// true when both are views of the same elements of the same buffer
+  bool sameAs(const SharedList & other) const noexcept {
+    return (m_buffer == other.m_buffer) && (m_offset == other.m_offset) && (m_length == other.m_length);
+  }
+
+  /// true when no other view shares the buffer
+  bool unique() const noexcept { return !m_buffer || (m_buffer.use_count() == 1); }
+
+  /// true when the buffer was allocated for an arena
+  bool inArena() const noexcept { return m_buffer && (m_buffer->items.get_allocator().arena() != nullptr); }
+
+  /*! Move this view to the heap if its buffer belongs to an arena, then
+    call promote_element on each element so nested lists can do the same.
+    Elements are promoted in place, even in a buffer shared with others.
+   */
+  template<typename F>
+  void promote(F promote_element){
+    if(!m_buffer) return;
+    if(inArena()){
+      std::shared_ptr<Buffer> buffer = make_buffer(nullptr, m_length);
+      auto first = m_buffer->items.cbegin() + m_offset;
+      buffer->items.insert(buffer->items.end(), first, first + m_length);
+      attach(buffer);
+    }
+    for(std::size_t i = 0; i < m_length; ++i){
+      promote_element(m_buffer->items[m_offset + i]);
+    }
+  }
+
+private:
+
+  typedef std::atomic<std::size_t> Count;
+
+  /*! Elements with a fixed capacity, and for each slot i up to the
+    capacity the number of views ending at i, that is with offset plus
+    length equal to i.
+   */
+  struct Buffer {
+    Buffer(const ArenaAllocator<T> & allocator, std::size_t capacity): items(allocator) {
+      items.reserve(capacity);
+      slots = items.capacity() + 1;
+      ends = ArenaAllocator<Count>(allocator).allocate(slots);
+      for(std::size_t i = 0; i < slots; ++i){
+        new (ends + i) Count(0);
+      }
+    }
+    ~Buffer(){
+      ArenaAllocator<Count>(items.get_allocator()).deallocate(ends, slots);
+    }
+    Buffer(const Buffer &) = delete;
+    Buffer & operator=(const Buffer &) = delete;
+
+    std::mutex mutex;
+    vector_type items;
+    Count * ends;
+    std::size_t slots;
+  };
+
+  std::shared_ptr<Buffer> m_buffer;
+  std::size_t m_offset;
+  std::size_t m_length;
+
+  // a buffer, and its control block, allocated from arena or the heap
+  static std::shared_ptr<Buffer> make_buffer(Arena * arena, std::size_t capacity){
+    ArenaAllocator<T> allocator(arena);
+    return std::allocate_shared<Buffer>(ArenaAllocator<Buffer>(allocator), allocator, capacity);
+  }
+
+  // true when an element may be pushed into the buffer in place, that is
+  // when it belongs to the current arena or it is on the heap and this is
+  // its only view, so promote reaches every element it holds
+  bool local() const noexcept {
+    Arena * arena = m_buffer->items.get_allocator().arena();
+    return (arena != nullptr) ? (arena == Arena::current()) : (m_buffer.use_count() == 1);
+  }
+
+  // count this view at its end slot
+  void hold() noexcept {
+    if(m_buffer) m_buffer->ends[m_offset + m_length].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // stop counting this view, its elements are no longer read after this
+  void letGo() noexcept {
+    if(m_buffer) m_buffer->ends[m_offset + m_length].fetch_sub(1, std::memory_order_release);
+  }
+
+  // make this view the whole of buffer
+  void attach(const std::shared_ptr<Buffer> & buffer) noexcept {
+    letGo();
+    m_buffer = buffer;
+    m_offset = 0;
+    hold();
+  }
+
+  // count this view one slot further on, after an element was pushed
+  void extend() noexcept {
+    letGo();
+    ++m_length;
+    hold();
+  }
+
+  /*! With the buffer mutex held, true if this view may push in place.
+    That needs a spare slot and no other view ending past this one, and
+    any elements past this view are then dropped as nobody can see them.
+   */
+  bool reclaim(){
+    vector_type & items = m_buffer->items;
+    std::size_t end = m_offset + m_length;
+    if(end >= items.capacity()) return false;
+    for(std::size_t i = items.size(); i > end; --i){
+      if(m_buffer->ends[i].load(std::memory_order_acquire) != 0) return false;
+    }
+    items.erase(items.begin() + end, items.end());
+    return true;
+  }
+
+  static const vector_type & empty_items(){
+    static const vector_type none((ArenaAllocator<T>(nullptr)));
+    return none;
+  }
+
+  const vector_type & items() const noexcept {
+    return m_buffer ? m_buffer->items : empty_items();
+  }
+
+  vector_type & mutable_items(){
+    static vector_type none((ArenaAllocator<T>(nullptr)));
+    return m_buffer ? m_buffer->items : none;
+  }
+
+  // copy this view into a new private buffer with the given capacity
+  void unshare(std::size_t capacity){
+    std::shared_ptr<Buffer> buffer = make_buffer(Arena::current(), capacity);
+    if(m_buffer && (m_buffer.use_count() == 1)){
+      // nobody else sees the old buffer, move the elements out of it
+      auto first = m_buffer->items.begin() + m_offset;
+      buffer->items.insert(buffer->items.end(),
+        std::make_move_iterator(first), std::make_move_iterator(first + m_length));
+    }
+    else if(m_buffer){
+      auto first = m_buffer->items.cbegin() + m_offset;
+      buffer->items.insert(buffer->items.end(), first, first + m_length);
+    }
+    attach(buffer);
+  }
+
+  // append when the buffer is shared past this view or full
+  void grow(const T & value){
+    // value may live in the current buffer, copy it before replacing it
+    T copy(value);
+    unshare(2 * (m_length + 1));
+    m_buffer->items.push_back(copy);
+    ++m_length;
+  }
+
+  // make the buffer private to this view before modifying elements
+  void detach(){
+    if(!m_buffer) return;
+    if(m_buffer.use_count() == 1){
+      // trim elements outside the view left behind by other views
+      vector_type & items = m_buffer->items;
+      if(m_offset + m_length < items.size()){
+        items.erase(items.begin() + m_offset + m_length, items.end());
+      }
+      return;
+    }
+    unshare(m_length);
+  }
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "catch.hpp"
+
+#include "shared_list.hpp"
+
+#include <memory>
+#include <vector>
+
+TEST_CASE( "Test SharedList copies share until modified", "[shared_list]" ) {
+
+  SharedList<int> a(std::vector<int>{1, 2, 3});
+  SharedList<int> b(a);
+
+  REQUIRE(!a.unique());
+  REQUIRE(b.size() == 3);
+  REQUIRE(&static_cast<const SharedList<int> &>(a)[0] == &static_cast<const SharedList<int> &>(b)[0]);
+
+  b[0] = 10;
+  REQUIRE(a.unique());
+  REQUIRE(b.unique());
+  REQUIRE(a[0] == 1);
+  REQUIRE(b[0] == 10);
+}
+
+TEST_CASE( "Test SharedList rest is a view", "[shared_list]" ) {
+
+  SharedList<int> a(std::vector<int>{1, 2, 3});
+  const SharedList<int> r = a.rest();
+
+  REQUIRE(r.size() == 2);
+  REQUIRE(r.front() == 2);
+  REQUIRE(&r.front() == &static_cast<const SharedList<int> &>(a)[1]);
+
+  const SharedList<int> e = r.rest().rest();
+  REQUIRE(e.empty());
+  REQUIRE(e.unique());
+  REQUIRE(e.rest().empty());
+}
+
+TEST_CASE( "Test SharedList push_back leaves other views unchanged", "[shared_list]" ) {
+
+  SharedList<int> a;
+  for(int i = 0; i < 4; ++i){
+    a.push_back(i);
+  }
+
+  SharedList<int> b(a);
+  SharedList<int> c(a);
+  b.push_back(4);
+  c.push_back(5);
+
+  REQUIRE(a.size() == 4);
+  REQUIRE(b.size() == 5);
+  REQUIRE(c.size() == 5);
+  REQUIRE(b.back() == 4);
+  REQUIRE(c.back() == 5);
+
+  std::vector<int> values(a.cbegin(), a.cend());
+  REQUIRE(values == std::vector<int>({0, 1, 2, 3}));
+
+  SharedList<int> r = b.rest();
+  r.push_back(6);
+  REQUIRE(std::vector<int>(r.cbegin(), r.cend()) == std::vector<int>({1, 2, 3, 4, 6}));
+  REQUIRE(std::vector<int>(b.cbegin(), b.cend()) == std::vector<int>({0, 1, 2, 3, 4}));
+}
+
+TEST_CASE( "Test SharedList push_back of its own element", "[shared_list]" ) {
+
+  SharedList<int> a(std::vector<int>{7});
+  for(int i = 0; i < 10; ++i){
+    const SharedList<int> & ca = a;
+    a.push_back(ca.front());
+  }
+  REQUIRE(a.size() == 11);
+  for(auto v : static_cast<const SharedList<int> &>(a)){
+    REQUIRE(v == 7);
+  }
+}
+
+TEST_CASE( "Test SharedList push_back reclaims slots of views that are gone", "[shared_list]" ) {
+
+  // shared buffers are appended to in place only in the current arena
+  Arena arena(1 << 16);
+  ArenaScope scope(arena);
+
+  typedef std::shared_ptr<int> Item;
+  SharedList<Item> base;
+  for(int i = 0; i < 3; ++i){
+    base.push_back(std::make_shared<int>(i));
+  }
+  base.reserve(8);
+  const SharedList<Item> & cbase = base;
+  const Item * first = &cbase[0];
+
+  Item x = std::make_shared<int>(10);
+  {
+    SharedList<Item> r(base);
+    r.push_back(x);
+    REQUIRE(&static_cast<const SharedList<Item> &>(r)[0] == first);
+  }
+  // x is still held by the slot r pushed it into
+  REQUIRE(x.use_count() == 2);
+
+  // the slot x was pushed into is reused, dropping x
+  Item y = std::make_shared<int>(11);
+  SharedList<Item> s(base);
+  s.push_back(y);
+  const SharedList<Item> & cs = s;
+  REQUIRE(&cs[0] == first);
+  REQUIRE(x.use_count() == 1);
+  REQUIRE(*cs.back() == 11);
+
+  // while s is alive its slot is not reused
+  SharedList<Item> t(base);
+  t.push_back(x);
+  const SharedList<Item> & ct = t;
+  REQUIRE(&ct[0] != first);
+  REQUIRE(*cs.back() == 11);
+  REQUIRE(*ct.back() == 10);
+  REQUIRE(base.size() == 3);
+}
+
+TEST_CASE( "Test SharedList push_back copies a shared heap buffer", "[shared_list]" ) {
+
+  SharedList<int> a(std::vector<int>{1, 2, 3});
+  a.reserve(8);
+  const SharedList<int> & ca = a;
+
+  SharedList<int> b(a);
+  b.push_back(4);
+  const SharedList<int> & cb = b;
+  REQUIRE(&cb[0] != &ca[0]);
+  REQUIRE(std::vector<int>(cb.cbegin(), cb.cend()) == std::vector<int>({1, 2, 3, 4}));
+
+  // the only view of a heap buffer still appends in place
+  const int * first = &cb[0];
+  b.push_back(5);
+  REQUIRE(&cb[0] == first);
+}
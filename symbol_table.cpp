@@ -0,0 +1,103 @@
+#include "symbol_table.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// names are stored in fixed size chunks that never move, so a name can
+// be read without locking once its id has been handed out
+const std::size_t CHUNK_BITS = 12;
+const std::size_t CHUNK_SIZE = std::size_t(1) << CHUNK_BITS;
+const std::size_t MAX_CHUNKS = 4096;
+
+struct Table {
+  std::mutex mutex;
+  std::unordered_map<std::string, SymbolId> ids;
+  std::atomic<std::string *> chunks[MAX_CHUNKS];
+  std::size_t count;
+
+  Table(): count(0){
+    for(auto & c : chunks){
+      c.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // the order must match WellKnownKey
+    const char * keys[WELL_KNOWN_KEY_COUNT] = {
+      "\"object-name\"", "\"size\"", "\"thickness\"",
+      "\"position\"", "\"text-scale\"", "\"text-rotation\"", "memoize"
+    };
+    SymbolId id;
+    for(auto k : keys){
+      add(k, id);
+    }
+  }
+
+  ~Table(){
+    for(auto & c : chunks){
+      delete [] c.load(std::memory_order_relaxed);
+    }
+  }
+
+  // called with mutex held, returns false when the table is full
+  bool add(const std::string & name, SymbolId & id){
+    std::size_t chunk = count >> CHUNK_BITS;
+    if(chunk >= MAX_CHUNKS){
+      return false;
+    }
+    std::string * names = chunks[chunk].load(std::memory_order_relaxed);
+    if(names == nullptr){
+      names = new std::string[CHUNK_SIZE];
+      chunks[chunk].store(names, std::memory_order_release);
+    }
+    names[count & (CHUNK_SIZE - 1)] = name;
+
+    id = static_cast<SymbolId>(count++);
+    ids.emplace(name, id);
+    return true;
+  }
+};
+
+Table & table(){
+  static Table instance;
+  return instance;
+}
+
+}
+
+SymbolId SymbolTable::intern(const std::string & name){
+  SymbolId id;
+  if(!intern(name, id)){
+    throw std::length_error("Error: too many symbols");
+  }
+  return id;
+}
+
+bool SymbolTable::intern(const std::string & name, SymbolId & id){
+  Table & t = table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  auto it = t.ids.find(name);
+  if(it != t.ids.end()){
+    id = it->second;
+    return true;
+  }
+  return t.add(name, id);
+}
+
+bool SymbolTable::lookup(const std::string & name, SymbolId & id){
+  Table & t = table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  auto it = t.ids.find(name);
+  if(it == t.ids.end()){
+    return false;
+  }
+  id = it->second;
+  return true;
+}
+
+const std::string & SymbolTable::name(SymbolId id){
+  const std::string * names = table().chunks[id >> CHUNK_BITS].load(std::memory_order_acquire);
+  return names[id & (CHUNK_SIZE - 1)];
+}
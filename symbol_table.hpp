@@ -0,0 +1,59 @@
+/*! \file symbol_table.hpp
+Defines the SymbolTable interning symbol names to small integer ids.
+ */
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include <cstdint>
+#include <string>
+
+/// identifier of an interned symbol
+typedef std::uint32_t SymbolId;
+
+/// id standing for no symbol, never handed out by SymbolTable
+const SymbolId NO_SYMBOL = ~SymbolId(0);
+
+/*! Ids of the property keys used by plot objects and by memoized
+  lambdas. These are interned before any other symbol, so they are the
+  same in every run.
+ */
+enum WellKnownKey : SymbolId {
+  OBJECT_NAME_KEY = 0, ///< "object-name"
+  SIZE_KEY,            ///< "size"
+  THICKNESS_KEY,       ///< "thickness"
+  POSITION_KEY,        ///< "position"
+  TEXT_SCALE_KEY,      ///< "text-scale"
+  TEXT_ROTATION_KEY,   ///< "text-rotation"
+  MEMOIZE_KEY,         ///< memoize, unquoted so no program can set it
+  WELL_KNOWN_KEY_COUNT
+};
+
+/*! \class SymbolTable
+\brief A process-wide table of interned symbol names.
+
+Identifiers and property keys are interned, string literals are not, so
+the table grows with the names a program uses rather than its data.
+Interning a name returns the same id every time it is called with that
+name. Ids are never reused, and the name of an id stays valid for the
+lifetime of the program. All members are safe to call from several
+threads, name does not lock.
+*/
+class SymbolTable {
+public:
+
+  /*! id of name, adding it to the table if it is not there yet, throws
+    std::length_error when the table is full
+   */
+  static SymbolId intern(const std::string & name);
+
+  /// as intern, but returns false instead of throwing when the table is full
+  static bool intern(const std::string & name, SymbolId & id);
+
+  /// look up name without adding it, returns false if it was never interned
+  static bool lookup(const std::string & name, SymbolId & id);
+
+  /// name of an interned id
+  static const std::string & name(SymbolId id);
+};
+
+#endif
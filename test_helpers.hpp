@@ -0,0 +1,18 @@
+/*! \file test_helpers.hpp
+Helpers shared by the unit tests.
+ */
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include <sstream>
+#include <string>
+
+#include "parse.hpp"
+
+/// parse text as a whole program, an empty Expression if it does not parse
+inline Expression parse_text(const std::string & text){
+  std::istringstream iss(text);
+  return parse(tokenize(iss));
+}
+
+#endif
@@ -0,0 +1,194 @@
+#include "thread_pool.hpp"
+
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+// default number of elements before map is split across the pool
+const std::size_t DEFAULT_PARALLEL_THRESHOLD = 2048;
+
+// set on the pool's own threads so nested loops run inline
+static thread_local bool is_worker = false;
+
+// shared pool state, guarded by shared_mutex
+static std::mutex shared_mutex;
+static std::shared_ptr<ThreadPool> shared_pool;
+static unsigned shared_threads = 0;
+static std::atomic<std::size_t> shared_threshold(DEFAULT_PARALLEL_THRESHOLD);
+
+// thread count from PLOTSCRIPT_THREADS or the hardware
+unsigned default_threads(){
+  const char * value = std::getenv("PLOTSCRIPT_THREADS");
+  if(value != nullptr){
+    long threads = std::strtol(value, nullptr, 10);
+    if(threads > 0){
+      return static_cast<unsigned>(threads);
+    }
+  }
+  unsigned hardware = std::thread::hardware_concurrency();
+  return (hardware == 0) ? 1 : hardware;
+}
+
+ThreadPool::ThreadPool(unsigned threads): pending(0), stopping(false), next_queue(0){
+
+  // a single thread gains nothing from a worker, run inline instead
+  if(threads <= 1) return;
+
+  for(unsigned i = 0; i < threads; ++i){
+    queues.emplace_back(new Queue);
+  }
+  for(unsigned i = 0; i < threads; ++i){
+    workers.emplace_back(&ThreadPool::work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool(){
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for(auto & w : workers){
+    w.join();
+  }
+}
+
+unsigned ThreadPool::size() const noexcept{
+  return static_cast<unsigned>(workers.size());
+}
+
+bool ThreadPool::inWorker() noexcept{
+  return is_worker;
+}
+
+void ThreadPool::push(Task task){
+  unsigned index = next_queue++ % queues.size();
+  {
+    // count the task before it can be popped, so pending never underflows
+    std::lock_guard<std::mutex> wake_lock(wake_mutex);
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    ++pending;
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  wake.notify_one();
+}
+
+bool ThreadPool::pop(unsigned index, Task & task){
+
+  // own queue first, oldest task first
+  {
+    Queue & own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if(!own.tasks.empty()){
+      task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      --pending;
+      return true;
+    }
+  }
+
+  // then steal the newest task of another worker
+  for(std::size_t offset = 1; offset < queues.size(); ++offset){
+    Queue & other = *queues[(index + offset) % queues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if(!other.tasks.empty()){
+      task = std::move(other.tasks.back());
+      other.tasks.pop_back();
+      --pending;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(unsigned index){
+  is_worker = true;
+
+  while(true){
+    Task task;
+    if(pop(index, task)){
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    wake.wait(lock, [this]{ return stopping || (pending > 0); });
+    if(stopping && (pending == 0)){
+      return;
+    }
+  }
+}
+
+void ThreadPool::parallelFor(std::size_t n, std::size_t grain,
+                             const std::function<void(std::size_t, std::size_t)> & body){
+  if(n == 0) return;
+  if(grain == 0) grain = 1;
+
+  if(workers.empty() || inWorker() || (n <= grain)){
+    body(0, n);
+    return;
+  }
+
+  std::size_t chunks = (n + grain - 1) / grain;
+  std::vector<std::exception_ptr> errors(chunks);
+
+  std::mutex done_mutex;
+  std::condition_variable done;
+  std::size_t remaining = chunks;
+
+  for(std::size_t c = 0; c < chunks; ++c){
+    std::size_t begin = c * grain;
+    std::size_t end = (begin + grain < n) ? begin + grain : n;
+    push([&, c, begin, end]{
+      try{
+        body(begin, end);
+      }
+      catch(...){
+        errors[c] = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(done_mutex);
+      if(--remaining == 0){
+        done.notify_one();
+      }
+    });
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&]{ return remaining == 0; });
+  }
+
+  for(auto & e : errors){
+    if(e){
+      std::rethrow_exception(e);
+    }
+  }
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::shared(){
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  if(!shared_pool){
+    if(shared_threads == 0){
+      shared_threads = default_threads();
+    }
+    shared_pool = std::make_shared<ThreadPool>(shared_threads);
+  }
+  return shared_pool;
+}
+
+void ThreadPool::configure(unsigned threads, std::size_t threshold){
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  if(threads == 0){
+    threads = default_threads();
+  }
+  if(threads != shared_threads){
+    // callers holding the old pool keep it alive until they finish
+    shared_pool.reset();
+    shared_threads = threads;
+  }
+  shared_threshold = threshold;
+}
+
+std::size_t ThreadPool::threshold() noexcept{
+  return shared_threshold;
+}
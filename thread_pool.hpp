@@ -0,0 +1,95 @@
+/*! \file thread_pool.hpp
+Defines the ThreadPool used to run data-parallel loops such as map.
+ */
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! \class ThreadPool
+\brief A fixed set of worker threads with work-stealing task queues.
+
+Each worker owns a deque of tasks. A worker pops from the front of its own
+deque and, when that is empty, steals from the back of another worker's
+deque. The pool is used through parallelFor, which splits a loop into
+chunks and blocks until every chunk has run.
+*/
+class ThreadPool {
+public:
+
+  /// Construct a pool with the given number of worker threads
+  explicit ThreadPool(unsigned threads);
+
+  /// Stop and join all workers, tasks still queued are run first
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /// number of worker threads
+  unsigned size() const noexcept;
+
+  /*! Run body(begin, end) over [0, n) in chunks of at most grain indices.
+    Blocks until all chunks have finished. If chunks throw, the exception
+    of the lowest chunk is rethrown. Runs inline when the pool has no
+    workers or when called from one of the pool's own workers.
+   */
+  void parallelFor(std::size_t n, std::size_t grain,
+                   const std::function<void(std::size_t, std::size_t)> & body);
+
+  /// true when the calling thread is a worker of some ThreadPool
+  static bool inWorker() noexcept;
+
+  /*! The process-wide pool used by the interpreter. Its size defaults to
+    the PLOTSCRIPT_THREADS environment variable, or to the hardware
+    concurrency if that is not set. The pool lives at least as long as
+    the pointer returned, even if it is reconfigured meanwhile.
+   */
+  static std::shared_ptr<ThreadPool> shared();
+
+  /*! Configure the shared pool. A pool replaced by a new size is stopped
+    once the last caller still using it is done.
+    \param threads number of workers, 0 selects the default, 1 disables parallelism
+    \param threshold minimum number of elements before a loop runs in parallel
+   */
+  static void configure(unsigned threads, std::size_t threshold);
+
+  /// minimum number of elements before a loop runs in parallel
+  static std::size_t threshold() noexcept;
+
+private:
+
+  typedef std::function<void()> Task;
+
+  // a worker's task deque, guarded by its own mutex
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  // sleeping workers wait on wake until pending > 0 or stopping
+  std::mutex wake_mutex;
+  std::condition_variable wake;
+  std::atomic<std::size_t> pending;
+  bool stopping;
+
+  // round robin index for pushing tasks
+  std::atomic<unsigned> next_queue;
+
+  void push(Task task);
+  bool pop(unsigned index, Task & task);
+  void work(unsigned index);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "catch.hpp"
+
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE( "Test parallelFor covers every index once", "[thread_pool]" ) {
+
+  ThreadPool pool(4);
+  REQUIRE(pool.size() == 4);
+
+  std::vector<int> hits(10000, 0);
+  pool.parallelFor(hits.size(), 64, [&](std::size_t begin, std::size_t end){
+      for(std::size_t i = begin; i < end; ++i){
+        hits[i] += 1;
+      }
+    });
+
+  for(auto h : hits){
+    REQUIRE(h == 1);
+  }
+}
+
+TEST_CASE( "Test parallelFor runs inline without workers", "[thread_pool]" ) {
+
+  ThreadPool pool(1);
+  REQUIRE(pool.size() == 0);
+
+  std::size_t calls = 0;
+  std::size_t covered = 0;
+  pool.parallelFor(100, 10, [&](std::size_t begin, std::size_t end){
+      ++calls;
+      covered = end - begin;
+    });
+  REQUIRE(calls == 1);
+  REQUIRE(covered == 100);
+}
+
+TEST_CASE( "Test parallelFor rethrows the lowest chunk error", "[thread_pool]" ) {
+
+  ThreadPool pool(4);
+
+  REQUIRE_THROWS_WITH(pool.parallelFor(1000, 10, [](std::size_t begin, std::size_t){
+        if(begin >= 500){
+          throw std::runtime_error("late");
+        }
+        if(begin >= 100){
+          throw std::runtime_error("early");
+        }
+      }), "early");
+}
+
+TEST_CASE( "Test nested parallelFor runs inline on workers", "[thread_pool]" ) {
+
+  ThreadPool pool(2);
+
+  std::atomic<std::size_t> total(0);
+  std::atomic<std::size_t> on_worker(0);
+  pool.parallelFor(8, 1, [&](std::size_t, std::size_t){
+      if(ThreadPool::inWorker()){
+        ++on_worker;
+      }
+      pool.parallelFor(10, 1, [&](std::size_t begin, std::size_t end){
+          total += end - begin;
+        });
+    });
+  REQUIRE(total == 80);
+  REQUIRE(on_worker == 8);
+  REQUIRE(!ThreadPool::inWorker());
+}
+
+TEST_CASE( "Test the shared pool outlives a reconfigure while in use", "[thread_pool]" ) {
+
+  std::size_t threshold = ThreadPool::threshold();
+  ThreadPool::configure(4, threshold);
+
+  std::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+  REQUIRE(pool->size() == 4);
+
+  std::atomic<std::size_t> total(0);
+  pool->parallelFor(64, 1, [&](std::size_t begin, std::size_t end){
+      if(begin == 0){
+        // the old pool is still held by this loop
+        ThreadPool::configure(2, threshold);
+      }
+      total += end - begin;
+    });
+  REQUIRE(total == 64);
+  REQUIRE(ThreadPool::shared()->size() == 2);
+  REQUIRE(pool->size() == 4);
+
+  pool.reset();
+  ThreadPool::configure(0, threshold);
+}
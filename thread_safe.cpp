@@ -1,4 +1,5 @@
 #include "thread_safe.hpp"
+#include "metrics.hpp"
 
 
 std::string inputCommunication::get_input() {
@@ -7,6 +8,7 @@ std::string inputCommunication::get_input() {
 		input_ready.wait(lock);
 	}
 	input_is_ready = false;
+	Metrics::record(Metrics::QUEUE_WAIT, std::chrono::steady_clock::now() - stored_at);
 	return input_string;
 }
 
@@ -20,6 +22,7 @@ void inputCommunication::store_input(std::string in) {
 	std::unique_lock<std::mutex> lock(input_mutex);
 	input_string = in;
 	input_is_ready = true;
+	stored_at = std::chrono::steady_clock::now();
 	input_ready.notify_one();
 }
 
@@ -29,6 +32,7 @@ std::pair<std::string, Expression> outputCommunication::get_output() {
 		output_ready.wait(lock);
 	}
 	output_is_ready = false;
+	Metrics::record(Metrics::OUTPUT_HANDOFF, std::chrono::steady_clock::now() - stored_at);
 	return output;
 }
 
@@ -39,6 +43,7 @@ std::pair<std::string, Expression> outputCommunication::try_get_output()
 		return std::pair<std::string, Expression>("", Expression());
 	}
 	output_is_ready = false;
+	Metrics::record(Metrics::OUTPUT_HANDOFF, std::chrono::steady_clock::now() - stored_at);
 	return output;
 }
 
@@ -52,6 +57,7 @@ void outputCommunication::store_output(std::pair<std::string, Expression> out) {
 	std::unique_lock<std::mutex> lock(output_mutex);
 	output = out;
 	output_is_ready = true;
+	stored_at = std::chrono::steady_clock::now();
 	output_ready.notify_one();
 }
 
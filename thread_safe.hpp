@@ -1,6 +1,7 @@
 #ifndef THREAD_SAFE_HPP
 #define THREAD_SAFE_HPP
 
+#include <chrono>
 #include <mutex>
 #include <string>
 #include "expression.hpp"
@@ -16,6 +17,8 @@ private:
 	std::string input_string;
 	std::condition_variable input_ready;
 	bool input_is_ready = false;
+	// when the input was stored, for the queue wait metric
+	std::chrono::steady_clock::time_point stored_at;
 };
 
 
@@ -30,6 +33,8 @@ private:
 	std::condition_variable output_ready;
 	std::pair<std::string, Expression> output;
 	bool output_is_ready = false;
+	// when the output was stored, for the output handoff metric
+	std::chrono::steady_clock::time_point stored_at;
 };
 
 
@@ -4,6 +4,9 @@
 #include <cctype>
 #include <iostream>
 
+// module includes
+#include "trace.hpp"
+
 // define constants for special characters
 const char OPENCHAR = '(';
 const char CLOSECHAR = ')';
@@ -41,11 +44,11 @@ void store_ifnot_empty(std::string & token, TokenSequenceType & seq){
   }
 }
 
-TokenSequenceType tokenize(std::istream & seq){
-  TokenSequenceType tokens;
-  std::string token;
-  
-  while(true){
+// split seq into tokens, the characters of the last token are kept in token
+// until it ends. With one, stop as soon as a token is split.
+void split(std::istream & seq, std::string & token, TokenSequenceType & tokens, bool one){
+
+  while(!one || tokens.empty()){
     char c = seq.get();
     if(seq.eof()) break;
     
@@ -71,6 +74,10 @@ TokenSequenceType tokenize(std::istream & seq){
 			char t;
 			while (true) {
 				t = seq.get();
+				// an unterminated string ends with the stream
+				if (seq.eof()) {
+					break;
+				}
 				if (t == QUOTECHAR) {
 					token.push_back('"');
 					break;
@@ -88,8 +95,32 @@ TokenSequenceType tokenize(std::istream & seq){
       token.push_back(c);
     }
   }
-  store_ifnot_empty(token, tokens);
+  if(!one || tokens.empty()){
+    store_ifnot_empty(token, tokens);
+  }
+}
 
-  return tokens;
+TokenStream::TokenStream(std::istream & seq): m_seq(seq) {}
+
+bool TokenStream::next(Token & token){
+  if(m_pending.empty()){
+    fill();
+    if(m_pending.empty()) return false;
+  }
+  token = m_pending.front();
+  m_pending.pop_front();
+  return true;
 }
 
+void TokenStream::fill(){
+  split(m_seq, m_token, m_pending, true);
+}
+
+TokenSequenceType tokenize(std::istream & seq){
+  TraceScope trace("tokenize");
+  TokenSequenceType tokens;
+  std::string token;
+  split(seq, token, tokens, false);
+
+  return tokens;
+}
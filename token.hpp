@@ -52,6 +52,37 @@ sequential access should do.
  */
 typedef std::deque<Token> TokenSequenceType;
 
+/*! \class TokenStream
+\brief Reads the tokens of a character stream one at a time.
+
+Splits the stream the same way as tokenize, reading only as many
+characters as needed for the next token.
+*/
+class TokenStream {
+public:
+
+  /// read tokens from seq, which must outlive the TokenStream
+  explicit TokenStream(std::istream & seq);
+
+  /*! Read the next token.
+    \param token set to the token read
+    \return false at the end of the stream
+   */
+  bool next(Token & token);
+
+private:
+  std::istream & m_seq;
+
+  // tokens split but not yet read, at most two
+  std::deque<Token> m_pending;
+
+  // characters of the token being split
+  std::string m_token;
+
+  // split tokens from the stream until one is pending or the stream ends
+  void fill();
+};
+
 /*! \fn TokenSequenceType tokenize(std::istream & seq)
 \brief Split a stream into a sequnce of tokens
 
@@ -73,3 +73,25 @@ TEST_CASE( "Test tokenize", "[token]" ) {
   REQUIRE(tokens.empty());
 }
 
+
+TEST_CASE( "Test token stream", "[token]" ) {
+
+  std::istringstream iss("(f \"a b\")x; comment\n\"unterminated");
+  TokenStream stream(iss);
+  Token t(Token::CLOSE);
+
+  REQUIRE(stream.next(t));
+  REQUIRE(t.type() == Token::OPEN);
+  REQUIRE(stream.next(t));
+  REQUIRE(t.asString() == "f");
+  REQUIRE(stream.next(t));
+  REQUIRE(t.asString() == "\"a b\"");
+  REQUIRE(stream.next(t));
+  REQUIRE(t.type() == Token::CLOSE);
+  REQUIRE(stream.next(t));
+  REQUIRE(t.asString() == "x");
+  REQUIRE(stream.next(t));
+  REQUIRE(t.asString() == "\"unterminated");
+  REQUIRE_FALSE(stream.next(t));
+  REQUIRE_FALSE(stream.next(t));
+}
@@ -0,0 +1,227 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// events kept per thread
+const std::size_t TRACE_CAPACITY = 1 << 15;
+
+namespace {
+
+/*
+  One event of a ring buffer. The owning thread writes an event as a
+  seqlock: sequence is 0 while the fields are written and then set to the
+  position of the event plus one, so a reader can tell a complete event
+  from one being overwritten.
+*/
+struct Slot {
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<const char *> name;
+  std::atomic<std::int64_t> start;
+  std::atomic<std::int64_t> end;
+};
+
+struct Buffer {
+  explicit Buffer(unsigned id): slots(new Slot[TRACE_CAPACITY]), head(0), tid(id), released(false) {
+    for(std::size_t i = 0; i < TRACE_CAPACITY; ++i){
+      slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  std::unique_ptr<Slot[]> slots;
+  // number of events written, only the owning thread writes it
+  std::atomic<std::uint64_t> head;
+  unsigned tid;
+  // guarded by the registry mutex
+  std::string name;
+  // set once the owning thread has exited, guarded by the registry mutex
+  bool released;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  unsigned next_tid = 1;
+};
+
+Registry & registry(){
+  static Registry r;
+  return r;
+}
+
+thread_local Buffer * current_buffer = nullptr;
+
+// releases the thread's buffer when the thread exits
+struct Owner {
+  Buffer * buffer = nullptr;
+
+  ~Owner(){
+    if(buffer){
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      buffer->released = true;
+      current_buffer = nullptr;
+    }
+  }
+};
+
+thread_local Owner owner;
+
+/*
+  The calling thread's buffer. A buffer released without events, such as
+  that of a thread that only named itself, is reused by the next thread,
+  so threads started again and again while tracing is off do not each
+  keep a buffer. Released buffers with events are kept for export until
+  clear drops them.
+*/
+Buffer & buffer(){
+  if(!current_buffer){
+    Registry & r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for(auto & b : r.buffers){
+      if(b->released && (b->head.load(std::memory_order_relaxed) == 0)){
+        b->released = false;
+        b->name.clear();
+        current_buffer = b.get();
+        break;
+      }
+    }
+    if(!current_buffer){
+      r.buffers.push_back(std::make_shared<Buffer>(r.next_tid++));
+      current_buffer = r.buffers.back().get();
+    }
+    owner.buffer = current_buffer;
+  }
+  return *current_buffer;
+}
+
+void write_string(std::ostream & out, const std::string & s){
+  out << '"';
+  for(char c : s){
+    if((c == '"') || (c == '\\')){
+      out << '\\' << c;
+    }
+    else if(static_cast<unsigned char>(c) >= 0x20){
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+}
+
+std::atomic<bool> Trace::s_enabled(false);
+
+void Trace::enable(bool enabled) noexcept{
+  if(enabled){
+    now();
+  }
+  s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::nameThread(const std::string & name){
+  Buffer & b = buffer();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  b.name = name;
+}
+
+std::size_t Trace::capacity() noexcept{
+  return TRACE_CAPACITY;
+}
+
+std::int64_t Trace::now() noexcept{
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char * name, std::int64_t start, std::int64_t end) noexcept{
+  Buffer * b = current_buffer;
+  if(!b){
+    try{
+      b = &buffer();
+    }
+    catch(...){
+      return;
+    }
+  }
+
+  std::uint64_t position = b->head.load(std::memory_order_relaxed);
+  Slot & slot = b->slots[position % TRACE_CAPACITY];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.end.store(end, std::memory_order_relaxed);
+  slot.sequence.store(position + 1, std::memory_order_release);
+  b->head.store(position + 1, std::memory_order_release);
+}
+
+void Trace::writeChrome(std::ostream & out){
+  Registry & r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  auto separator = [&](){
+    out << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  for(auto & b : r.buffers){
+    if(b->released && (b->head.load(std::memory_order_acquire) == 0)){
+      // left by an exited thread that recorded nothing
+      continue;
+    }
+    if(!b->name.empty()){
+      separator();
+      out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid << ",\"args\":{\"name\":";
+      write_string(out, b->name);
+      out << "}}";
+    }
+
+    std::uint64_t head = b->head.load(std::memory_order_acquire);
+    std::uint64_t begin = (head > TRACE_CAPACITY) ? head - TRACE_CAPACITY : 0;
+    for(std::uint64_t position = begin; position < head; ++position){
+      const Slot & slot = b->slots[position % TRACE_CAPACITY];
+      if(slot.sequence.load(std::memory_order_acquire) != position + 1) continue;
+      const char * name = slot.name.load(std::memory_order_relaxed);
+      std::int64_t start = slot.start.load(std::memory_order_relaxed);
+      std::int64_t end = slot.end.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(slot.sequence.load(std::memory_order_relaxed) != position + 1) continue;
+
+      separator();
+      out << "{\"name\":";
+      write_string(out, name);
+      out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+          << ",\"ts\":" << start / 1000.0 << ",\"dur\":" << (end - start) / 1000.0 << "}";
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void Trace::clear(){
+  Registry & r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  // the buffers of exited threads are freed rather than kept empty
+  r.buffers.erase(std::remove_if(r.buffers.begin(), r.buffers.end(),
+                                 [](const std::shared_ptr<Buffer> & b){ return b->released; }),
+                  r.buffers.end());
+  for(auto & b : r.buffers){
+    for(std::size_t i = 0; i < TRACE_CAPACITY; ++i){
+      b->slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    b->head.store(0, std::memory_order_relaxed);
+  }
+}
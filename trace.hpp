@@ -0,0 +1,83 @@
+/*! \file trace.hpp
+Defines the Trace of timed events exported in the Chrome trace format.
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*! \class Trace
+\brief A process-wide recording of timed events, one ring buffer per thread.
+
+While tracing is enabled every TraceScope records an event with its name,
+thread, start and duration. Each thread writes its events to its own ring
+buffer of Trace::capacity() events without locking, overwriting the oldest
+events when the buffer is full. The buffers can be written out at any time
+as Chrome trace JSON, which chrome://tracing and Perfetto show as a
+timeline with a track per thread.
+*/
+class Trace {
+public:
+
+  /// start or stop recording events, events already recorded are kept
+  static void enable(bool enabled) noexcept;
+
+  /// true while events are recorded
+  static bool enabled() noexcept { return s_enabled.load(std::memory_order_relaxed); }
+
+  /// name the calling thread's track in the exported trace
+  static void nameThread(const std::string & name);
+
+  /// number of events kept per thread
+  static std::size_t capacity() noexcept;
+
+  /*! Write the recorded events as Chrome trace JSON. Events being recorded
+    while the trace is written may be left out.
+   */
+  static void writeChrome(std::ostream & out);
+
+  /// forget the recorded events and free the buffers of exited threads, only while no thread is recording
+  static void clear();
+
+private:
+
+  friend class TraceScope;
+
+  // nanoseconds since the first call
+  static std::int64_t now() noexcept;
+
+  static void record(const char * name, std::int64_t start, std::int64_t end) noexcept;
+
+  static std::atomic<bool> s_enabled;
+};
+
+/*! \class TraceScope
+\brief Records its lifetime as an event named name while tracing is enabled.
+
+The name must be a string that outlives the trace, such as a literal.
+When tracing is disabled a TraceScope costs one relaxed load and a branch.
+*/
+class TraceScope {
+public:
+
+  explicit TraceScope(const char * name) noexcept:
+    m_name(Trace::enabled() ? name : nullptr), m_start(m_name ? Trace::now() : 0) {}
+
+  ~TraceScope(){
+    if(m_name){
+      Trace::record(m_name, m_start, Trace::now());
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope & operator=(const TraceScope &) = delete;
+
+private:
+  const char * m_name;
+  std::int64_t m_start;
+};
+
+#endif
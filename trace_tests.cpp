@@ -0,0 +1,122 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "interpreter.hpp"
+#include "trace.hpp"
+
+// number of times s occurs in text
+static std::size_t count(const std::string & text, const std::string & s){
+  std::size_t n = 0;
+  for(std::size_t i = text.find(s); i != std::string::npos; i = text.find(s, i + s.size())){
+    ++n;
+  }
+  return n;
+}
+
+static std::string chrome(){
+  std::ostringstream out;
+  Trace::writeChrome(out);
+  return out.str();
+}
+
+TEST_CASE( "Test no events are recorded while tracing is disabled", "[trace]" ) {
+
+  Trace::clear();
+  {
+    TraceScope trace("disabled-event");
+  }
+  std::string json = chrome();
+  REQUIRE(json.find("disabled-event") == std::string::npos);
+  REQUIRE(json.find("{\"traceEvents\":[") == 0);
+}
+
+TEST_CASE( "Test events of several threads", "[trace]" ) {
+
+  Trace::clear();
+  Trace::enable(true);
+  {
+    TraceScope outer("outer-event");
+    TraceScope inner("inner-event");
+  }
+  std::thread worker([](){
+      Trace::nameThread("trace \"worker\"");
+      TraceScope trace("worker-event");
+    });
+  worker.join();
+  Trace::enable(false);
+
+  std::string json = chrome();
+  REQUIRE(count(json, "\"name\":\"outer-event\",\"ph\":\"X\"") == 1);
+  REQUIRE(count(json, "\"name\":\"inner-event\",\"ph\":\"X\"") == 1);
+  REQUIRE(count(json, "\"name\":\"worker-event\",\"ph\":\"X\"") == 1);
+  REQUIRE(count(json, "\"args\":{\"name\":\"trace \\\"worker\\\"\"}") == 1);
+
+  // the worker's events are on a track of their own
+  std::size_t outer = json.find("outer-event");
+  std::size_t worker_event = json.find("worker-event");
+  std::string outer_tid = json.substr(json.find("\"tid\":", outer), 8);
+  std::string worker_tid = json.substr(json.find("\"tid\":", worker_event), 8);
+  REQUIRE(outer_tid != worker_tid);
+
+  Trace::clear();
+  REQUIRE(chrome().find("outer-event") == std::string::npos);
+}
+
+TEST_CASE( "Test the ring buffer keeps the latest events", "[trace]" ) {
+
+  Trace::clear();
+  Trace::enable(true);
+  for(std::size_t i = 0; i < Trace::capacity() + 10; ++i){
+    TraceScope trace("ring-event");
+  }
+  Trace::enable(false);
+
+  REQUIRE(count(chrome(), "\"ring-event\"") == Trace::capacity());
+  Trace::clear();
+}
+
+TEST_CASE( "Test interpreter stages are traced", "[trace]" ) {
+
+  Trace::clear();
+  Trace::enable(true);
+  Interpreter interp;
+  std::istringstream iss("(+ 1 2)");
+  REQUIRE(interp.parseStream(iss));
+  interp.evaluate();
+  Trace::enable(false);
+
+  std::string json = chrome();
+  REQUIRE(count(json, "\"tokenize\"") == 1);
+  REQUIRE(count(json, "\"parse\"") == 1);
+  REQUIRE(count(json, "\"evaluate\"") == 1);
+  Trace::clear();
+}
+
+TEST_CASE( "Test the buffers of exited threads are reused or freed", "[trace]" ) {
+
+  Trace::clear();
+
+  // threads that record nothing leave no track, and share one buffer
+  for(int i = 0; i < 3; ++i){
+    std::thread idle([i](){ Trace::nameThread("idle-" + std::to_string(i)); });
+    idle.join();
+  }
+  std::string json = chrome();
+  REQUIRE(json.find("idle-") == std::string::npos);
+
+  // a thread with events keeps its track until clear
+  Trace::enable(true);
+  std::thread busy([](){
+      Trace::nameThread("busy");
+      TraceScope trace("busy-event");
+    });
+  busy.join();
+  Trace::enable(false);
+  REQUIRE(count(chrome(), "\"busy-event\"") == 1);
+  Trace::clear();
+  json = chrome();
+  REQUIRE(json.find("busy") == std::string::npos);
+}